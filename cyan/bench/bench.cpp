@@ -0,0 +1,150 @@
+#include "bench.hpp"
+#include "cyan/src/engine/ecs/ecs_common.hpp"
+#include "cyan/src/engine/ecs/ecs_stats.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+using namespace cyan::bench;
+
+namespace {
+    /**
+     * Get sizes going up by a factor of 10 from min, always including max.
+     */
+    std::vector<std::size_t> decade_sizes(std::size_t min, std::size_t max) {
+        std::vector<std::size_t> sizes;
+        if (max == 0) return sizes;
+        for (std::size_t n = std::max<std::size_t>(min, 1); n < max; n *= 10) {
+            sizes.push_back(n);
+        }
+        if (max >= min) sizes.push_back(max);
+        return sizes;
+    }
+
+    /**
+     * Write a string as a JSON string literal.
+     */
+    void write_json_string(std::ostream& out, const std::string& str) {
+        out << '"';
+        for (char c : str) {
+            if (c == '"' || c == '\\') out << '\\';
+            out << c;
+        }
+        out << '"';
+    }
+}
+
+
+BenchRunner::BenchRunner(BenchOptions options)
+    : options(std::move(options))
+{}
+
+
+const BenchOptions& BenchRunner::get_options() const
+{
+    return options;
+}
+
+
+bool BenchRunner::enabled(const std::string& name) const
+{
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+
+bool BenchRunner::any_enabled(const std::vector<std::string>& names) const
+{
+    return std::any_of(names.begin(), names.end(), [&](const std::string& name) { return enabled(name); });
+}
+
+
+std::vector<std::size_t> BenchRunner::entity_counts() const
+{
+    return decade_sizes(options.min_entities, options.max_entities);
+}
+
+
+std::vector<std::size_t> BenchRunner::resource_counts() const
+{
+    return decade_sizes(std::min(options.min_entities, options.max_resources), options.max_resources);
+}
+
+
+const std::vector<BenchResult>& BenchRunner::get_results() const
+{
+    return results;
+}
+
+
+void BenchRunner::add_result(const std::string& name, std::size_t n, std::size_t ops, std::vector<double> ns_per_op)
+{
+    BenchResult result;
+    result.name = name;
+    result.n = n;
+    result.ops = ops;
+    if (!ns_per_op.empty()) {
+        std::sort(ns_per_op.begin(), ns_per_op.end());
+        result.ns_per_op_min = ns_per_op.front();
+        result.ns_per_op_median = ns_per_op[ns_per_op.size() / 2];
+        result.ns_per_op_mean = std::accumulate(ns_per_op.begin(), ns_per_op.end(), 0.0) / double(ns_per_op.size());
+    }
+    results.push_back(result);
+
+    // Progress goes to stderr, leaving stdout for the JSON.
+    std::cerr << std::left << std::setw(48) << name << std::right << std::setw(10) << n
+              << std::fixed << std::setprecision(2) << std::setw(12) << result.ns_per_op_median << " ns/op"
+              << std::endl;
+}
+
+
+void BenchRunner::write_json(std::ostream& out) const
+{
+    out << "{\n";
+    out << "  \"config\": {\n";
+    out << "    \"id_bits\": " << CYAN_ECS_ID_BITS << ",\n";
+    out << "    \"generation_bits\": " << CYAN_ECS_GENERATION_BITS << ",\n";
+    out << "    \"stats_counters\": " << (ECS_STATS_ENABLED ? "true" : "false") << ",\n";
+#ifdef NDEBUG
+    out << "    \"assertions\": false,\n";
+#else
+    out << "    \"assertions\": true,\n";
+#endif
+    out << "    \"repeats\": " << options.repeats << "\n";
+    out << "  },\n";
+    out << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); i += 1) {
+        auto& result = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+        write_json_string(out, result.name);
+        out << ", \"n\": " << result.n << ", \"ops\": " << result.ops << std::fixed << std::setprecision(3)
+            << ", \"ns_per_op_min\": " << result.ns_per_op_min
+            << ", \"ns_per_op_median\": " << result.ns_per_op_median
+            << ", \"ns_per_op_mean\": " << result.ns_per_op_mean << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"checksum\": " << checksum << "\n";
+    out << "}\n";
+}
+
+
+std::vector<std::size_t> cyan::bench::shuffled_indices(std::size_t n, std::uint64_t seed)
+{
+    std::vector<std::size_t> indices(n);
+    std::iota(indices.begin(), indices.end(), std::size_t(0));
+    // std::shuffle's algorithm isn't specified, so shuffle by hand to get the same order from every standard library.
+    std::mt19937_64 generator(seed);
+    for (std::size_t i = n; i > 1; i -= 1) {
+        std::swap(indices[i - 1], indices[generator() % i]);
+    }
+    return indices;
+}
+
+
+std::size_t cyan::bench::passes_for(std::size_t n, std::size_t min_ops)
+{
+    if (n == 0) return 0;
+    return std::max<std::size_t>(1, (min_ops + n - 1) / n);
+}
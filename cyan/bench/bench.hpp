@@ -0,0 +1,182 @@
+/**
+ * A small harness for the cyan_bench micro-benchmarks (see bench_main.cpp).
+ * Each benchmark times a fixed number of operations, once to warm up and then a number of repeats, and reports the
+ * time per operation. Inputs are generated from fixed seeds, so consecutive runs (and releases) do the same work and
+ * their results can be compared.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cyan::bench {
+    /**
+     * Options for a benchmark run, usually parsed from the command line.
+     */
+    struct BenchOptions {
+        /// The smallest and largest number of entities to benchmark with. Sizes go up by a factor of 10 from the
+        /// smallest, and the largest is always included.
+        std::size_t min_entities = 1000;
+        std::size_t max_entities = 10000000;
+        /// The largest number of resources to benchmark with (resources are files, so this is kept smaller).
+        std::size_t max_resources = 10000;
+        /// The number of timed repeats of each benchmark, after one untimed warm-up.
+        int repeats = 5;
+        /// Only benchmarks whose names contain this are run (all of them if it's empty).
+        std::string filter;
+    };
+
+    /**
+     * The timings of one benchmark at one size.
+     */
+    struct BenchResult {
+        std::string name;
+        /// The number of entities (or resources) the benchmark ran with, or 0 if it doesn't depend on a size.
+        std::size_t n = 0;
+        /// The number of operations in each repeat.
+        std::size_t ops = 0;
+        /// Nanoseconds per operation: the fastest, median and mean of the repeats.
+        double ns_per_op_min = 0.0;
+        double ns_per_op_median = 0.0;
+        double ns_per_op_mean = 0.0;
+    };
+
+    /** BenchRunner
+     * Runs benchmarks, collecting their results to be written out as JSON.
+     */
+    struct BenchRunner {
+        explicit BenchRunner(BenchOptions options);
+
+        /**
+         * Get the options the benchmarks were run with.
+         */
+        [[nodiscard]]
+        const BenchOptions& get_options() const;
+
+        /**
+         * Check whether a benchmark should run (see BenchOptions::filter).
+         */
+        [[nodiscard]]
+        bool enabled(const std::string& name) const;
+
+        /**
+         * Check whether any of a group of benchmarks should run, so the group's setup can be skipped if none will.
+         */
+        [[nodiscard]]
+        bool any_enabled(const std::vector<std::string>& names) const;
+
+        /**
+         * Get the entity counts to benchmark with: each power of 10 times min_entities, up to max_entities.
+         */
+        [[nodiscard]]
+        std::vector<std::size_t> entity_counts() const;
+
+        /**
+         * Get the resource counts to benchmark with, as for entity_counts() but up to max_resources.
+         */
+        [[nodiscard]]
+        std::vector<std::size_t> resource_counts() const;
+
+        /**
+         * Time a benchmark, if it's enabled.
+         * @param name The benchmark's name, e.g. "object_registry.get".
+         * @param n The number of entities (or resources) it runs with, or 0.
+         * @param ops The number of operations one call of fn does.
+         * @param fn The operations to time. This returns a value computed from the results of the operations (e.g. a
+         *           sum of the components looked up), so the compiler can't optimize them away.
+         * @param setup Called before every call of fn, without being timed, e.g. to reset state fn changes.
+         */
+        template <typename Fn, typename Setup>
+        void run(const std::string& name, std::size_t n, std::size_t ops, Fn&& fn, Setup&& setup) {
+            if (!enabled(name) || ops == 0) return;
+            std::vector<double> ns_per_op;
+            for (int repeat = -1; repeat < options.repeats; repeat += 1) {
+                setup();
+                auto start = std::chrono::steady_clock::now();
+                checksum += std::uint64_t(fn());
+                auto end = std::chrono::steady_clock::now();
+                // The first call is a warm-up.
+                if (repeat < 0) continue;
+                ns_per_op.push_back(double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count())
+                                    / double(ops));
+            }
+            add_result(name, n, ops, std::move(ns_per_op));
+        }
+
+        /**
+         * Time a benchmark which needs no setup between repeats.
+         */
+        template <typename Fn>
+        void run(const std::string& name, std::size_t n, std::size_t ops, Fn&& fn) {
+            run(name, n, ops, std::forward<Fn>(fn), []() {});
+        }
+
+        /**
+         * Get the results of the benchmarks run so far.
+         */
+        [[nodiscard]]
+        const std::vector<BenchResult>& get_results() const;
+
+        /**
+         * Write the results as a JSON document, along with the build configuration they were measured with.
+         */
+        void write_json(std::ostream& out) const;
+
+    private:
+        BenchOptions options;
+        std::vector<BenchResult> results;
+        /// Combines the values returned by every benchmark (see run()). It's written to the JSON, so it's used.
+        std::uint64_t checksum = 0;
+
+        /**
+         * Internal function to summarize the timings of a benchmark, and print them as progress.
+         */
+        void add_result(const std::string& name, std::size_t n, std::size_t ops, std::vector<double> ns_per_op);
+    };
+
+    /**
+     * Make the compiler treat a value as used, and memory as possibly changed, at this point. Calling this on the
+     * result of each operation in a loop stops the operations from being folded into a constant or hoisted out of the
+     * loop (which returning a sum from the benchmark doesn't, when every operation gives the same result).
+     */
+    template <typename T>
+    inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static const void* volatile sink;
+        sink = &value;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
+
+    /**
+     * Make a repeatable random permutation of 0..n-1.
+     * @param n The number of indices.
+     * @param seed The seed, so different benchmarks can visit in different orders.
+     */
+    std::vector<std::size_t> shuffled_indices(std::size_t n, std::uint64_t seed);
+
+    /**
+     * Get the number of times to repeat a pass over n items, so a pass of a small size still takes long enough to
+     * time: at least min_ops operations in total.
+     */
+    std::size_t passes_for(std::size_t n, std::size_t min_ops);
+
+    /**
+     * Run the benchmarks of the ECS (bench_ecs.cpp).
+     */
+    void run_ecs_benchmarks(BenchRunner& runner);
+
+    /**
+     * Run the benchmarks of resources and modules (bench_resource.cpp).
+     */
+    void run_resource_benchmarks(BenchRunner& runner);
+}
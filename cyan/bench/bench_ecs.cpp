@@ -0,0 +1,235 @@
+#include "bench.hpp"
+#include "cyan/src/engine/ecs/ecs.hpp"
+#include "cyan/src/engine/ecs/object_registry.hpp"
+#include "cyan/src/engine/ecs/single_component_registry.hpp"
+
+#include <cstdint>
+#include <memory>
+
+using namespace cyan;
+using namespace cyan::bench;
+
+namespace {
+    /// Lookups in each repeat of a benchmark, at least, however few entities there are.
+    constexpr std::size_t MIN_LOOKUP_OPS = 1000000;
+
+    /// The component type the benchmarks store.
+    struct BenchValue {
+        std::uint64_t value = 0;
+    };
+
+    /**
+     * Make the IDs a newer generation of the given entities would have, which fail lookups after finding the entity's
+     * slot (like the IDs of deleted entities).
+     */
+    std::vector<Entity> make_stale(const std::vector<Entity>& entities) {
+        std::vector<Entity> stale;
+        stale.reserve(entities.size());
+        for (auto e : entities) {
+            auto generation = (ecs_impl::get_generation(e.id) + 1) % ECS_MAX_GENERATION;
+            stale.push_back(Entity{ecs_impl::make_ecs_id(generation, ecs_impl::get_index(e.id))});
+        }
+        return stale;
+    }
+
+    /**
+     * Put entities in a repeatable random order, so lookups don't just walk memory in order.
+     */
+    std::vector<Entity> shuffled(const std::vector<Entity>& entities, std::uint64_t seed) {
+        std::vector<Entity> result;
+        result.reserve(entities.size());
+        for (auto index : shuffled_indices(entities.size(), seed)) {
+            result.push_back(entities[index]);
+        }
+        return result;
+    }
+
+    /**
+     * ObjectRegistry: lookups, and removing and re-adding objects at random while looking others up.
+     */
+    void bench_object_registry(BenchRunner& runner, std::size_t n) {
+        if (!runner.any_enabled({"object_registry.get", "object_registry.churn"})) return;
+        ecs_impl::ObjectRegistry<BenchValue> registry;
+        std::vector<EcsIdT> ids(n);
+        for (std::size_t i = 0; i < n; i += 1) {
+            ids[i] = registry.add(BenchValue{i}).id;
+        }
+        auto order = shuffled_indices(n, 1);
+        auto lookup_order = shuffled_indices(n, 2);
+        auto passes = passes_for(n, MIN_LOOKUP_OPS);
+
+        runner.run("object_registry.get", n, n * passes, [&]() {
+            std::uint64_t sum = 0;
+            for (std::size_t pass = 0; pass < passes; pass += 1) {
+                for (auto index : order) {
+                    sum += registry.get(ids[index]).value->value;
+                }
+            }
+            return sum;
+        });
+
+        // Each operation removes an object, adds a replacement (reusing a free slot) and looks up another object.
+        runner.run("object_registry.churn", n, n, [&]() {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < n; i += 1) {
+                auto index = order[i];
+                registry.remove(ids[index]);
+                ids[index] = registry.add(BenchValue{index}).id;
+                if (auto entry = registry.get(ids[lookup_order[i]])) sum += entry->value;
+            }
+            return sum;
+        });
+    }
+
+    /**
+     * SingleComponentRegistry::get(Entity), for entities with a component and for stale entity IDs.
+     */
+    void bench_single_component_registry(BenchRunner& runner, std::size_t n) {
+        if (!runner.any_enabled({"single_component_registry.get.hit", "single_component_registry.get.stale"})) {
+            return;
+        }
+        SingleComponentRegistry<BenchValue> registry;
+        std::vector<Entity> entities;
+        entities.reserve(n);
+        for (std::size_t i = 0; i < n; i += 1) {
+            Entity e{ecs_impl::make_ecs_id(0, EcsIndexT(i))};
+            registry.add(e, BenchValue{i});
+            entities.push_back(e);
+        }
+        auto hits = shuffled(entities, 3);
+        auto stale = make_stale(hits);
+        auto passes = passes_for(n, MIN_LOOKUP_OPS);
+
+        runner.run("single_component_registry.get.hit", n, n * passes, [&]() {
+            std::uint64_t sum = 0;
+            for (std::size_t pass = 0; pass < passes; pass += 1) {
+                for (auto e : hits) {
+                    sum += registry.get(e).value->value;
+                }
+            }
+            return sum;
+        });
+        runner.run("single_component_registry.get.stale", n, n * passes, [&]() {
+            std::uint64_t misses = 0;
+            for (std::size_t pass = 0; pass < passes; pass += 1) {
+                for (auto e : stale) {
+                    misses += registry.get(e).value == nullptr;
+                }
+            }
+            return misses;
+        });
+    }
+
+    /**
+     * ECS::get_component(), which checks the entity exists and has the component before looking in the registry, for
+     * live entities and for stale entity IDs (which fail the check), and the same lookups batched with
+     * ECS::get_components().
+     */
+    void bench_ecs(BenchRunner& runner, std::size_t n) {
+        if (!runner.any_enabled({"ecs.get_component.hit", "ecs.get_component.stale", "ecs.get_components.hit",
+                                 "ecs.exists"})) {
+            return;
+        }
+        auto ecs = std::make_unique<ECS>();
+        std::vector<Entity> entities;
+        ecs->new_entities(n, entities);
+        for (std::size_t i = 0; i < n; i += 1) {
+            ecs->add_component<BenchValue>(entities[i], BenchValue{i});
+        }
+        auto hits = shuffled(entities, 4);
+        auto stale = make_stale(hits);
+        auto passes = passes_for(n, MIN_LOOKUP_OPS);
+
+        runner.run("ecs.get_component.hit", n, n * passes, [&]() {
+            std::uint64_t sum = 0;
+            for (std::size_t pass = 0; pass < passes; pass += 1) {
+                for (auto e : hits) {
+                    sum += ecs->get_component<BenchValue>(e).value->value;
+                }
+            }
+            return sum;
+        });
+        runner.run("ecs.get_component.stale", n, n * passes, [&]() {
+            std::uint64_t misses = 0;
+            for (std::size_t pass = 0; pass < passes; pass += 1) {
+                for (auto e : stale) {
+                    misses += ecs->get_component<BenchValue>(e).value == nullptr;
+                }
+            }
+            return misses;
+        });
+        std::vector<const BenchValue*> found;
+        runner.run("ecs.get_components.hit", n, n * passes, [&]() {
+            std::uint64_t sum = 0;
+            for (std::size_t pass = 0; pass < passes; pass += 1) {
+                ecs->get_components(hits, found);
+                for (auto component : found) {
+                    sum += component->value;
+                }
+            }
+            return sum;
+        });
+        runner.run("ecs.exists", n, n * passes, [&]() {
+            std::uint64_t found = 0;
+            for (std::size_t pass = 0; pass < passes; pass += 1) {
+                for (auto e : hits) {
+                    found += ecs->exists(e);
+                }
+            }
+            return found;
+        });
+    }
+
+    /**
+     * ComponentMap registry lookups by type, which don't depend on the number of entities.
+     */
+    void bench_component_map(BenchRunner& runner) {
+        if (!runner.any_enabled({"component_map.get_component_registry",
+                                  "component_map.get_component_registry.generated", "component_map.get_registry"})) {
+            return;
+        }
+        ecs_impl::ComponentMap component_map;
+        component_map.register_component_type<BenchValue>("BenchValue");
+        auto type_id = component_map.get_component_type_id<BenchValue>();
+
+        runner.run("component_map.get_component_registry", 0, MIN_LOOKUP_OPS, [&]() {
+            std::uintptr_t sum = 0;
+            for (std::size_t i = 0; i < MIN_LOOKUP_OPS; i += 1) {
+                auto registry = component_map.get_component_registry<BenchValue>();
+                do_not_optimize(registry);
+                sum += reinterpret_cast<std::uintptr_t>(registry);
+            }
+            return sum;
+        });
+        // Generated registries are found at compile time, so this is the baseline the other lookups are compared to.
+        runner.run("component_map.get_component_registry.generated", 0, MIN_LOOKUP_OPS, [&]() {
+            std::uintptr_t sum = 0;
+            for (std::size_t i = 0; i < MIN_LOOKUP_OPS; i += 1) {
+                auto registry = component_map.get_component_registry<component::DebugName>();
+                do_not_optimize(registry);
+                sum += reinterpret_cast<std::uintptr_t>(registry);
+            }
+            return sum;
+        });
+        runner.run("component_map.get_registry", 0, MIN_LOOKUP_OPS, [&]() {
+            std::uintptr_t sum = 0;
+            for (std::size_t i = 0; i < MIN_LOOKUP_OPS; i += 1) {
+                auto registry = component_map.get_registry(type_id);
+                do_not_optimize(registry);
+                sum += reinterpret_cast<std::uintptr_t>(registry);
+            }
+            return sum;
+        });
+    }
+}
+
+
+void cyan::bench::run_ecs_benchmarks(BenchRunner& runner)
+{
+    bench_component_map(runner);
+    for (auto n : runner.entity_counts()) {
+        bench_object_registry(runner, n);
+        bench_single_component_registry(runner, n);
+        bench_ecs(runner, n);
+    }
+}
@@ -0,0 +1,89 @@
+/**
+ * cyan_bench runs micro-benchmarks of the engine's hot paths (ECS lookups and churn, resource lookups), at a range of
+ * entity counts, and prints the results as JSON to stdout (progress goes to stderr), so they can be saved and compared
+ * between releases.
+ *
+ * Usage: cyan_bench [--min-entities N] [--max-entities N] [--max-resources N] [--repeats N] [--filter TEXT]
+ *                   [--out FILE]
+ * By default, entity counts go from 1000 up to 10000000 by factors of 10, and resource counts up to 10000. Benchmarks
+ * should be run from an optimized build.
+ */
+
+#include "bench.hpp"
+#include "cyan/src/logging/error.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace cyan::bench;
+
+namespace {
+    constexpr const char* USAGE = "Usage: cyan_bench [--min-entities N] [--max-entities N] [--max-resources N] "
+                                  "[--repeats N] [--filter TEXT] [--out FILE]";
+
+    /**
+     * Parse the command line into BenchOptions.
+     * @param out_path Set to the file given with --out, if any.
+     * @throws cyan::Error on an unknown or incomplete argument.
+     */
+    BenchOptions parse_args(int argc, char** argv, std::string& out_path) {
+        BenchOptions options;
+        for (int i = 1; i < argc; i += 1) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) throw cyan::Error("Argument \"{}\" is missing a value, or isn't recognized", arg);
+            std::string value = argv[i + 1];
+            i += 1;
+            if (arg == "--min-entities") {
+                options.min_entities = std::stoull(value);
+            } else if (arg == "--max-entities") {
+                options.max_entities = std::stoull(value);
+            } else if (arg == "--max-resources") {
+                options.max_resources = std::stoull(value);
+            } else if (arg == "--repeats") {
+                options.repeats = std::stoi(value);
+            } else if (arg == "--filter") {
+                options.filter = value;
+            } else if (arg == "--out") {
+                out_path = value;
+            } else {
+                throw cyan::Error("Unrecognized argument \"{}\"", arg);
+            }
+        }
+        return options;
+    }
+}
+
+
+int main(int argc, char** argv) {
+    if (argc == 2 && std::string(argv[1]) == "--help") {
+        std::cout << USAGE << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    std::string out_path;
+    BenchOptions options;
+    try {
+        options = parse_args(argc, argv, out_path);
+    } catch (std::exception& err) {
+        std::cerr << err.what() << "\n" << USAGE << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    BenchRunner runner(options);
+    run_ecs_benchmarks(runner);
+    run_resource_benchmarks(runner);
+
+    if (out_path.empty()) {
+        runner.write_json(std::cout);
+    } else {
+        std::ofstream out(out_path);
+        runner.write_json(out);
+        if (!out) {
+            std::cerr << "Couldn't write the results to \"" << out_path << "\"" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
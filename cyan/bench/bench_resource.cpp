@@ -0,0 +1,105 @@
+#include "bench.hpp"
+#include "cyan/src/engine/resource/resource_manager.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+using namespace cyan;
+using namespace cyan::bench;
+
+namespace {
+    /// Operations in each repeat of a benchmark, at least. Resource lookups touch the filesystem, so this is far fewer
+    /// than the ECS benchmarks do.
+    constexpr std::size_t MIN_RESOURCE_OPS = 10000;
+
+    /**
+     * A module of n small scripts in a temporary directory, which is deleted along with the module.
+     */
+    struct TempModule {
+        explicit TempModule(std::size_t n) {
+            auto suffix = std::chrono::steady_clock::now().time_since_epoch().count();
+            location = std::filesystem::temp_directory_path() / ("cyan_bench_" + std::to_string(suffix));
+            std::filesystem::create_directories(location / "script");
+            for (std::size_t i = 0; i < n; i += 1) {
+                auto resource_path = "script/s" + std::to_string(i) + ".chai";
+                std::ofstream(location / resource_path) << "var x = " << i << ";";
+                names.emplace_back("bench::" + resource_path);
+            }
+        }
+
+        ~TempModule() {
+            std::error_code ignored;
+            std::filesystem::remove_all(location, ignored);
+        }
+
+        TempModule(const TempModule&) = delete;
+        TempModule& operator=(const TempModule&) = delete;
+
+        std::filesystem::path location;
+        /// The name of each script, in the module "bench".
+        std::vector<ResourceName> names;
+    };
+
+    /**
+     * ResourceManager::get_resource() for resources which are already loaded (hits) and which have to be loaded from
+     * their file (misses), and the ModuleManager::resolve_resource_path() every lookup starts with.
+     */
+    void bench_resources(BenchRunner& runner, std::size_t n) {
+        if (!runner.any_enabled({"resource_manager.get_resource.miss", "resource_manager.get_resource.hit",
+                                 "module_manager.resolve_resource_path"})) {
+            return;
+        }
+        TempModule module(n);
+        auto order = shuffled_indices(n, 5);
+        auto passes = passes_for(n, MIN_RESOURCE_OPS);
+        std::unique_ptr<ResourceManager> resource_manager;
+        auto reset_resource_manager = [&]() {
+            resource_manager = std::make_unique<ResourceManager>();
+            resource_manager->module_manager().add_module("bench", module.location.string());
+        };
+
+        // Every repeat starts with an empty resource manager, so each get loads a script.
+        runner.run("resource_manager.get_resource.miss", n, n, [&]() {
+            std::size_t bytes = 0;
+            for (auto index : order) {
+                bytes += resource_manager->get_resource<resource::Script>(module.names[index])->source.size();
+            }
+            return bytes;
+        }, reset_resource_manager);
+
+        reset_resource_manager();
+        for (auto& name : module.names) {
+            resource_manager->get_resource<resource::Script>(name);
+        }
+        runner.run("resource_manager.get_resource.hit", n, n * passes, [&]() {
+            std::size_t bytes = 0;
+            for (std::size_t pass = 0; pass < passes; pass += 1) {
+                for (auto index : order) {
+                    bytes += resource_manager->get_resource<resource::Script>(module.names[index])->source.size();
+                }
+            }
+            return bytes;
+        });
+
+        auto& module_manager = resource_manager->module_manager();
+        runner.run("module_manager.resolve_resource_path", n, n * passes, [&]() {
+            std::size_t length = 0;
+            for (std::size_t pass = 0; pass < passes; pass += 1) {
+                for (auto index : order) {
+                    length += module_manager.resolve_resource_path(module.names[index]).size();
+                }
+            }
+            return length;
+        });
+    }
+}
+
+
+void cyan::bench::run_resource_benchmarks(BenchRunner& runner)
+{
+    for (auto n : runner.resource_counts()) {
+        bench_resources(runner, n);
+    }
+}
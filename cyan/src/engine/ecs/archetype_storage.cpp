@@ -0,0 +1,322 @@
+#include "archetype_storage.hpp"
+
+#include <algorithm>
+
+using namespace cyan;
+using namespace cyan::ecs_impl;
+
+
+int Archetype::column_of(int type_id) const
+{
+    auto it = std::lower_bound(type_ids.begin(), type_ids.end(), type_id);
+    if (it == type_ids.end() || *it != type_id) return -1;
+    return int(it - type_ids.begin());
+}
+
+
+bool Archetype::contains_all(const int* query_type_ids, std::size_t n) const
+{
+    for (std::size_t i = 0; i < n; i += 1) {
+        if (column_of(query_type_ids[i]) < 0) return false;
+    }
+    return true;
+}
+
+
+std::size_t Archetype::chunk_size(std::size_t chunk) const
+{
+    return std::min(chunk_capacity, size - chunk * chunk_capacity);
+}
+
+
+ArchetypeStorage::ArchetypeStorage()
+{
+    // The empty archetype always exists at index 0, so entities that lose their last component have somewhere to go.
+    find_or_create_archetype({});
+}
+
+
+ArchetypeStorage::~ArchetypeStorage()
+{
+    for (auto& archetype : archetypes) {
+        for (std::size_t row = 0; row < archetype->size; row += 1) {
+            for (std::size_t column = 0; column < archetype->columns.size(); column += 1) {
+                archetype->columns[column].destroy(archetype->component(row, column));
+            }
+        }
+    }
+}
+
+
+void* ArchetypeStorage::get(Entity e, ComponentTypeId type_id)
+{
+    auto location = find_location(e);
+    if (!location) return nullptr;
+    auto& archetype = *archetypes[location->archetype];
+    auto column = archetype.column_of(type_id.id);
+    if (column < 0) return nullptr;
+    return archetype.component(location->row, column);
+}
+
+
+bool ArchetypeStorage::has(Entity e, ComponentTypeId type_id)
+{
+    auto location = find_location(e);
+    return location && archetypes[location->archetype]->column_of(type_id.id) >= 0;
+}
+
+
+void ArchetypeStorage::remove(Entity e, ComponentTypeId type_id)
+{
+    auto location = find_location(e);
+    if (!location) return;
+    auto archetype_index = location->archetype;
+    auto& archetype = *archetypes[archetype_index];
+    auto column = archetype.column_of(type_id.id);
+    if (column < 0) return;
+
+    auto edge = archetype.remove_edges.find(type_id.id);
+    std::size_t target;
+    if (edge != archetype.remove_edges.end()) {
+        target = edge->second;
+    } else {
+        auto target_type_ids = archetype.type_ids;
+        target_type_ids.erase(target_type_ids.begin() + column);
+        target = find_or_create_archetype(std::move(target_type_ids));
+        archetypes[archetype_index]->remove_edges.insert({type_id.id, target});
+    }
+
+    // Destroy the removed component before moving the rest of the row, so move_entity() only has to deal with columns
+    // present in both archetypes.
+    auto& source = *archetypes[archetype_index];
+    source.columns[column].destroy(source.component(location->row, column));
+    move_entity(*location, target);
+}
+
+
+void ArchetypeStorage::remove_entity(Entity e)
+{
+    auto location = find_location(e);
+    if (!location) return;
+    auto& archetype = *archetypes[location->archetype];
+    for (std::size_t column = 0; column < archetype.columns.size(); column += 1) {
+        archetype.columns[column].destroy(archetype.component(location->row, column));
+    }
+    // Entities in the empty archetype don't have a row.
+    if (!archetype.type_ids.empty()) {
+        remove_row(location->archetype, location->row);
+    }
+    *location = EntityLocation{};
+}
+
+
+std::size_t ArchetypeStorage::count(ComponentTypeId type_id) const
+{
+    std::size_t total = 0;
+    for (auto& archetype : archetypes) {
+        if (archetype->column_of(type_id.id) >= 0) total += archetype->size;
+    }
+    return total;
+}
+
+
+std::size_t ArchetypeStorage::memory_bytes() const
+{
+    std::size_t total = locations.capacity() * sizeof(EntityLocation);
+    for (auto& archetype : archetypes) {
+        total += archetype->chunks.size() * sizeof(ArchetypeChunk);
+    }
+    return total;
+}
+
+
+bool ArchetypeStorage::next_matching_chunk(const int* query_type_ids, std::size_t n,
+                                           std::size_t& archetype, std::size_t& chunk,
+                                           ArchetypeChunkView& out_view, void** out_columns)
+{
+    for (; archetype < archetypes.size(); archetype += 1, chunk = 0) {
+        auto& candidate = *archetypes[archetype];
+        if (chunk >= candidate.chunks.size() || !candidate.contains_all(query_type_ids, n)) continue;
+
+        out_view.entity_ids = candidate.entity_ids(chunk);
+        out_view.count = candidate.chunk_size(chunk);
+        for (std::size_t i = 0; i < n; i += 1) {
+            out_columns[i] = candidate.column_data(chunk, candidate.column_of(query_type_ids[i]));
+        }
+        return true;
+    }
+    return false;
+}
+
+
+void ArchetypeStorage::register_type(const ComponentTypeInfo& info)
+{
+    auto id = std::size_t(info.type_id.id);
+    if (id < type_registered.size() && type_registered[id]) return;
+    if (type_infos.size() <= id) {
+        type_infos.resize(id + 1);
+        type_registered.resize(id + 1, false);
+    }
+    type_infos[id] = info;
+    type_registered[id] = true;
+}
+
+
+ArchetypeStorage::EntityLocation* ArchetypeStorage::find_location(Entity e)
+{
+    auto index = get_index(e.id);
+    if (index >= locations.size() || locations[index].entity != e.id) return nullptr;
+    return &locations[index];
+}
+
+
+void* ArchetypeStorage::add_uninitialized(Entity e, ComponentTypeId type_id)
+{
+    auto index = get_index(e.id);
+    if (locations.size() <= index) {
+        locations.resize(index + 1);
+    }
+    auto& location = locations[index];
+    if (location.entity != e.id) {
+        // First component for this entity. If the slot belongs to an older generation of the entity (i.e. it was
+        // deleted without it's components being removed), it's components are orphaned and can be destroyed. If it
+        // belongs to a newer generation, this entity must have been deleted, so the add is refused (as with
+        // SingleComponentRegistry).
+        if (location.entity != ECS_NULL_INDEX) {
+            if (get_generation(location.entity) > get_generation(e.id)) {
+                LOG(WARN, "Attempted to add a component (type id {}) to entity {}, but a newer entity {} has replaced "
+                          "it. The provided component will be discarded.", type_id.id, e.id, location.entity);
+                return nullptr;
+            }
+            remove_entity(Entity{location.entity});
+        }
+        location = EntityLocation{e.id, 0, 0};
+    }
+
+    auto& archetype = *archetypes[location.archetype];
+    auto edge = archetype.add_edges.find(type_id.id);
+    std::size_t target;
+    if (edge != archetype.add_edges.end()) {
+        target = edge->second;
+    } else {
+        auto target_type_ids = archetype.type_ids;
+        target_type_ids.insert(
+                std::lower_bound(target_type_ids.begin(), target_type_ids.end(), type_id.id), type_id.id);
+        auto source_archetype = location.archetype;
+        target = find_or_create_archetype(std::move(target_type_ids));
+        archetypes[source_archetype]->add_edges.insert({type_id.id, target});
+    }
+
+    move_entity(location, target);
+    auto& target_archetype = *archetypes[target];
+    return target_archetype.component(location.row, target_archetype.column_of(type_id.id));
+}
+
+
+std::size_t ArchetypeStorage::find_or_create_archetype(std::vector<int> type_ids)
+{
+    auto it = archetype_lookup.find(type_ids);
+    if (it != archetype_lookup.end()) return it->second;
+
+    auto archetype = std::make_unique<Archetype>();
+    std::size_t row_bytes = sizeof(EcsIdT);
+    for (auto type_id : type_ids) {
+        archetype->columns.push_back(type_infos[type_id]);
+        row_bytes += type_infos[type_id].size;
+    }
+    archetype->type_ids = std::move(type_ids);
+
+    // Work out how many rows fit in a chunk. Start from the unpadded estimate and reduce it until the columns (each
+    // aligned to it's type's alignment) fit.
+    auto layout = [&](std::size_t capacity) {
+        archetype->column_offsets.clear();
+        std::size_t offset = sizeof(EcsIdT) * capacity;
+        for (auto& column : archetype->columns) {
+            offset = (offset + column.alignment - 1) / column.alignment * column.alignment;
+            archetype->column_offsets.push_back(offset);
+            offset += column.size * capacity;
+        }
+        return offset;
+    };
+    std::size_t capacity = ARCHETYPE_CHUNK_BYTES / row_bytes;
+    while (capacity > 0 && layout(capacity) > ARCHETYPE_CHUNK_BYTES) {
+        capacity -= 1;
+    }
+    if (capacity == 0) {
+        throw cyan::Error("Components of an archetype are too large ({} bytes) to fit in a {} byte chunk",
+                          row_bytes, ARCHETYPE_CHUNK_BYTES);
+    }
+    archetype->chunk_capacity = capacity;
+
+    auto index = archetypes.size();
+    archetype_lookup.insert({archetype->type_ids, index});
+    archetypes.push_back(std::move(archetype));
+    return index;
+}
+
+
+std::size_t ArchetypeStorage::allocate_row(Archetype& archetype, EcsIdT entity)
+{
+    auto row = archetype.size;
+    if (row / archetype.chunk_capacity >= archetype.chunks.size()) {
+        // Chunks are deliberately left uninitialized (rows are constructed as they're allocated).
+        archetype.chunks.push_back(std::unique_ptr<ArchetypeChunk>(new ArchetypeChunk));
+    }
+    archetype.size += 1;
+    archetype.entity_ids(row / archetype.chunk_capacity)[row % archetype.chunk_capacity] = entity;
+    return row;
+}
+
+
+void ArchetypeStorage::move_entity(EntityLocation& location, std::size_t target_archetype_index)
+{
+    auto source_archetype_index = location.archetype;
+    auto source_row = location.row;
+    auto& target = *archetypes[target_archetype_index];
+    auto& source = *archetypes[source_archetype_index];
+
+    // The empty archetype doesn't store rows.
+    std::size_t target_row = 0;
+    if (!target.type_ids.empty()) {
+        target_row = allocate_row(target, location.entity);
+    }
+
+    if (!source.type_ids.empty()) {
+        // Relocate each component present in both archetypes. Components that are only present in the source have
+        // already been destroyed by the caller.
+        for (std::size_t column = 0; column < target.columns.size(); column += 1) {
+            auto source_column = source.column_of(target.type_ids[column]);
+            if (source_column < 0) continue;
+            target.columns[column].relocate(
+                    target.component(target_row, column), source.component(source_row, source_column));
+        }
+        remove_row(source_archetype_index, source_row);
+    }
+
+    location.archetype = target_archetype_index;
+    location.row = target_row;
+}
+
+
+void ArchetypeStorage::remove_row(std::size_t archetype_index, std::size_t row)
+{
+    // The row's components must already have been destroyed or relocated - fill the hole with the last row.
+    auto& archetype = *archetypes[archetype_index];
+    auto last_row = archetype.size - 1;
+    if (row != last_row) {
+        auto capacity = archetype.chunk_capacity;
+        auto moved_entity = archetype.entity_ids(last_row / capacity)[last_row % capacity];
+        for (std::size_t column = 0; column < archetype.columns.size(); column += 1) {
+            archetype.columns[column].relocate(archetype.component(row, column), archetype.component(last_row, column));
+        }
+        archetype.entity_ids(row / capacity)[row % capacity] = moved_entity;
+        locations[get_index(moved_entity)].row = row;
+    }
+    archetype.size -= 1;
+
+    // Release the last chunk once it's empty.
+    auto n_chunks_needed = (archetype.size + archetype.chunk_capacity - 1) / archetype.chunk_capacity;
+    if (archetype.chunks.size() > n_chunks_needed) {
+        archetype.chunks.pop_back();
+    }
+}
@@ -0,0 +1,247 @@
+/** archetype_storage.hpp
+ * An alternative component storage engine for the ECS, where all components of an entity are stored together.
+ *
+ * Entities with exactly the same set of component types belong to the same archetype. Each archetype stores it's
+ * entities in fixed-size chunks, with each chunk laid out as a structure of arrays (an array of entity IDs, followed by
+ * one array per component type). Adding or removing a component moves the entity (and it's other components) to the
+ * archetype for it's new component set. Iterating over entities with a given set of components is a linear scan over
+ * the chunks of every archetype that contains those components.
+ */
+
+#pragma once
+
+#include "component_map.hpp"
+#include "ecs_common.hpp"
+#include "entity.hpp"
+#include "cyan/src/logging/error.hpp"
+#include "cyan/src/logging/logger.hpp"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cyan::ecs_impl {
+    /// Size (in bytes) of each archetype chunk.
+    constexpr std::size_t ARCHETYPE_CHUNK_BYTES = 16 * 1024;
+    /// Chunks are aligned to this, which is the largest component alignment supported by archetype storage.
+    constexpr std::size_t ARCHETYPE_CHUNK_ALIGNMENT = 64;
+
+    /**
+     * Type-erased information about a component type, used to move and destroy components stored in archetype chunks.
+     */
+    struct ComponentTypeInfo {
+        ComponentTypeId type_id;
+        std::size_t size;
+        std::size_t alignment;
+        /// Move-construct the object at source into (uninitialized) destination, then destroy the object at source.
+        void (*relocate)(void* destination, void* source);
+        /// Destroy the object.
+        void (*destroy)(void* object);
+
+        template <typename T>
+        static ComponentTypeInfo of(ComponentTypeId type_id) {
+            static_assert(alignof(T) <= ARCHETYPE_CHUNK_ALIGNMENT,
+                          "Component alignment is too large for archetype storage");
+            return ComponentTypeInfo{
+                type_id,
+                sizeof(T),
+                alignof(T),
+                [](void* destination, void* source) {
+                    new (destination) T(std::move(*static_cast<T*>(source)));
+                    static_cast<T*>(source)->~T();
+                },
+                [](void* object) { static_cast<T*>(object)->~T(); }
+            };
+        }
+    };
+
+    /**
+     * A fixed-size block of memory holding a number of rows of an archetype.
+     */
+    struct alignas(ARCHETYPE_CHUNK_ALIGNMENT) ArchetypeChunk {
+        std::byte data[ARCHETYPE_CHUNK_BYTES];
+    };
+
+    /**
+     * An archetype: the storage for all entities with one particular set of component types.
+     * Rows are packed - every chunk except the last is full, and removing a row moves the archetype's last row into it.
+     */
+    struct Archetype {
+        /// The component type IDs of the archetype, sorted.
+        std::vector<int> type_ids;
+        /// Type information for each column (in the same order as type_ids).
+        std::vector<ComponentTypeInfo> columns;
+        /// Byte offset of each column's array within a chunk. The entity ID array is at offset 0.
+        std::vector<std::size_t> column_offsets;
+        /// Number of rows that fit in a single chunk.
+        std::size_t chunk_capacity = 0;
+        /// Number of rows in the archetype.
+        std::size_t size = 0;
+        std::vector<std::unique_ptr<ArchetypeChunk>> chunks;
+        /// Cached transitions to other archetypes when a component type is added or removed.
+        std::unordered_map<int, std::size_t> add_edges;
+        std::unordered_map<int, std::size_t> remove_edges;
+
+        /// Get the column holding a component type, or -1 if this archetype doesn't have the type.
+        [[nodiscard]]
+        int column_of(int type_id) const;
+
+        /// Test if the archetype contains all of the given component types.
+        [[nodiscard]]
+        bool contains_all(const int* query_type_ids, std::size_t n) const;
+
+        /// Get the number of rows stored in a chunk.
+        [[nodiscard]]
+        std::size_t chunk_size(std::size_t chunk) const;
+
+        /// Get the entity ID array of a chunk.
+        EcsIdT* entity_ids(std::size_t chunk) {
+            return reinterpret_cast<EcsIdT*>(chunks[chunk]->data);
+        }
+
+        /// Get a column's array within a chunk.
+        void* column_data(std::size_t chunk, std::size_t column) {
+            return chunks[chunk]->data + column_offsets[column];
+        }
+
+        /// Get a pointer to a single component.
+        void* component(std::size_t row, std::size_t column) {
+            return static_cast<std::byte*>(column_data(row / chunk_capacity, column))
+                   + (row % chunk_capacity) * columns[column].size;
+        }
+    };
+
+    /**
+     * A view of one chunk's worth of rows, as handed out to iteration.
+     */
+    struct ArchetypeChunkView {
+        const EcsIdT* entity_ids = nullptr;
+        std::size_t count = 0;
+    };
+
+    /** ArchetypeStorage
+     * Stores components grouped by archetype (see the file comment).
+     * Component types are identified by their ComponentTypeId, which must be provided by the caller (the ECS uses its
+     * ComponentMap for this).
+     * Pointers returned by this storage are invalidated by any addition or removal of a component on any entity in the
+     * same archetype (as rows move), so they should not be held.
+     */
+    struct ArchetypeStorage {
+        ArchetypeStorage();
+        ~ArchetypeStorage();
+        ArchetypeStorage(const ArchetypeStorage&) = delete;
+        ArchetypeStorage& operator=(const ArchetypeStorage&) = delete;
+
+        /**
+         * Add a component to an entity, moving the entity to it's new archetype.
+         * If the entity already has a component of this type, the existing component is returned and the provided
+         * component is discarded. Aggregates are constructed with braces, as in ObjectRegistry::emplace().
+         * @return A pointer to the stored component, or nullptr if a newer generation of the entity has replaced it.
+         */
+        template <typename T, typename ...Args>
+        T* emplace(Entity e, ComponentTypeId type_id, Args&&... args) {
+            register_type(ComponentTypeInfo::of<T>(type_id));
+            if (void* existing = get(e, type_id)) {
+                LOG(WARN, "Attempted to add a component (type id {}) to entity {}, but that entity already has a "
+                          "component of this type. The provided component will be discarded.", type_id.id, e.id);
+                return static_cast<T*>(existing);
+            }
+            // Construct the component before the entity moves, so a throwing constructor leaves the storage unchanged.
+            // Moving it into the row relies on move construction not throwing, as relocating rows already does.
+            T component = [&]() -> T {
+                if constexpr (std::is_constructible_v<T, Args&&...>) {
+                    return T(std::forward<Args>(args)...);
+                } else {
+                    return T{std::forward<Args>(args)...};
+                }
+            }();
+            void* destination = add_uninitialized(e, type_id);
+            if (!destination) return nullptr;
+            return new (destination) T(std::move(component));
+        }
+
+        /**
+         * Get a pointer to a component of an entity, or nullptr if the entity doesn't have a component of the type.
+         */
+        void* get(Entity e, ComponentTypeId type_id);
+
+        /**
+         * Test if an entity has a component of the given type.
+         */
+        bool has(Entity e, ComponentTypeId type_id);
+
+        /**
+         * Remove a component from an entity, moving the entity to it's new archetype. Does nothing if the entity has no
+         * component of the type.
+         */
+        void remove(Entity e, ComponentTypeId type_id);
+
+        /**
+         * Remove (and destroy) all of an entity's components.
+         */
+        void remove_entity(Entity e);
+
+        /**
+         * Get the number of archetypes that have been created.
+         */
+        [[nodiscard]]
+        std::size_t archetype_count() const { return archetypes.size(); }
+
+        /**
+         * Get the total number of components of a type stored.
+         */
+        [[nodiscard]]
+        std::size_t count(ComponentTypeId type_id) const;
+
+        /**
+         * Get the (approximate) number of bytes allocated for chunks and entity locations.
+         */
+        [[nodiscard]]
+        std::size_t memory_bytes() const;
+
+        /**
+         * Find the next chunk (at or after the given archetype/chunk position) whose archetype contains all of the
+         * queried component types. This is the building block for iteration.
+         * @param query_type_ids The component types to match.
+         * @param n The number of component types.
+         * @param archetype The archetype index to start at. Updated to the archetype of the found chunk.
+         * @param chunk The chunk index to start at. Updated to the index of the found chunk.
+         * @param out_view Filled in with the found chunk's entity IDs and row count.
+         * @param out_columns Filled in with a pointer to the array of each queried component type, in query order.
+         * @return Whether a chunk was found.
+         */
+        bool next_matching_chunk(const int* query_type_ids, std::size_t n,
+                                 std::size_t& archetype, std::size_t& chunk,
+                                 ArchetypeChunkView& out_view, void** out_columns);
+
+    private:
+        /// Where an entity's components are stored.
+        struct EntityLocation {
+            EcsIdT entity = ECS_NULL_INDEX;
+            std::size_t archetype = 0;
+            std::size_t row = 0;
+        };
+
+        /// The archetypes. Index 0 is always the empty archetype (no component types), which stores no rows.
+        std::vector<std::unique_ptr<Archetype>> archetypes;
+        std::map<std::vector<int>, std::size_t> archetype_lookup;
+        /// Type information for each component type seen so far, indexed by type ID.
+        std::vector<ComponentTypeInfo> type_infos;
+        std::vector<bool> type_registered;
+        /// Location of each entity with components, indexed by entity index.
+        std::vector<EntityLocation> locations;
+
+        void register_type(const ComponentTypeInfo& info);
+        EntityLocation* find_location(Entity e);
+        void* add_uninitialized(Entity e, ComponentTypeId type_id);
+        std::size_t find_or_create_archetype(std::vector<int> type_ids);
+        std::size_t allocate_row(Archetype& archetype, EcsIdT entity);
+        void move_entity(EntityLocation& location, std::size_t target_archetype_index);
+        void remove_row(std::size_t archetype_index, std::size_t row);
+    };
+}
@@ -0,0 +1,145 @@
+#include "command_buffer.hpp"
+
+#include <limits>
+
+using namespace cyan;
+
+namespace {
+    /**
+     * Calls a function when it goes out of scope, so cleanup also happens when an exception is thrown.
+     */
+    template <typename Fn>
+    struct OnScopeExit {
+        explicit OnScopeExit(Fn fn) : fn(std::move(fn)) {}
+        OnScopeExit(const OnScopeExit&) = delete;
+        OnScopeExit& operator=(const OnScopeExit&) = delete;
+        ~OnScopeExit() { fn(); }
+
+    private:
+        Fn fn;
+    };
+}
+
+std::atomic<EcsIndexT> EcsCommandBuffer::next_placeholder_index(0);
+
+
+Entity EcsCommandBuffer::new_entity()
+{
+    // Placeholder indices are taken from a counter shared by every buffer, so a buffer can tell it's own placeholders
+    // from another's. They only repeat once the counter wraps around the index bits.
+    auto index = EcsIndexT(next_placeholder_index++ & ECS_INDEX_MASK);
+    auto placeholder = Entity{ecs_impl::make_ecs_id(ECS_RESERVED_GENERATION, index)};
+    auto number = placeholder_numbers.size();
+    placeholder_numbers[index] = number;
+    commands.emplace_back([](ECS& ecs, EcsCommandBuffer& buffer) {
+        // Commands are applied in order, so this entity belongs to the next unresolved placeholder.
+        buffer.created_entities.push_back(ecs.new_entity());
+    });
+    return placeholder;
+}
+
+
+void EcsCommandBuffer::delete_entity(Entity e)
+{
+    commands.emplace_back([e](ECS& ecs, EcsCommandBuffer& buffer) {
+        ecs.delete_entity(buffer.resolve(e));
+    });
+}
+
+
+void EcsCommandBuffer::reserve(std::size_t n_commands)
+{
+    commands.reserve(n_commands);
+}
+
+
+std::vector<Entity> EcsCommandBuffer::apply(ECS& ecs)
+{
+    // If a command throws, the rest are discarded along with it, rather than left to be applied again.
+    OnScopeExit clear_commands([this]() { clear(); });
+    created_entities.clear();
+    created_entities.reserve(placeholder_numbers.size());
+    for (auto& command : commands) {
+        command(ecs, *this);
+    }
+    return std::move(created_entities);
+}
+
+
+void EcsCommandBuffer::clear()
+{
+    commands.clear();
+    placeholder_numbers.clear();
+    created_entities.clear();
+}
+
+
+bool EcsCommandBuffer::is_placeholder(Entity e)
+{
+    return ecs_impl::get_generation(e.id) == ECS_RESERVED_GENERATION;
+}
+
+
+Entity EcsCommandBuffer::resolve(Entity e) const
+{
+    if (!is_placeholder(e)) return e;
+    auto number = placeholder_numbers.find(ecs_impl::get_index(e.id));
+    if (number == placeholder_numbers.end()) {
+        throw cyan::Error("Command refers to placeholder entity {}, which belongs to another command buffer", e.id);
+    }
+    if (number->second >= created_entities.size()) {
+        throw cyan::Error("Command refers to placeholder entity {}, which hasn't been created yet", e.id);
+    }
+    return created_entities[number->second];
+}
+
+
+std::atomic_uint64_t EcsCommandBufferSet::set_id_counter(0);
+
+
+EcsCommandBufferSet::EcsCommandBufferSet()
+    : set_id(set_id_counter++)
+{}
+
+
+EcsCommandBuffer& EcsCommandBufferSet::local()
+{
+    // Each thread remembers the set it used last (a set ID is never reused, so this can't match a destroyed set).
+    // Other sets find the thread's buffer in their own map, so nothing is kept per thread for sets that are gone.
+    struct LastUsed {
+        std::uint64_t set_id = std::numeric_limits<std::uint64_t>::max();
+        EcsCommandBuffer* buffer = nullptr;
+    };
+    thread_local LastUsed last_used;
+    if (last_used.set_id == set_id) return *last_used.buffer;
+
+    std::lock_guard lock(mutex);
+    auto [it, inserted] = thread_buffers.try_emplace(std::this_thread::get_id(), nullptr);
+    if (inserted) it->second = &buffers.emplace_back();
+    last_used = LastUsed{set_id, it->second};
+    return *it->second;
+}
+
+
+void EcsCommandBufferSet::apply(ECS& ecs)
+{
+    // If a buffer's command throws, the buffers after it are discarded too.
+    OnScopeExit clear_buffers([this]() {
+        for (auto& buffer : buffers) {
+            buffer.clear();
+        }
+    });
+    for (auto& buffer : buffers) {
+        buffer.apply(ecs);
+    }
+}
+
+
+std::size_t EcsCommandBufferSet::size() const
+{
+    std::size_t total = 0;
+    for (auto& buffer : buffers) {
+        total += buffer.size();
+    }
+    return total;
+}
@@ -0,0 +1,209 @@
+/** command_buffer.hpp
+ * Deferred structural changes to an ECS.
+ *
+ * Creating or deleting entities and adding or removing components can move stored components (invalidating Entry
+ * pointers and views), and isn't thread-safe. Code that wants to make such changes while iterating, or from worker
+ * threads, records them in an EcsCommandBuffer instead, and the buffer is applied later at a sync point where nothing
+ * else is using the ECS.
+ */
+
+#pragma once
+
+#include "ecs.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cyan {
+    /** EcsCommandBuffer
+     * Records entity creation/deletion and component addition/removal, to be applied to an ECS later.
+     * A buffer is not thread-safe - each thread should record into it's own buffer (see EcsCommandBufferSet).
+     * Commands are applied in the order they were recorded.
+     *
+     * new_entity() returns a placeholder entity, reserved immediately, which later commands in the same buffer can use
+     * as if it were a real entity. When the buffer is applied, each placeholder is replaced by the entity actually
+     * created. Placeholders are only meaningful to the buffer that created them: each placeholder is numbered uniquely
+     * across all buffers, so using one with another buffer is detected when that buffer is applied.
+     */
+    struct EcsCommandBuffer {
+        /**
+         * Record the creation of an entity.
+         * @return A placeholder for the entity, which can be used in later commands in this buffer.
+         */
+        Entity new_entity();
+
+        /**
+         * Record the deletion of an entity.
+         * @param e The entity (or placeholder) to delete.
+         */
+        void delete_entity(Entity e);
+
+        /**
+         * Record the addition of a component to an entity. The component is moved into the buffer, and moved into the
+         * ECS when the buffer is applied, so move-only components can be added.
+         * @param e The entity (or placeholder) to add the component to.
+         * @param component The component data.
+         */
+        template <typename T>
+        void add_component(Entity e, T component) {
+            auto holder = make_holder(std::move(component));
+            commands.emplace_back([e, holder = std::move(holder)](ECS& ecs, EcsCommandBuffer& buffer) mutable {
+                ecs.add_component<T>(buffer.resolve(e), std::move(held_value(holder)));
+            });
+        }
+
+        /**
+         * Record the addition of a component to an entity, to be constructed in-place when the buffer is applied.
+         * The arguments are moved into the buffer (so they may be move-only), and moved into the constructor.
+         * @param e The entity (or placeholder) to add the component to.
+         * @param args The arguments with which to construct the component.
+         */
+        template <typename T, typename ...Args>
+        void emplace_component(Entity e, Args... args) {
+            auto holder = make_holder(std::make_tuple(std::move(args)...));
+            commands.emplace_back([e, holder = std::move(holder)](ECS& ecs, EcsCommandBuffer& buffer) mutable {
+                std::apply([&](Args&... unpacked_args) {
+                    ecs.emplace_component<T>(buffer.resolve(e), std::move(unpacked_args)...);
+                }, held_value(holder));
+            });
+        }
+
+        /**
+         * Record the removal of a component from an entity.
+         * @param e The entity (or placeholder) to remove the component from.
+         */
+        template <typename T>
+        void remove_component(Entity e) {
+            commands.emplace_back([e](ECS& ecs, EcsCommandBuffer& buffer) {
+                ecs.remove_component<T>(buffer.resolve(e));
+            });
+        }
+
+        /**
+         * Reserve memory for a number of commands, so recording them doesn't reallocate.
+         */
+        void reserve(std::size_t n_commands);
+
+        /**
+         * Apply every recorded command to an ECS, then clear the buffer. If a command throws, the buffer is still
+         * cleared (the commands before it stay applied).
+         * @param ecs The ECS to apply the commands to.
+         * @return The entities created, in the order new_entity() was called (i.e. indexed by placeholder number).
+         */
+        std::vector<Entity> apply(ECS& ecs);
+
+        /**
+         * Discard every recorded command.
+         */
+        void clear();
+
+        /**
+         * Get the number of recorded commands.
+         */
+        [[nodiscard]]
+        std::size_t size() const { return commands.size(); }
+
+        /**
+         * Test if an entity is a placeholder created by an EcsCommandBuffer.
+         */
+        static bool is_placeholder(Entity e);
+
+    private:
+        using Command = std::function<void(ECS&, EcsCommandBuffer&)>;
+
+        std::vector<Command> commands;
+        /// The number of each placeholder (the order it was created in this buffer), by it's index.
+        std::unordered_map<EcsIndexT, std::size_t> placeholder_numbers;
+        /// Entities created for each placeholder so far (only during apply()).
+        std::vector<Entity> created_entities;
+        /// The index of the next placeholder created by any buffer.
+        static std::atomic<EcsIndexT> next_placeholder_index;
+
+        /// Holds a value which can't be copied for a command (see make_holder()).
+        template <typename V>
+        struct SharedHolder {
+            std::shared_ptr<V> value;
+        };
+
+        /**
+         * Internal function to hold a value for a command. std::function needs copyable functions, so values which
+         * can't be copied are held through a shared_ptr (the command only runs once, so it's never actually shared).
+         */
+        template <typename V>
+        static auto make_holder(V value) {
+            if constexpr (std::is_copy_constructible_v<V>) {
+                return value;
+            } else {
+                return SharedHolder<V>{std::make_shared<V>(std::move(value))};
+            }
+        }
+
+        /**
+         * Internal function to get the value held by make_holder().
+         */
+        template <typename V>
+        static V& held_value(V& holder) {
+            return holder;
+        }
+        template <typename V>
+        static V& held_value(SharedHolder<V>& holder) {
+            return *holder.value;
+        }
+
+        /**
+         * Internal function to replace a placeholder with the entity created for it.
+         */
+        Entity resolve(Entity e) const;
+    };
+
+    /** EcsCommandBufferSet
+     * A set of command buffers, one per thread, so that worker threads can record commands without locking.
+     * local() returns the calling thread's buffer (creating it on first use), and apply() applies every buffer in the
+     * set, one after another, in the order they were created.
+     */
+    struct EcsCommandBufferSet {
+        EcsCommandBufferSet();
+        EcsCommandBufferSet(const EcsCommandBufferSet&) = delete;
+        EcsCommandBufferSet& operator=(const EcsCommandBufferSet&) = delete;
+
+        /**
+         * Get the calling thread's buffer. Repeated calls on a thread don't take a lock, unless the thread has used
+         * another set in between.
+         */
+        EcsCommandBuffer& local();
+
+        /**
+         * Apply every buffer to an ECS, then clear them (all of them, even if a command throws). Must not be called
+         * while other threads are recording.
+         * @param ecs The ECS to apply the commands to.
+         */
+        void apply(ECS& ecs);
+
+        /**
+         * Get the total number of recorded commands across all buffers. Must not be called while other threads are
+         * recording.
+         */
+        [[nodiscard]]
+        std::size_t size() const;
+
+    private:
+        /// Unique across all sets, so thread-local lookups never confuse a destroyed set with a new one.
+        std::uint64_t set_id;
+        static std::atomic_uint64_t set_id_counter;
+        std::mutex mutex;
+        /// A deque, so references handed out by local() stay valid as buffers are added.
+        std::deque<EcsCommandBuffer> buffers;
+        /// Each thread's buffer, guarded by mutex.
+        std::unordered_map<std::thread::id, EcsCommandBuffer*> thread_buffers;
+    };
+}
@@ -7,11 +7,16 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <memory>
+#include <string>
+#include <tuple>
 #include <unordered_map>
 
 #include "single_component_registry.hpp"
+#include "static_components.hpp"
+#include "cyan/src/logging/error.hpp"
 #include "cyan/src/logging/logger.hpp"
 
 namespace cyan::ecs_impl {
@@ -19,13 +24,40 @@ namespace cyan::ecs_impl {
         int id;
     };
 
+    /// Generated component types (see StaticComponentTypes) take the IDs at the top of the range of component type
+    /// IDs, [FIRST_STATIC_COMPONENT_TYPE_ID, ECS_MAX_COMPONENT_TYPES), in X_COMPONENTS order. Other types are given
+    /// IDs from 0 upwards at runtime.
+    constexpr int FIRST_STATIC_COMPONENT_TYPE_ID = int(ECS_MAX_COMPONENT_TYPES - N_STATIC_COMPONENT_TYPES);
+    static_assert(N_STATIC_COMPONENT_TYPES <= ECS_MAX_COMPONENT_TYPES,
+                  "There are more generated component types than ECS_MAX_COMPONENT_TYPES");
+
     /**
      * ComponentMap provides an interface from the type of a component to it's corresponding array.
-     * There's a lot of room for optimization here, but ideally this is how the interface should work.
-     * It may require a shift from runtime (with void* pointers and all that mess) to compile-time, but I've tried that
-     * before and it gets messy.
+     * The registries of generated component types (those in X_COMPONENTS, see StaticComponentTypes) are members of a
+     * std::tuple, and their IDs are compile-time constants, so looking them up is a direct member access. Any other
+     * type is looked up at runtime: it's registry is found by it's ID (assigned on first use) in a vector of
+     * registries, which is created on first access. Every registry can also be operated on without knowing it's type,
+     * as an IComponentRegistry (see get_registry() and for_each_registry()).
      */
     struct ComponentMap {
+        ComponentMap() {
+            // Generated component types are named after the type by default.
+            std::size_t position = 0;
+            #define X(ComponentT) \
+            static_component_names[position] = #ComponentT; \
+            position += 1;
+            X_COMPONENTS
+            #undef X
+            for_each_static_registry([&](std::size_t index, auto& registry) {
+                registry.set_component_type_name(static_component_names[index]);
+            });
+        }
+
+        // Registries are owned by the map, and registries of generated types refer to the map's own members, so the map
+        // can't be copied.
+        ComponentMap(const ComponentMap&) = delete;
+        ComponentMap& operator=(const ComponentMap&) = delete;
+
         /**
          * Get the integer ID associated with a component type.
          * @tparam ComponentT The type to get an integer ID for
@@ -34,7 +66,11 @@ namespace cyan::ecs_impl {
         template <typename ComponentT>
         ComponentTypeId get_component_type_id()
         {
-            return ComponentTypeId{get_component_type_id_internal<ComponentT>()};
+            if constexpr (is_static_component_type<ComponentT>) {
+                return ComponentTypeId{FIRST_STATIC_COMPONENT_TYPE_ID + int(static_component_index<ComponentT>)};
+            } else {
+                return ComponentTypeId{get_component_type_id_internal<ComponentT>()};
+            }
         }
 
 
@@ -45,7 +81,14 @@ namespace cyan::ecs_impl {
          */
         template <typename ComponentT>
         void register_component_type(const std::string& component_name) {
-            init_component_registry<ComponentT>(component_name);
+            if constexpr (is_static_component_type<ComponentT>) {
+                // Generated registries always exist, so there's nothing to warn about - just rename the type.
+                if (component_name == "") return;
+                static_component_names[static_component_index<ComponentT>] = component_name;
+                get_component_registry<ComponentT>()->set_component_type_name(component_name);
+            } else {
+                init_component_registry<ComponentT>(component_name);
+            }
         }
 
         /**
@@ -56,14 +99,165 @@ namespace cyan::ecs_impl {
         template <typename ComponentT>
         SingleComponentRegistry<ComponentT>* get_component_registry()
         {
-            auto component_type_id = get_component_type_id_internal<ComponentT>();
+            CYAN_ECS_COUNT(n_registry_lookups);
+            if constexpr (is_static_component_type<ComponentT>) {
+                return &std::get<static_component_index<ComponentT>>(static_registries);
+            } else {
+                auto component_type_id = get_component_type_id_internal<ComponentT>();
+                if (component_type_id < 0) throw cyan::Error("Invalid component type id {}", component_type_id);
+                auto id = std::size_t(component_type_id);
+
+                // If we can't find a registry with the given ID, initialize it and return the newly initialized
+                // registry. Type IDs are shared between all ComponentMaps, so the slot may also exist but be empty if
+                // this map has only seen types with higher IDs so far.
+                if (id >= component_registries.size() || !component_registries[id]) {
+                    return init_component_registry<ComponentT>();
+                }
+
+                return static_cast<SingleComponentRegistry<ComponentT>*>(component_registries[id].get());
+            }
+        }
+
+        /**
+         * Get the registry for a component type, without knowing the type statically.
+         * @param type_id The component type.
+         * @return The registry, or nullptr if no registry for the type exists in this map.
+         */
+        IComponentRegistry* get_registry(ComponentTypeId type_id) {
+            CYAN_ECS_COUNT(n_registry_lookups);
+            if (type_id.id >= FIRST_STATIC_COMPONENT_TYPE_ID) {
+                IComponentRegistry* found = nullptr;
+                for_each_static_registry([&](std::size_t index, IComponentRegistry& registry) {
+                    if (int(index) == type_id.id - FIRST_STATIC_COMPONENT_TYPE_ID) found = &registry;
+                });
+                return found;
+            }
+            if (type_id.id < 0) return nullptr;
+            auto id = std::size_t(type_id.id);
+            if (id >= component_registries.size()) return nullptr;
+            return component_registries[id].get();
+        }
+
+        /**
+         * Find a component type by name (see register_component_type()), among the generated types and the types with
+         * a registry in this map.
+         * @param name The name of the component type.
+         * @return The type's ID, or an ID of -1 if no type has that name (get_registry() returns nullptr for it).
+         */
+        ComponentTypeId find_component_type(const std::string& name) const {
+            for (std::size_t index = 0; index < N_STATIC_COMPONENT_TYPES; index += 1) {
+                if (static_component_names[index] == name) {
+                    return ComponentTypeId{FIRST_STATIC_COMPONENT_TYPE_ID + int(index)};
+                }
+            }
+            for (std::size_t id = 0; id < component_registries.size(); id += 1) {
+                if (component_registries[id] && component_names[id] == name) return ComponentTypeId{int(id)};
+            }
+            return ComponentTypeId{-1};
+        }
 
-            // If we can't find a registry with the given ID, initialize it and return the newly initialized registry.
-            if (component_registries.size() <= component_type_id) {
-                return init_component_registry<ComponentT>();
+        /**
+         * Call a function on every registry in this map (generated component types first).
+         * @param fn A function taking (ComponentTypeId, IComponentRegistry&).
+         */
+        template <typename Fn>
+        void for_each_registry(Fn&& fn) {
+            for_each_static_registry([&](std::size_t index, IComponentRegistry& registry) {
+                fn(ComponentTypeId{FIRST_STATIC_COMPONENT_TYPE_ID + int(index)}, registry);
+            });
+            for (std::size_t id = 0; id < component_registries.size(); id += 1) {
+                if (component_registries[id]) fn(ComponentTypeId{int(id)}, *component_registries[id]);
             }
+        }
 
-            return (SingleComponentRegistry<ComponentT>*)(component_registries[component_type_id]);
+        /**
+         * Add the statistics of every registry in this map to stats.components, keyed by component type name (see
+         * ECS::stats()), along with the map's own counters.
+         */
+        void collect_stats(EcsStats& stats) {
+#if CYAN_ECS_STATS
+            stats.n_registry_lookups = n_registry_lookups.get();
+            stats.n_registries_created = n_registries_created.get();
+#endif
+            for_each_registry([&](ComponentTypeId type_id, IComponentRegistry& registry) {
+                auto name = registry.get_component_type_name();
+                if (name.empty()) name = "#" + std::to_string(type_id.id);
+                stats.components[name] = registry.get_stats();
+            });
+        }
+
+        /**
+         * Remove an entity's component from the registry for a component type, without knowing the type statically.
+         * Does nothing if no registry for the type exists.
+         * @param type_id The component type.
+         * @param e The entity whose component should be removed.
+         */
+        void remove_component(ComponentTypeId type_id, Entity e) {
+            if (auto registry = get_registry(type_id)) registry->remove(e);
+        }
+
+        /**
+         * Remove orphaned components from part of the registry for a component type, without knowing the type
+         * statically (see SingleComponentRegistry::remove_orphans()).
+         * If no registry for the type exists, nothing is scanned and the sweep is reported as having reached the end.
+         * @param type_id The component type.
+         * @param cursor The storage position to start at, advanced past the scanned positions.
+         * @param max_slots The maximum number of storage positions to scan.
+         * @param entities The entities to check components against.
+         */
+        OrphanSweep remove_orphans(ComponentTypeId type_id, std::size_t& cursor, std::size_t max_slots,
+                                   EntityRegistry& entities) {
+            auto registry = get_registry(type_id);
+            if (!registry) {
+                cursor = 0;
+                return OrphanSweep{0, 0, 0, true};
+            }
+            return registry->remove_orphans(cursor, max_slots, entities);
+        }
+
+        /**
+         * Set the tick that components added or changed from now on are stamped with, in every registry (including
+         * registries created later).
+         */
+        void set_tick(EcsTickT new_tick) {
+            tick = new_tick;
+            for_each_registry([&](ComponentTypeId, IComponentRegistry& registry) {
+                registry.set_tick(tick);
+            });
+        }
+
+        /**
+         * Get the number of registry positions in this map. Each position in [0, registry_position_count()) refers to
+         * a component type (see registry_position_type_id()), which may or may not have a registry in this map yet.
+         */
+        [[nodiscard]]
+        std::size_t registry_position_count() const {
+            return N_STATIC_COMPONENT_TYPES + component_registries.size();
+        }
+
+        /**
+         * Get the component type at a registry position (see registry_position_count()). Generated component types
+         * come first.
+         */
+        [[nodiscard]]
+        ComponentTypeId registry_position_type_id(std::size_t position) const {
+            if (position < N_STATIC_COMPONENT_TYPES) {
+                return ComponentTypeId{FIRST_STATIC_COMPONENT_TYPE_ID + int(position)};
+            }
+            return ComponentTypeId{int(position - N_STATIC_COMPONENT_TYPES)};
+        }
+
+        /**
+         * Get the registry position of a component type (see registry_position_count()). Type IDs are shared by every
+         * ComponentMap, so this doesn't need a map.
+         */
+        template <typename ComponentT>
+        static std::size_t get_registry_position() {
+            if constexpr (is_static_component_type<ComponentT>) {
+                return static_component_index<ComponentT>;
+            } else {
+                return N_STATIC_COMPONENT_TYPES + std::size_t(get_component_type_id_internal<ComponentT>());
+            }
         }
 
         /**
@@ -73,29 +267,33 @@ namespace cyan::ecs_impl {
          */
         template <typename ComponentT>
         const std::string& get_component_name() {
-            // TODO: Potential for a segfault/undefined behavior here if we try get the name of a type that we haven't
-            //       registered.
-            return component_names[get_component_type_id_internal<ComponentT>()];
+            if constexpr (is_static_component_type<ComponentT>) {
+                return static_component_names[static_component_index<ComponentT>];
+            } else {
+                // TODO: Potential for a segfault/undefined behavior here if we try get the name of a type that we
+                //       haven't registered.
+                return component_names[get_component_type_id_internal<ComponentT>()];
+            }
         }
 
     private:
-        // TODO: There's a number of potential problems with this implementation:
-        //     1.  All SingleComponentRegistry<T> objects should have the same size regardless of T - we can probably
-        //         having a pointer here and just store the map in a chunk of bytes and cast the pointer over,
-        //         but for now this will do until it becomes an obvious issue.
-        //     2.  Probably the worst one: each component's registry is obfuscated by a void pointer to the allocated
-        //         registry. This lets us do our tricky mapping types at runtime (sort of), but the downside is we
-        //         can't delete this without somehow mapping back from the IDs associated with the type to the type
-        //         itself, which isn't as easy (but might be possible). I'm unsure on the best way to solve this - it
-        //         isn't an immediate issue, because the ECS and thus the component map will likely last the lifetime
-        //         of the game, so we won't leak memory because of this, but it's not good.
-        //         One idea: make SingleComponentArray<T> a child class of an abstract parent interface of some
-        //         AbstractSingleComponentArray, which we can cast each void* back to and hopefully ensure cleanup is
-        //         done in ComponentMap's destructor by an explicit polymorphic cleanup() function. This seems to
-        //         interfere with the idea presented to Problem 1, though (or does it? I imagine there's a solution
-        //         somewhere).
-        std::vector<void*> component_registries;
+        // Registries for the generated component types, in StaticComponentTypes order.
+        typename MapTupleTypes<SingleComponentRegistry, StaticComponentTypes>::type static_registries;
+        std::array<std::string, N_STATIC_COMPONENT_TYPES> static_component_names;
+
+        // TODO: All SingleComponentRegistry<T> objects should have the same size regardless of T - we can probably
+        //       avoid having a pointer here and just store the map in a chunk of bytes and cast the pointer over,
+        //       but for now this will do until it becomes an obvious issue.
+        // Registries of non-generated types, indexed by type ID (null for types without a registry in this map). The
+        // registries are owned here, and so are released with the map.
+        std::vector<std::unique_ptr<IComponentRegistry>> component_registries;
         std::vector<std::string> component_names;
+        // The tick given to registries, which new registries start at.
+        EcsTickT tick = 0;
+#if CYAN_ECS_STATS
+        ecs_impl::StatCounter n_registry_lookups;
+        ecs_impl::StatCounter n_registries_created;
+#endif
         static std::atomic_int component_type_id_counter;
 
         /**
@@ -109,9 +307,30 @@ namespace cyan::ecs_impl {
         inline static int get_component_type_id_internal()
         {
             static const int id = component_type_id_counter++;
+            if (id >= FIRST_STATIC_COMPONENT_TYPE_ID) {
+                throw cyan::Error("Too many component types: type id {} is beyond the {} IDs available to "
+                                  "non-generated types (ECS_MAX_COMPONENT_TYPES is {}, and {} are generated)",
+                                  id, FIRST_STATIC_COMPONENT_TYPE_ID, ECS_MAX_COMPONENT_TYPES,
+                                  N_STATIC_COMPONENT_TYPES);
+            }
             return id;
         }
 
+        /**
+         * Internal function to call a function on each generated component registry.
+         * @param fn A function taking (std::size_t index, SingleComponentRegistry<T>& registry), where index is the
+         *           position of T within StaticComponentTypes.
+         */
+        template <typename Fn>
+        void for_each_static_registry(Fn&& fn) {
+            for_each_static_registry(fn, std::make_index_sequence<N_STATIC_COMPONENT_TYPES>{});
+        }
+
+        template <typename Fn, std::size_t ...Is>
+        void for_each_static_registry(Fn& fn, std::index_sequence<Is...>) {
+            (fn(Is, std::get<Is>(static_registries)), ...);
+        }
+
         /**
          * Internal function to initialize a component registry for a given type.
          * @tparam ComponentT The type of component to initialize a registry for.
@@ -121,7 +340,7 @@ namespace cyan::ecs_impl {
         SingleComponentRegistry<ComponentT>* init_component_registry(const std::string& name = "") {
             auto component_type_id = get_component_type_id_internal<ComponentT>();
 
-            if (component_registries.size() <= component_type_id) {
+            if (component_registries.size() <= component_type_id || !component_registries[component_type_id]) {
                 // If the component registry doesn't already exist, create it, assign the provided name and return it.
                 while (component_registries.size() <= component_type_id) {
                     // Make room in the vectors until we can store a value at component_type_id.
@@ -135,9 +354,11 @@ namespace cyan::ecs_impl {
                 }
 
                 // Assign the registry at the location of the id to a valid registry.
+                CYAN_ECS_COUNT(n_registries_created);
                 auto component_reg_ptr = new SingleComponentRegistry<ComponentT>{};
                 component_reg_ptr->set_component_type_name(name);
-                component_registries[component_type_id] = (void*)component_reg_ptr;
+                component_reg_ptr->set_tick(tick);
+                component_registries[component_type_id].reset(component_reg_ptr);
                 component_names[component_type_id] = name;
                 return component_reg_ptr;
             } else {
@@ -158,11 +379,11 @@ namespace cyan::ecs_impl {
                 // existing name is a useful one).
                 if (name != "") {
                     component_names[component_type_id] = name;
-                    ((SingleComponentRegistry<ComponentT>*)component_registries[component_type_id])
+                    static_cast<SingleComponentRegistry<ComponentT>*>(component_registries[component_type_id].get())
                         ->set_component_type_name(name);
                 }
 
-                return (SingleComponentRegistry<ComponentT>*)component_registries[component_type_id];
+                return static_cast<SingleComponentRegistry<ComponentT>*>(component_registries[component_type_id].get());
             }
         }
     };
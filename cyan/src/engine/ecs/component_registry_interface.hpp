@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "entity.hpp"
+#include "ecs_stats.hpp"
+#include "snapshot.hpp"
+
+namespace cyan {
+    /// The kinds of component lifecycle event that can be observed (see ECS::on_add()).
+    enum class ComponentEvent {
+        Added,
+        Removed,
+        Changed,
+    };
+
+    /// An observer of a component lifecycle event, called with each batch of entities the event happened to.
+    using ComponentObserverFn = std::function<void(const std::vector<Entity>&)>;
+
+    /**
+     * Identifies an observer added with ECS::on_add(), on_remove() or on_change(), so it can be removed again with
+     * ECS::unobserve(). A default-constructed ObserverId refers to no observer.
+     */
+    struct ObserverId {
+        /// The ID of the observed component type (see ECS::get_component_type_id()).
+        int component_type_id = -1;
+        /// The observer's ID within it's registry, or 0 for no observer.
+        std::uint64_t id = 0;
+
+        explicit operator bool() const { return id != 0; }
+    };
+
+    /**
+     * The result of sweeping part of a component registry for orphaned components (see
+     * IComponentRegistry::remove_orphans()).
+     */
+    struct OrphanSweep {
+        /// The number of storage positions scanned.
+        std::size_t n_slots_scanned = 0;
+        /// The number of orphaned components removed.
+        std::size_t n_removed = 0;
+        /// The size of the removed components (not including any bookkeeping).
+        std::size_t bytes_removed = 0;
+        /// Whether the sweep reached the end of the registry's storage.
+        bool reached_end = false;
+    };
+
+    /**
+     * An interface for component registries, allowing them to be operated on without knowing their component type
+     * (see SingleComponentRegistry<T>, the only implementation).
+     */
+    struct IComponentRegistry {
+        virtual ~IComponentRegistry() = default;
+
+        /**
+         * Remove an entity's component. Does nothing if the entity has no component in this registry.
+         * @param e The entity whose component should be removed.
+         */
+        virtual void remove(Entity e) = 0;
+
+        /**
+         * Remove every component. IDs of the removed components remain invalid, and the memory is kept for reuse (see
+         * shrink_to_fit()).
+         */
+        virtual void clear() = 0;
+
+        /**
+         * Reserve memory for a total of n components, so adding up to that many doesn't allocate.
+         */
+        virtual void reserve(std::size_t n) = 0;
+
+        /**
+         * Release as much unused memory as possible. Enough bookkeeping is kept to ensure the IDs of removed components
+         * stay invalid.
+         */
+        virtual void shrink_to_fit() = 0;
+
+        /**
+         * Get the number of components in the registry.
+         */
+        [[nodiscard]]
+        virtual std::size_t size() const = 0;
+
+        /**
+         * Get the registry's footprint, and it's operation counters if they're enabled (see ecs_stats.hpp).
+         */
+        [[nodiscard]]
+        virtual ComponentRegistryStats get_stats() const = 0;
+
+        /**
+         * Get the (approximate) number of bytes of memory allocated by the registry, including unused capacity.
+         */
+        [[nodiscard]]
+        virtual std::size_t memory_bytes() const = 0;
+
+        /**
+         * Remove orphaned components (those whose entity no longer exists) from part of the underlying storage.
+         * Sweeping is incremental: each call scans up to max_slots storage positions starting at cursor, and advances
+         * cursor past them, so repeated calls walk the whole registry and then start again from the front.
+         * @param cursor The storage position to start at. Reset to 0 once the end of the storage is reached.
+         * @param max_slots The maximum number of storage positions to scan.
+         * @param entities The entities to check components against.
+         * @return What was scanned and removed by this call.
+         */
+        virtual OrphanSweep remove_orphans(std::size_t& cursor, std::size_t max_slots, EntityRegistry& entities) = 0;
+
+        /**
+         * Set the tick that components added or changed from now on are stamped with (see ECS::advance_tick()).
+         */
+        virtual void set_tick(EcsTickT tick) = 0;
+
+        /**
+         * Add an observer for a kind of component event. Events are only recorded for kinds with an observer.
+         * @param event The kind of event to observe.
+         * @param fn The observer, called with each batch of events by flush_events().
+         * @return The observer's ID within the registry (never 0), for unobserve().
+         */
+        virtual std::uint64_t observe(ComponentEvent event, ComponentObserverFn fn) = 0;
+
+        /**
+         * Remove an observer added with observe(). Once a kind of event has no observers, it's no longer recorded.
+         * @param observer_id The ID observe() returned.
+         * @return Whether the observer was found (and removed).
+         */
+        virtual bool unobserve(std::uint64_t observer_id) = 0;
+
+        /**
+         * Dispatch the events recorded since the last flush to their observers (see SingleComponentRegistry).
+         */
+        virtual void flush_events() = 0;
+
+        /**
+         * Get the name of the component type (see ComponentMap::register_component_type()).
+         */
+        virtual std::string get_component_type_name() = 0;
+
+        /**
+         * Write the components to a snapshot, as a section named after the component type (see ECS::save_snapshot()).
+         * Nothing is written for an empty registry, or (with a warning) for a component type without a name or which
+         * can't be serialized (see is_snapshot_serializable).
+         */
+        virtual void save_snapshot(SnapshotWriter& writer) = 0;
+
+        /**
+         * Replace the components with those in a section of a snapshot (see ECS::load_snapshot()). Observers see the
+         * components being removed and then added. Component IDs from before the load must not be used afterwards.
+         * @throws cyan::Error if the section doesn't match the component type.
+         */
+        virtual void load_snapshot(const SnapshotSection& section) = 0;
+
+        /**
+         * Get an immutable copy of the registry, which can be read from other threads while this one changes (see
+         * ECS::publish()). The copy is only remade when the registry has changed since the last one.
+         * @return The copy, or nullptr if the component type can't be copied.
+         */
+        virtual std::shared_ptr<const IComponentRegistry> publish() = 0;
+    };
+}
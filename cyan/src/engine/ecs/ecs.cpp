@@ -1,19 +1,352 @@
 #include "ecs.hpp"
+#include "snapshot.hpp"
+
+
+cyan::ECS::ECS(cyan::EcsStorage storage)
+{
+    if (storage == EcsStorage::Archetypes) {
+        archetypes = std::make_unique<ecs_impl::ArchetypeStorage>();
+    }
+}
+
+
+cyan::EcsStorage cyan::ECS::get_storage() const
+{
+    return archetypes ? EcsStorage::Archetypes : EcsStorage::ComponentRegistries;
+}
 
 
 cyan::Entity cyan::ECS::new_entity()
 {
+    entities_unpublished = true;
     return Entity{entities.add({}).id};
 }
 
 
 void cyan::ECS::delete_entity(cyan::Entity e)
 {
+    auto record = entities.get(e.id);
+    if (!record) return;
+    entities_unpublished = true;
+
+    // Remove the entity's components from exactly the registries which hold one, as given by it's signature.
+    if (archetypes) {
+        archetypes->remove_entity(e);
+    } else {
+        auto& signature = record->signature;
+        auto n_remaining = signature.count();
+        for (std::size_t type_id = 0; n_remaining > 0; type_id += 1) {
+            if (!signature.test(type_id)) continue;
+            component_map.remove_component(ecs_impl::ComponentTypeId{int(type_id)}, e);
+            n_remaining -= 1;
+        }
+    }
     entities.remove(e.id);
 }
 
 
+void cyan::ECS::new_entities(std::size_t n, std::vector<Entity>& out)
+{
+    entities_unpublished = true;
+    entities.reserve(entities.size() + n);
+    out.reserve(out.size() + n);
+    for (std::size_t i = 0; i < n; i += 1) {
+        out.push_back(Entity{entities.add({}).id});
+    }
+}
+
+
+void cyan::ECS::delete_entities(const std::vector<Entity>& es)
+{
+    for (auto e : es) {
+        delete_entity(e);
+    }
+}
+
+
+void cyan::ECS::clear()
+{
+    if (archetypes) {
+        archetypes = std::make_unique<ecs_impl::ArchetypeStorage>();
+    } else {
+        component_map.for_each_registry([](ecs_impl::ComponentTypeId, IComponentRegistry& registry) {
+            registry.clear();
+        });
+    }
+    entities.clear();
+    entities_unpublished = true;
+}
+
+
+void cyan::ECS::shrink_to_fit()
+{
+    component_map.for_each_registry([](ecs_impl::ComponentTypeId, IComponentRegistry& registry) {
+        registry.shrink_to_fit();
+    });
+    entities.shrink_to_fit();
+}
+
+
+std::size_t cyan::ECS::memory_bytes()
+{
+    std::size_t total = entities.memory_bytes();
+    component_map.for_each_registry([&](ecs_impl::ComponentTypeId, IComponentRegistry& registry) {
+        total += registry.memory_bytes();
+    });
+    if (archetypes) total += archetypes->memory_bytes();
+    return total;
+}
+
+
+cyan::EcsStats cyan::ECS::stats()
+{
+    EcsStats stats;
+    stats.n_entities = entities.size();
+    stats.entities = entities.get_stats();
+    component_map.collect_stats(stats);
+    return stats;
+}
+
+
 bool cyan::ECS::exists(cyan::Entity e)
 {
     return bool(entities.get(e.id));
 }
+
+
+cyan::ComponentSignature cyan::ECS::get_component_signature(cyan::Entity e)
+{
+    auto record = entities.get(e.id);
+    return record ? record->signature : ComponentSignature{};
+}
+
+
+bool cyan::ECS::unobserve(cyan::ObserverId observer)
+{
+    if (!observer) return false;
+    auto registry = component_map.get_registry(ecs_impl::ComponentTypeId{observer.component_type_id});
+    return registry && registry->unobserve(observer.id);
+}
+
+
+void cyan::ECS::flush_events()
+{
+    component_map.for_each_registry([](ecs_impl::ComponentTypeId, IComponentRegistry& registry) {
+        registry.flush_events();
+    });
+}
+
+
+cyan::EcsTickT cyan::ECS::current_tick() const
+{
+    return tick;
+}
+
+
+cyan::EcsTickT cyan::ECS::advance_tick()
+{
+    tick += 1;
+    component_map.set_tick(tick);
+    return tick;
+}
+
+
+cyan::ThreadPool& cyan::ECS::get_worker_pool()
+{
+    std::lock_guard lock(worker_pool_mutex);
+    if (!worker_pool) {
+        worker_pool = std::make_unique<ThreadPool>(worker_threads);
+    }
+    return *worker_pool;
+}
+
+
+void cyan::ECS::set_worker_threads(std::size_t n_threads)
+{
+    std::lock_guard lock(worker_pool_mutex);
+    if (n_threads == worker_threads) return;
+    worker_threads = n_threads;
+    // The pool is recreated with the new size when it's next needed.
+    worker_pool.reset();
+}
+
+
+void cyan::ECS::save_snapshot(const std::string& path)
+{
+    if (archetypes) throw cyan::Error("Snapshots can't be saved with archetype storage");
+    SnapshotWriter writer(path);
+
+    // The entity registry's slots: the ID each slot holds, whether it's live, and the free list.
+    auto n_slots = entities.slot_count();
+    std::vector<EcsIdT> ids(n_slots);
+    std::vector<std::uint8_t> live(n_slots);
+    for (std::size_t index = 0; index < n_slots; index += 1) {
+        ids[index] = entities.slot_id(index);
+        live[index] = entities.slot_is_live(index);
+    }
+    auto free_slots = entities.free_slots();
+    writer.begin_section(SnapshotSectionKind::Entities, "entities", sizeof(EcsIdT), n_slots);
+    writer.begin_block();
+    writer.write_bytes(ids.data(), ids.size() * sizeof(EcsIdT));
+    writer.begin_block();
+    writer.write_bytes(live.data(), live.size());
+    writer.begin_block();
+    writer.write_bytes(free_slots.data(), free_slots.size() * sizeof(EcsIndexT));
+
+    // Orphaned components (see collect_garbage()) are removed rather than saved, as their entities aren't saved.
+    component_map.for_each_registry([&](ecs_impl::ComponentTypeId, IComponentRegistry& registry) {
+        std::size_t cursor = 0;
+        registry.remove_orphans(cursor, std::numeric_limits<std::size_t>::max(), entities);
+        registry.save_snapshot(writer);
+    });
+    writer.finish(tick);
+}
+
+
+void cyan::ECS::load_snapshot(const std::string& path)
+{
+    if (archetypes) throw cyan::Error("Snapshots can't be loaded with archetype storage");
+    SnapshotReader reader(path);
+    auto& sections = reader.get_sections();
+    if (sections.empty() || sections[0].kind != SnapshotSectionKind::Entities) {
+        throw cyan::Error("Snapshot \"{}\" doesn't start with it's entities", path);
+    }
+
+    clear();
+    try {
+        auto& entity_section = sections[0];
+        auto n_slots = std::size_t(entity_section.n_elements);
+        auto& ids = entity_section.get_block(0, n_slots * sizeof(EcsIdT));
+        auto& live = entity_section.get_block(1, n_slots);
+        auto& free_slots = entity_section.get_block(2);
+        entities.restore_slots(reinterpret_cast<const EcsIdT*>(ids.data), live.data, n_slots,
+                               reinterpret_cast<const EcsIndexT*>(free_slots.data),
+                               free_slots.n_bytes / sizeof(EcsIndexT));
+        tick = reader.get_tick();
+        component_map.set_tick(tick);
+
+        for (std::size_t i = 1; i < sections.size(); i += 1) {
+            auto& section = sections[i];
+            if (section.kind != SnapshotSectionKind::Components) continue;
+            auto type_id = component_map.find_component_type(section.name);
+            auto registry = component_map.get_registry(type_id);
+            if (!registry) {
+                LOG(WARN, "Skipping {} components of type \"{}\" while loading snapshot \"{}\", as no component type "
+                          "has that name. Register the type with ECS::register_component_type() to load them.",
+                    section.n_elements, section.name, path);
+                continue;
+            }
+            // Every component has to belong to one of the snapshot's live entities.
+            auto& entity_block = section.get_block(0);
+            if (section.n_elements > entity_block.n_bytes / sizeof(EcsIdT)) {
+                throw cyan::Error("Snapshot \"{}\" is corrupt: the entities of the \"{}\" components are missing", path,
+                                  section.name);
+            }
+            auto entity_ids = reinterpret_cast<const EcsIdT*>(entity_block.data);
+            for (std::size_t component = 0; component < section.n_elements; component += 1) {
+                if (!entities.get(entity_ids[component])) {
+                    throw cyan::Error("Snapshot \"{}\" is corrupt: it has a \"{}\" component for entity {}, which "
+                                      "doesn't exist", path, section.name, entity_ids[component]);
+                }
+            }
+            registry->load_snapshot(section);
+
+            // Signatures aren't saved, as the IDs of non-generated types can differ between runs.
+            for (std::size_t component = 0; component < section.n_elements; component += 1) {
+                entities.get(entity_ids[component])->signature.set(type_id.id);
+            }
+        }
+    } catch (...) {
+        clear();
+        throw;
+    }
+}
+
+
+std::shared_ptr<const cyan::PublishedEcs> cyan::ECS::publish()
+{
+    if (archetypes) throw cyan::Error("The ECS can't be published with archetype storage");
+    auto published = std::make_shared<PublishedEcs>();
+    published_version += 1;
+    published->version = published_version;
+    published->tick = tick;
+
+    if (entities_unpublished || !published_entity_ids) {
+        auto n_slots = entities.slot_count();
+        auto entity_ids = std::make_shared<std::vector<EcsIdT>>(n_slots, ECS_NULL_INDEX);
+        for (std::size_t index = 0; index < n_slots; index += 1) {
+            if (entities.slot_is_live(index)) (*entity_ids)[index] = entities.slot_id(index);
+        }
+        published_entity_ids = std::move(entity_ids);
+        entities_unpublished = false;
+    }
+    published->entity_ids = published_entity_ids;
+
+    // Unchanged registries give back the same copy as last time.
+    published->registries.resize(component_map.registry_position_count());
+    for (std::size_t position = 0; position < published->registries.size(); position += 1) {
+        if (auto registry = component_map.get_registry(component_map.registry_position_type_id(position))) {
+            published->registries[position] = registry->publish();
+        }
+    }
+
+    std::shared_ptr<const PublishedEcs> result = std::move(published);
+    std::atomic_store(&latest_published, result);
+    return result;
+}
+
+
+std::shared_ptr<const cyan::PublishedEcs> cyan::ECS::get_published() const
+{
+    return std::atomic_load(&latest_published);
+}
+
+
+cyan::EcsGcReport cyan::ECS::collect_garbage(std::chrono::nanoseconds budget, std::size_t max_batches)
+{
+    EcsGcReport report;
+    if (archetypes) return report;
+
+    auto start = std::chrono::steady_clock::now();
+    auto n_positions = component_map.registry_position_count();
+    gc_cursors.resize(n_positions, 0);
+
+    // Sweep the registries in turns, one batch at a time, until the budget runs out or every registry has reached it's
+    // end during this call. The sweep carries on from where the last call stopped.
+    std::vector<bool> completed(n_positions, false);
+    std::size_t n_batches = 0;
+    while (report.n_registries_completed < n_positions && n_batches < max_batches) {
+        auto position = gc_next_position % n_positions;
+        gc_next_position = position + 1;
+        if (completed[position]) continue;
+
+        auto sweep = component_map.remove_orphans(component_map.registry_position_type_id(position),
+                                                  gc_cursors[position], ECS_GC_SWEEP_BATCH_SIZE, entities);
+        report.n_slots_scanned += sweep.n_slots_scanned;
+        report.n_components_reclaimed += sweep.n_removed;
+        report.bytes_reclaimed += sweep.bytes_removed;
+        if (sweep.reached_end) {
+            completed[position] = true;
+            report.n_registries_completed += 1;
+        }
+        // Missing or empty registries don't count towards the batch limit.
+        if (sweep.n_slots_scanned > 0) n_batches += 1;
+
+        if (std::chrono::steady_clock::now() - start >= budget) break;
+    }
+
+    report.duration = std::chrono::steady_clock::now() - start;
+    return report;
+}
+
+
+void cyan::ECS::gc(std::random_device&, int iters)
+{
+    auto max_batches = iters > 0 ? std::size_t(iters) : std::numeric_limits<std::size_t>::max();
+    auto report = collect_garbage(DEFAULT_ECS_GC_BUDGET, max_batches);
+    if (report.n_components_reclaimed > 0) {
+        LOG(DEBUG, "ECS gc reclaimed {} orphaned components ({} bytes), scanning {} slots in {}us",
+            report.n_components_reclaimed, report.bytes_reclaimed, report.n_slots_scanned,
+            std::chrono::duration_cast<std::chrono::microseconds>(report.duration).count());
+    }
+}
@@ -5,31 +5,92 @@
 #include "object_registry.hpp"
 #include "single_component_registry.hpp"
 #include "component_map.hpp"
+#include "archetype_storage.hpp"
+#include "view.hpp"
+#include "published_ecs.hpp"
+#include "cyan/src/engine/garbage_collect_interface.hpp"
+#include "cyan/src/util/thread_pool.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace cyan {
-    struct EntityPlaceholder {};
-    using EntityRegistry = ecs_impl::ObjectRegistry<EntityPlaceholder>;
     template <typename T>
     using ComponentEntry = typename SingleComponentRegistry<T>::Entry;
     template <typename T>
     using ComponentId = typename SingleComponentRegistry<T>::Id;
 
+    /**
+     * The ways in which an ECS can store components.
+     */
+    enum class EcsStorage {
+        /// Each component type is stored in it's own SingleComponentRegistry. This is the default.
+        ComponentRegistries,
+        /// Components are stored grouped by the entity's set of component types (it's archetype) in fixed-size chunks
+        /// (see ArchetypeStorage). Iterating over several component types at once is a linear scan over memory, at the
+        /// cost of more expensive component addition and removal. Components do not have their own IDs in this mode.
+        Archetypes,
+    };
+
+    /// The default number of storage slots processed by each task of ECS::par_each().
+    constexpr std::size_t DEFAULT_PAR_EACH_GRAIN_SIZE = 4096;
+
+    /// The number of entities ECS::get_components() looks up between each of the prefetch steps for an entity (see
+    /// SingleComponentRegistry::prefetch_lookup()), which should be enough for a step's loads to arrive.
+    constexpr std::size_t GET_COMPONENTS_PREFETCH_DISTANCE = 4;
+
+    /// The default wall-clock time each ECS::gc() call may spend sweeping for orphaned components.
+    constexpr std::chrono::microseconds DEFAULT_ECS_GC_BUDGET{200};
+
+    /// The number of storage slots swept at a time by ECS::collect_garbage() before the clock is checked again.
+    constexpr std::size_t ECS_GC_SWEEP_BATCH_SIZE = 256;
+
+    /**
+     * What a call to ECS::collect_garbage() did.
+     */
+    struct EcsGcReport {
+        /// The number of component storage slots scanned.
+        std::size_t n_slots_scanned = 0;
+        /// The number of orphaned components removed.
+        std::size_t n_components_reclaimed = 0;
+        /// The size of the removed components (not including any bookkeeping).
+        std::size_t bytes_reclaimed = 0;
+        /// The number of component registries whose sweep reached the end of the registry (and started again from the
+        /// front) during the call. Component types without a registry in the ECS count as immediately completed.
+        std::size_t n_registries_completed = 0;
+        /// The time spent sweeping.
+        std::chrono::nanoseconds duration{0};
+    };
+
     /**
      * An object containing an entire Entity-Component System (ECS) (well, no systems here, but entities and
      * components).
      * Entities can be freely created and destroyed, components can be created (for any type!) and associated with
      * entities, and can be removed via the associated entity or via it's own component ID.
-     *
-     * TODO: The system currently has no protections for overflow of the generation or index values, which are bitwise
-     *       concatenated to form an ID. To overflow these, we would need to have either 2^32 reuses of an index within
-     *       an entity/component object array (generation overflow) or 2^32 concurrent entities or components (index
-     *       overflow) (note: that's 2^32 of the same type, not all together). This condition seems unlikely, but if for
-     *       for some reason we need to and can actually handle millions of concurrent entities, this could be a problem
-     *       to keep an eye on.
+     * IDs combine a generation and an index, with widths set at build time (see ecs_common.hpp). Slots which run out
+     * of generations are retired rather than reused (see ECS_MAX_GENERATION), and running out of indices throws.
      */
-    struct ECS {
+    struct ECS: public GarbageCollectedContainer {
+        /**
+         * Create an ECS.
+         * @param storage How components are stored (see EcsStorage). This can't be changed after construction.
+         */
+        explicit ECS(EcsStorage storage = EcsStorage::ComponentRegistries);
+
+        /**
+         * Get the component storage used by this ECS.
+         */
+        [[nodiscard]]
+        EcsStorage get_storage() const;
+
         /**
          * Create a new entity with no associated components.
          * @return An entry pointer to the new entity.
@@ -42,6 +103,91 @@ namespace cyan {
          */
         void delete_entity(Entity e);
 
+        /**
+         * Create a number of entities at once, with no associated components.
+         * Storage is reserved once for all of the new entities.
+         * @param n The number of entities to create.
+         * @param out The new entities are appended to this.
+         */
+        void new_entities(std::size_t n, std::vector<Entity>& out);
+
+        /**
+         * Delete a number of entities at once.
+         * @param es The entities to delete.
+         */
+        void delete_entities(const std::vector<Entity>& es);
+
+        /**
+         * Delete every entity and component. Entities and components deleted this way stay invalid, as with
+         * delete_entity(). Memory is kept for reuse (see shrink_to_fit()).
+         */
+        void clear();
+
+        /**
+         * Release as much unused memory as possible from entity and component storage, e.g. after a level is unloaded.
+         */
+        void shrink_to_fit();
+
+        /**
+         * Save every entity and component to a binary snapshot file (see snapshot.hpp), which load_snapshot() restores
+         * far faster than re-creating the entities one at a time. The entity registry is saved slot by slot (including
+         * the generations of deleted entities), so entity IDs are the same after loading. Components are saved for
+         * every named component type (generated types, and those named with register_component_type()) which is
+         * trivially copyable or has a serializer (see is_snapshot_serializable). Observers aren't part of a snapshot.
+         * Orphaned components (see collect_garbage()) are removed first, rather than saved.
+         * @param path The file to write. An existing file is only replaced once the snapshot is complete.
+         * @throws cyan::Error if the file can't be written, or with archetype storage (which can't be saved).
+         */
+        void save_snapshot(const std::string& path);
+
+        /**
+         * Replace every entity and component with those in a snapshot written by save_snapshot(). The snapshot is
+         * memory-mapped, and trivially copyable components are copied straight out of it. Component types are matched
+         * by name, so non-generated types must be registered with register_component_type() before loading; components
+         * of unknown types are skipped with a warning. Observers see every previous component being removed and every
+         * loaded one being added. Component IDs from before the load must not be used afterwards.
+         * If the file isn't a snapshot this build can load the ECS is left unchanged, but if the snapshot's contents
+         * turn out to be corrupt partway through loading, the ECS is left empty.
+         * @param path The snapshot file.
+         * @throws cyan::Error if the snapshot can't be loaded, e.g. if it has components of entities which don't exist.
+         */
+        void load_snapshot(const std::string& path);
+
+        /**
+         * Publish an immutable copy of every entity and component (see PublishedEcs), usually at the end of a tick, so
+         * other threads can read it without locking while the next tick changes the ECS. Only the registries which
+         * changed since the last publish() are copied; the rest are shared with the previous version. Changes are
+         * those recorded by change tracking (see changed_since()), so components modified through a pointer which
+         * doesn't mark them as changed must be marked with ComponentEntry::get() or a non-const view for the copy to
+         * be remade. Component types which can't be copied aren't published.
+         * @return The new version, which is also made available to get_published().
+         * @throws cyan::Error with archetype storage, which can't be published.
+         */
+        std::shared_ptr<const PublishedEcs> publish();
+
+        /**
+         * Get the latest version made by publish(). This is safe to call from any thread, concurrently with
+         * publish().
+         * @return The latest version, or nullptr if nothing has been published yet.
+         */
+        [[nodiscard]]
+        std::shared_ptr<const PublishedEcs> get_published() const;
+
+        /**
+         * Get the (approximate) number of bytes allocated for entity and component storage.
+         */
+        [[nodiscard]]
+        std::size_t memory_bytes();
+
+        /**
+         * Get statistics for the entity registry and every component registry (keyed by component type name), for
+         * choosing storage per component type (see ComponentStorage). Sizes and memory use are always reported, and
+         * operation counts (lookups, hits and misses, adds and removes, reallocations...) only when built with
+         * CYAN_ECS_STATS (see ecs_stats.hpp). With archetype storage, component registries are always empty.
+         */
+        [[nodiscard]]
+        EcsStats stats();
+
         /**
          * Test is a given entity ID exists.
          * @param e The entity to check existence of.
@@ -68,8 +214,58 @@ namespace cyan {
          */
         template <typename T>
         ComponentEntry<T> add_component(Entity e, const T& component) {
-            auto component_registry = component_map.get_component_registry<T>();
-            return component_registry->add(e, component);
+            auto record = find_entity_record<T>(e);
+            if (!record) return SingleComponentRegistry<T>::make_null_entry();
+            auto type_id = component_map.get_component_type_id<T>();
+
+            ComponentEntry<T> entry;
+            if (archetypes) {
+                entry = make_archetype_entry(e, archetypes->emplace<T>(e, type_id, component));
+            } else {
+                entry = component_map.get_component_registry<T>()->add(e, component);
+            }
+            if (entry) record->signature.set(type_id.id);
+            return entry;
+        }
+
+        /**
+         * Add a component to an entity, moving the component data into the ECS.
+         * @tparam T The type of the component to add.
+         * @param e The entity to add the component to
+         * @param component The component data
+         * @return An Entry associated with the newly-added component.
+         */
+        template <typename T, typename = std::enable_if_t<!std::is_reference_v<T>>>
+        ComponentEntry<T> add_component(Entity e, T&& component) {
+            return emplace_component<T>(e, std::move(component));
+        }
+
+        /**
+         * Add a component to each of a number of entities, reserving storage once for all of them.
+         * @tparam T The type of the components to add.
+         * @param es The entities to add components to.
+         * @param components The components, where components[i] is added to es[i].
+         */
+        template <typename T>
+        void add_components(const std::vector<Entity>& es, const std::vector<T>& components) {
+            if (es.size() != components.size()) {
+                throw cyan::Error("add_components() was given {} entities but {} components",
+                                  es.size(), components.size());
+            }
+            auto type_id = component_map.get_component_type_id<T>();
+            SingleComponentRegistry<T>* component_registry = nullptr;
+            if (!archetypes) {
+                component_registry = component_map.get_component_registry<T>();
+                component_registry->reserve(component_registry->size() + es.size());
+            }
+            for (std::size_t i = 0; i < es.size(); i += 1) {
+                auto record = find_entity_record<T>(es[i]);
+                if (!record) continue;
+                bool added = archetypes
+                        ? archetypes->emplace<T>(es[i], type_id, components[i]) != nullptr
+                        : bool(component_registry->add(es[i], components[i]));
+                if (added) record->signature.set(type_id.id);
+            }
         }
 
         /**
@@ -81,9 +277,19 @@ namespace cyan {
          * @return An Entry associated with the newly-added component.
          */
         template <typename T, typename ...Args>
-        ComponentEntry<T> emplace_component(Entity e, Args... args) {
-            auto component_registry = component_map.get_component_registry<T>();
-            return component_registry->emplace(e, std::forward(args...));
+        ComponentEntry<T> emplace_component(Entity e, Args&&... args) {
+            auto record = find_entity_record<T>(e);
+            if (!record) return SingleComponentRegistry<T>::make_null_entry();
+            auto type_id = component_map.get_component_type_id<T>();
+
+            ComponentEntry<T> entry;
+            if (archetypes) {
+                entry = make_archetype_entry(e, archetypes->emplace<T>(e, type_id, std::forward<Args>(args)...));
+            } else {
+                entry = component_map.get_component_registry<T>()->emplace(e, std::forward<Args>(args)...);
+            }
+            if (entry) record->signature.set(type_id.id);
+            return entry;
         }
 
         /**
@@ -97,15 +303,18 @@ namespace cyan {
          */
         template <typename T>
         ComponentEntry<T> get_component(Entity e) {
-            // Ensure the requested entity exists (it may have been deleted).
-            // TODO: We could delete the component here, but I'm not doing that yet to ensure get_component calls do
-            // TODO: as little work as possible (they're probably doing too much already). Still, if orphaned components
-            // TODO: prove to be a problem, consider doing that here, but an explicit cleanup scheme is probably a
-            // TODO: better idea, so try that first.
-            if (!exists(e)) {
+            // Ensure the requested entity exists (it may have been deleted) and has a component of this type, which
+            // saves looking in the registry at all if it doesn't.
+            if (!has_component<T>(e)) {
                 return SingleComponentRegistry<T>::make_null_entry();
             }
 
+            if (archetypes) {
+                auto component = static_cast<T*>(archetypes->get(e, component_map.get_component_type_id<T>()));
+                if (!component) return SingleComponentRegistry<T>::make_null_entry();
+                return make_archetype_entry(e, component);
+            }
+
             auto component_registry = component_map.get_component_registry<T>();
             return component_registry->get(e);
         }
@@ -117,12 +326,16 @@ namespace cyan {
          * If the component does not exist, a null entry will be returned (note that Entry objects can be used like
          * pointers - test for boolean value to check if it is
          * valid).
+         * Components don't have IDs with archetype storage, so this always returns a null entry in that case.
          * @tparam T The type of component to get.
          * @param cid The ID of the requested component.
          * @return An entry associated with the requested component, or null if no entity or component can be found.
          */
         template <typename T>
         ComponentEntry<T> get_component(ComponentId<T> cid) {
+            if (archetypes) {
+                return SingleComponentRegistry<T>::make_null_entry();
+            }
             auto component_registry = component_map.get_component_registry<T>();
             ComponentEntry<T> entry = component_registry->get(cid);
 
@@ -136,6 +349,37 @@ namespace cyan {
             return entry;
         }
 
+        /**
+         * Look up the components of a list of entities, e.g. the targets or parents a system follows.
+         * This gives the same components as calling get_component() for each entity, but is much faster for lists of
+         * entities scattered through memory: the entities' generations and signatures are checked in a single pass
+         * over the list, which prefetches each entity's record and components a few entities ahead, so the loads of
+         * several lookups are in flight at once rather than each waiting on the one before. For a handful of entities,
+         * or entities whose records are already in the cache, calling get_component() is faster.
+         * Several component types can be looked up at once, sharing the entity checks, e.g.
+         *      std::vector<Position*> positions;
+         *      std::vector<const Health*> healths;
+         *      ecs.get_components(targets, positions, healths);
+         * Components of non-const types are marked as changed (as with view()), so use const types to only read.
+         * @tparam Ts The component types, which are deduced from out.
+         * @param es The entities to look up.
+         * @param out For each type, a vector which is resized to es.size() and set to a pointer to each entity's
+         *            component, or nullptr if the entity doesn't exist or has no such component. The pointers are valid
+         *            until components of that type are next added or removed.
+         */
+        template <typename... Ts>
+        void get_components(const std::vector<Entity>& es, std::vector<Ts*>&... out) {
+            static_assert(sizeof...(Ts) > 0, "get_components() needs at least one component type");
+            (out.assign(es.size(), nullptr), ...);
+            if (archetypes) {
+                for (std::size_t i = 0; i < es.size(); i += 1) {
+                    ((out[i] = find_archetype_component<Ts>(es[i])), ...);
+                }
+                return;
+            }
+            get_components_impl(es, std::index_sequence_for<Ts...>{}, out...);
+        }
+
         /**
          * Remove a component from an entity, given the component type and the entity ID.
          * If the entity does not have an associated component of type T, nothing will happen.
@@ -145,10 +389,49 @@ namespace cyan {
         template <typename T>
         void remove_component(Entity e) {
             // TODO: Log an error on removal of component from nonexistent entity.
+            if (auto record = entities.get(e.id)) {
+                record->signature.reset(component_map.get_component_type_id<T>().id);
+            }
+            if (archetypes) {
+                archetypes->remove(e, component_map.get_component_type_id<T>());
+                return;
+            }
             auto component_registry = component_map.get_component_registry<T>();
             component_registry->remove(e);
         }
 
+        /**
+         * Remove every component of type T (belonging to an existing entity) for which a predicate returns true.
+         * @tparam T The type of the components to remove.
+         * @param pred A function taking (Entity, const T&) and returning whether to remove the component.
+         * @return The number of components removed.
+         */
+        template <typename T, typename Pred>
+        std::size_t remove_components_if(Pred&& pred) {
+            // Collect the entities first, as removal can move components around.
+            std::vector<Entity> matching;
+            auto type_id = component_map.get_component_type_id<T>();
+            if (archetypes) {
+                view<const T>().each([&](Entity e, const T& component) {
+                    if (pred(e, component)) matching.push_back(e);
+                });
+                for (auto e : matching) {
+                    archetypes->remove(e, type_id);
+                    entities.get(e.id)->signature.reset(type_id.id);
+                }
+                return matching.size();
+            }
+            auto component_registry = component_map.get_component_registry<T>();
+            component_registry->for_each_in_range(0, component_registry->slot_count(), [&](Entity e, T& component) {
+                if (entities.get(e.id) && pred(e, std::as_const(component))) matching.push_back(e);
+            });
+            for (auto e : matching) {
+                component_registry->remove(e);
+                entities.get(e.id)->signature.reset(type_id.id);
+            }
+            return matching.size();
+        }
+
         /**
          * Test if a component with a given type and ID exists.
          * @tparam T The type of component to query.
@@ -162,18 +445,210 @@ namespace cyan {
 
         /**
          * Test if a given entity has a component of type T.
+         * This is a single bit test on the entity's component signature, and doesn't touch the component's storage.
          * @tparam T The type of component to query.
          * @param e The ID of the entity to query for the existence of a component of type T.
          * @return Whether the given entity has a component of type T.
          */
         template <typename T>
         bool has_component(Entity e) {
-            return bool(get_component<T>(e));
+            auto record = entities.get(e.id);
+            return record && record->signature.test(component_map.get_component_type_id<T>().id);
+        }
+
+        /**
+         * Get the set of component types an entity has, indexed by component type ID (see get_component_type_id()).
+         * @param e The entity to query.
+         * @return The entity's component signature (empty if the entity doesn't exist).
+         */
+        ComponentSignature get_component_signature(Entity e);
+
+        /**
+         * Get a view over every entity that has a component of each of the given types.
+         * Iterating the view yields std::tuple<Entity, Ts&...> (see View for details), e.g.
+         *      for (auto [e, position, velocity] : ecs.view<Position, const Velocity>()) { ... }
+         * Components of non-const types are marked as changed as they're visited.
+         * @tparam Ts The component types to iterate over.
+         * @return A View which can be iterated over or used with View::each().
+         */
+        template <typename ...Ts>
+        View<Ts...> view() {
+            if (archetypes) {
+                return View<Ts...>(archetypes.get(), std::array<int, sizeof...(Ts)>{
+                        component_map.get_component_type_id<std::remove_const_t<Ts>>().id...});
+            }
+            return View<Ts...>(&entities, component_map.get_component_registry<std::remove_const_t<Ts>>()...);
+        }
+
+        /**
+         * Call a function on every component of type T (and it's entity), in parallel.
+         * The components are split into fixed-size ranges of the underlying storage, each processed as a single task
+         * on the ECS's worker pool (created on first use, see set_worker_threads()). Range k always covers
+         * storage positions [k * grain_size, (k + 1) * grain_size), so the partitioning is deterministic and doesn't
+         * depend on the number of threads. With the default storage, removed slots are skipped within each range; with
+         * packed storage (see ComponentStorage) or archetype storage the ranges are dense.
+         * fn is called concurrently from several threads, so it must only modify the component it's given. Components
+         * must not be added or removed (and entities must not be created or deleted) until par_each() returns.
+         * Every component visited is marked as changed.
+         * @tparam T The type of component to iterate over.
+         * @param fn A function taking (Entity, T&).
+         * @param grain_size The number of storage slots per task.
+         */
+        template <typename T, typename Fn>
+        void par_each(Fn&& fn, std::size_t grain_size = DEFAULT_PAR_EACH_GRAIN_SIZE) {
+            par_each_impl<T, true>(fn, grain_size);
+        }
+
+        /**
+         * As par_each(), but for functions that only read the components (which aren't marked as changed).
+         * @tparam T The type of component to iterate over.
+         * @param fn A function taking (Entity, const T&).
+         * @param grain_size The number of storage slots per task.
+         */
+        template <typename T, typename Fn>
+        void par_each_const(Fn&& fn, std::size_t grain_size = DEFAULT_PAR_EACH_GRAIN_SIZE) {
+            auto read = [&](Entity e, T& component) { fn(e, std::as_const(component)); };
+            par_each_impl<T, false>(read, grain_size);
+        }
+
+        /**
+         * Set the number of threads in the worker pool used by par_each() and par_each_const(). The calling thread
+         * always works alongside them. Each ECS has a pool of it's own, so when many ECSs run at once (e.g. one per
+         * thread), a small number avoids starting a thread per core for each of them.
+         * This must not be called while a par_each() is running.
+         * @param n_threads The number of worker threads, or 0 for one per hardware thread (the default).
+         */
+        void set_worker_threads(std::size_t n_threads);
+
+        /**
+         * Get the current tick. Components added or changed now are stamped with this tick.
+         */
+        [[nodiscard]]
+        EcsTickT current_tick() const;
+
+        /**
+         * Advance to the next tick, which is usually done once per frame. The ECS starts at tick 0.
+         * @return The new current tick.
+         */
+        EcsTickT advance_tick();
+
+        /**
+         * Call a function on each component of type T (belonging to an existing entity) that was added or changed at or
+         * after a given tick. A system that saves current_tick() when it runs and passes the saved tick next time sees
+         * every change in between, visiting only the changed components rather than the whole registry.
+         * Components in archetype storage don't record ticks, so every component is treated as changed in that case.
+         * @tparam T The type of component to iterate over.
+         * @param tick The earliest tick of interest.
+         * @param fn A function taking (Entity, const T&).
+         */
+        template <typename T, typename Fn>
+        void changed_since(EcsTickT tick, Fn&& fn) {
+            for_each_since<T, false>(tick, fn);
+        }
+
+        /**
+         * Call a function on each component of type T (belonging to an existing entity) that was added at or after a
+         * given tick (see changed_since()).
+         * @tparam T The type of component to iterate over.
+         * @param tick The earliest tick of interest.
+         * @param fn A function taking (Entity, const T&).
+         */
+        template <typename T, typename Fn>
+        void added_since(EcsTickT tick, Fn&& fn) {
+            for_each_since<T, true>(tick, fn);
+        }
+
+        /**
+         * Add an observer for components of type T being added to entities. Observers aren't called straight away:
+         * events are recorded as they happen and dispatched in batches by flush_events(), so adding and removing
+         * components stays cheap. Observers are only supported with the default (per-type registry) storage.
+         * An observer stays registered until it's removed with unobserve(), so one which refers to another object (e.g.
+         * a system capturing `this`) must be removed before that object is destroyed.
+         * @tparam T The component type to observe.
+         * @param fn A function taking (const std::vector<Entity>&), called with the entities whose component was added.
+         * @return The observer's ID, for unobserve().
+         */
+        template <typename T>
+        ObserverId on_add(ComponentObserverFn fn) {
+            return observe<T>(ComponentEvent::Added, std::move(fn));
+        }
+
+        /**
+         * Add an observer for components of type T being removed, including by deleting their entity (see on_add()).
+         * @tparam T The component type to observe.
+         * @param fn A function taking (const std::vector<Entity>&), called with the entities whose component was
+         *           removed. The components no longer exist when the observer is called.
+         * @return The observer's ID, for unobserve().
+         */
+        template <typename T>
+        ObserverId on_remove(ComponentObserverFn fn) {
+            return observe<T>(ComponentEvent::Removed, std::move(fn));
+        }
+
+        /**
+         * Add an observer for components of type T being changed, as recorded by change tracking (see changed_since()
+         * and on_add()).
+         * @tparam T The component type to observe.
+         * @param fn A function taking (const std::vector<Entity>&), called with the entities whose component changed.
+         * @return The observer's ID, for unobserve().
+         */
+        template <typename T>
+        ObserverId on_change(ComponentObserverFn fn) {
+            return observe<T>(ComponentEvent::Changed, std::move(fn));
+        }
+
+        /**
+         * Remove an observer added with on_add(), on_remove() or on_change(). It won't be called again, even if it's
+         * removed by an observer during flush_events(). Once a component type has no observers of a kind of event,
+         * events of that kind are no longer recorded.
+         * @param observer The observer's ID. Removing an observer which has already been removed does nothing.
+         * @return Whether the observer was found (and removed).
+         */
+        bool unobserve(ObserverId observer);
+
+        /**
+         * Dispatch every component event recorded since the last flush to it's observers, one batch per component type
+         * and kind of event (see SingleComponentRegistry::flush_events()). Usually called once per frame (e.g. by
+         * SystemScheduler::run_frame()).
+         */
+        void flush_events();
+
+        /**
+         * Incrementally remove orphaned components - components whose entity no longer exists.
+         * Deleting an entity through the ECS removes it's components immediately, but components can be orphaned by
+         * adding them through a registry directly (see get_component_registry()). Each registry has a sweep cursor
+         * that persists between calls, and registries are swept in turns a batch of slots at a time (see
+         * ECS_GC_SWEEP_BATCH_SIZE), so over enough calls every slot of every registry is visited. The call returns
+         * once the time budget has been used (it always sweeps at least one batch), or once every registry has been
+         * swept to it's end. Components are never orphaned with archetype storage, so this does nothing in that case.
+         * @param budget The wall-clock time this call may spend sweeping.
+         * @param max_batches The maximum number of batches to sweep, regardless of the time budget.
+         * @return What was scanned and reclaimed.
+         */
+        EcsGcReport collect_garbage(std::chrono::nanoseconds budget = DEFAULT_ECS_GC_BUDGET,
+                                    std::size_t max_batches = std::numeric_limits<std::size_t>::max());
+
+        /**
+         * Run a garbage collection cycle, via collect_garbage() with the default time budget.
+         * Sweeping is done by cursor rather than by random probing, so generator isn't used.
+         * @param generator Unused.
+         * @param iters The maximum number of batches to sweep, in addition to the time budget. Values below 1 only
+         *              apply the time budget.
+         */
+        void gc(std::random_device& generator, int iters) override;
+
+        /**
+         * Get the integer ID associated with a component type (see ComponentMap::get_component_type_id()).
+         * @tparam T The component type.
+         */
+        template <typename T>
+        ecs_impl::ComponentTypeId get_component_type_id() {
+            return component_map.get_component_type_id<T>();
         }
 
         /**
          * Get an entire component registry.
-         * This function mainly exists for use in testing.
+         * This function mainly exists for use in testing. With archetype storage, the registry is always empty.
          * @tparam T The type of the registry to get
          * @return A SingleComponentRegistry<T>
          */
@@ -185,5 +660,228 @@ namespace cyan {
     private:
         EntityRegistry entities;
         ecs_impl::ComponentMap component_map;
+        /// Only present when using archetype storage, in which case it stores all components.
+        std::unique_ptr<ecs_impl::ArchetypeStorage> archetypes;
+        /// Threads for par_each(), created on first use.
+        std::unique_ptr<ThreadPool> worker_pool;
+        std::mutex worker_pool_mutex;
+        /// The number of threads worker_pool is created with (see set_worker_threads()).
+        std::size_t worker_threads = 0;
+        /// The next storage slot collect_garbage() will sweep in each registry, indexed by registry position (see
+        /// ComponentMap::registry_position_count()).
+        std::vector<std::size_t> gc_cursors;
+        /// The registry position collect_garbage() will sweep next.
+        std::size_t gc_next_position = 0;
+        /// The current tick (see advance_tick()).
+        EcsTickT tick = 0;
+        /// The version given to the last publish(), whether entities have been created or deleted since then, and the
+        /// entity IDs it published (shared by later versions until entities change).
+        std::uint64_t published_version = 0;
+        bool entities_unpublished = true;
+        std::shared_ptr<const std::vector<EcsIdT>> published_entity_ids;
+        /// The latest version, read and written atomically (see get_published()).
+        std::shared_ptr<const PublishedEcs> latest_published;
+
+        /**
+         * Internal function to get an entity's record, for adding a component of type T to it.
+         * Components can't be added to entities that don't exist, so this logs a warning if the entity doesn't exist.
+         */
+        template <typename T>
+        EntityRecord* find_entity_record(Entity e) {
+            auto record = entities.get(e.id);
+            if (!record) {
+                LOG(WARN, "Attempted to add a component (type id {}) to entity {}, which doesn't exist. The provided "
+                          "component will be discarded.", component_map.get_component_type_id<T>().id, e.id);
+                return nullptr;
+            }
+            return record.value;
+        }
+
+        /**
+         * Internal function to get the worker pool, creating it if needed.
+         */
+        ThreadPool& get_worker_pool();
+
+        /**
+         * Internal function to add an observer of a component event to the registry for T.
+         */
+        template <typename T>
+        ObserverId observe(ComponentEvent event, ComponentObserverFn fn) {
+            auto type_id = component_map.get_component_type_id<T>();
+            if (archetypes) {
+                LOG(WARN, "Component observers aren't supported with archetype storage, so observers of component type "
+                          "{} will never be called.", type_id.id);
+            }
+            return ObserverId{type_id.id, component_map.get_component_registry<T>()->observe(event, std::move(fn))};
+        }
+
+        /**
+         * Internal function implementing par_each() and par_each_const(). Components are marked as changed if Modify
+         * is set.
+         */
+        template <typename T, bool Modify, typename Fn>
+        void par_each_impl(Fn& fn, std::size_t grain_size) {
+            grain_size = std::max<std::size_t>(grain_size, 1);
+            if (archetypes) {
+                par_each_archetype<T>(fn, grain_size);
+                return;
+            }
+
+            auto component_registry = component_map.get_component_registry<T>();
+            auto n_slots = component_registry->slot_count();
+            get_worker_pool().parallel_for((n_slots + grain_size - 1) / grain_size, [&](std::size_t range) {
+                auto first = range * grain_size;
+                auto last = std::min(first + grain_size, n_slots);
+                auto visit = [&](Entity e, T& component) {
+                    // Skip components orphaned by deleted entities.
+                    if (entities.get(e.id)) fn(e, component);
+                };
+                if constexpr (Modify) {
+                    component_registry->modify_each_in_range(first, last, visit);
+                } else {
+                    component_registry->for_each_in_range(first, last, visit);
+                }
+            });
+        }
+
+        /**
+         * Internal function implementing changed_since() and added_since().
+         */
+        template <typename T, bool Added, typename Fn>
+        void for_each_since(EcsTickT since, Fn& fn) {
+            if (archetypes) {
+                view<const T>().each(fn);
+                return;
+            }
+            auto visit = [&](Entity e, const T& component) {
+                if (entities.get(e.id)) fn(e, component);
+            };
+            auto component_registry = component_map.get_component_registry<T>();
+            if constexpr (Added) {
+                component_registry->added_since(since, visit);
+            } else {
+                component_registry->changed_since(since, visit);
+            }
+        }
+
+        /**
+         * Internal function implementing par_each() for archetype storage, where each range is (part of) a chunk.
+         */
+        template <typename T, typename Fn>
+        void par_each_archetype(Fn& fn, std::size_t grain_size) {
+            struct Range {
+                const EcsIdT* entity_ids;
+                T* components;
+                std::size_t count;
+            };
+            std::vector<Range> ranges;
+            int type_id = component_map.get_component_type_id<T>().id;
+            std::size_t archetype = 0;
+            std::size_t chunk = 0;
+            ecs_impl::ArchetypeChunkView chunk_view;
+            void* column = nullptr;
+            while (archetypes->next_matching_chunk(&type_id, 1, archetype, chunk, chunk_view, &column)) {
+                for (std::size_t first = 0; first < chunk_view.count; first += grain_size) {
+                    ranges.push_back(Range{chunk_view.entity_ids + first, static_cast<T*>(column) + first,
+                                           std::min(grain_size, chunk_view.count - first)});
+                }
+                chunk += 1;
+            }
+
+            get_worker_pool().parallel_for(ranges.size(), [&](std::size_t index) {
+                auto& range = ranges[index];
+                for (std::size_t row = 0; row < range.count; row += 1) {
+                    fn(Entity{range.entity_ids[row]}, range.components[row]);
+                }
+            });
+        }
+
+        /**
+         * Internal function implementing get_components() with component registries. The prefetch steps for entity i
+         * are taken GET_COMPONENTS_PREFETCH_DISTANCE lookups apart, the last that many lookups before entity i's.
+         * What the steps resolve (the entity's record, and the ID of each of it's components) is kept in a ring until
+         * the entity's lookup, so no chain of loads is walked twice.
+         */
+        template <typename... Ts, std::size_t... Is>
+        void get_components_impl(const std::vector<Entity>& es, std::index_sequence<Is...>, std::vector<Ts*>&... out) {
+            std::tuple<SingleComponentRegistry<std::remove_const_t<Ts>>*...> registries{
+                    component_map.get_component_registry<std::remove_const_t<Ts>>()...};
+            const int type_ids[] = {component_map.get_component_type_id<std::remove_const_t<Ts>>().id...};
+            constexpr auto distance = std::ptrdiff_t(GET_COMPONENTS_PREFETCH_DISTANCE);
+            constexpr int n_steps = std::max({
+                    SingleComponentRegistry<std::remove_const_t<Ts>>::LOOKUP_PREFETCH_STEPS...});
+            static_assert(n_steps >= 2, "Records are resolved in the second step");
+            auto n = std::ptrdiff_t(es.size());
+
+            // An entity's record is resolved n_steps - 1 steps before it's lookup, so the ring only needs that many
+            // entries (times the distance between steps) before it's reused.
+            struct Resolved {
+                EntityRecord* record;
+                EcsIdT component_ids[sizeof...(Ts)];
+            };
+            constexpr auto ring_size = std::size_t(distance * n_steps);
+            std::array<Resolved, ring_size> ring;
+
+            // Start before the first entity, so the first few lookups are prefetched as well.
+            for (std::ptrdiff_t i = -distance * n_steps; i < n; i += 1) {
+                for (int step = 0; step < n_steps; step += 1) {
+                    auto ahead = i + distance * (n_steps - step);
+                    if (ahead < 0 || ahead >= n) continue;
+                    auto e = es[std::size_t(ahead)];
+                    auto& resolved = ring[std::size_t(ahead) % ring_size];
+                    // The entity's record is read by the check below, so it's resolved alongside the registries.
+                    if (step == 0) entities.prefetch(e.id);
+                    if (step == 1) {
+                        resolved.record = entities.get(e.id).value;
+                        if (resolved.record) ecs_impl::prefetch(resolved.record);
+                    }
+                    if (step < n_steps - 1) {
+                        (std::get<Is>(registries)->prefetch_lookup(e, step), ...);
+                    } else {
+                        ((resolved.component_ids[Is] = std::get<Is>(registries)->resolve_lookup(e)), ...);
+                    }
+                }
+                if (i < 0) continue;
+
+                auto index = std::size_t(i);
+                auto& resolved = ring[index % ring_size];
+                if (!resolved.record) continue;
+                ((out[index] = resolved.record->signature.test(type_ids[Is])
+                        ? find_registry_component<Ts>(*std::get<Is>(registries), resolved.component_ids[Is])
+                        : nullptr), ...);
+            }
+        }
+
+        /**
+         * Internal function to finish the lookup of a component for get_components(), from the component ID resolved
+         * while prefetching, marking it as changed unless T is const.
+         */
+        template <typename T>
+        static T* find_registry_component(SingleComponentRegistry<std::remove_const_t<T>>& registry,
+                                          EcsIdT component_id) {
+            if constexpr (std::is_const_v<T>) {
+                return registry.find_resolved(component_id);
+            } else {
+                return registry.find_resolved_for_write(component_id);
+            }
+        }
+
+        /**
+         * Internal function to find an entity's component in archetype storage for get_components().
+         */
+        template <typename T>
+        T* find_archetype_component(Entity e) {
+            using ComponentT = std::remove_const_t<T>;
+            if (!has_component<ComponentT>(e)) return nullptr;
+            return static_cast<ComponentT*>(archetypes->get(e, component_map.get_component_type_id<ComponentT>()));
+        }
+
+        /**
+         * Internal function to make a component entry for a component in archetype storage (which has no component ID).
+         */
+        template <typename T>
+        static ComponentEntry<T> make_archetype_entry(Entity e, T* component) {
+            return ComponentEntry<T>{e, ComponentId<T>{ECS_NULL_INDEX}, component};
+        }
     };
 }
\ No newline at end of file
@@ -8,29 +8,72 @@
 
 #pragma once
 
+#include <bitset>
+#include <cstddef>
 #include <cstdint>
 #include <limits>
+#include <type_traits>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
 
 // Required to ensure some VC++ legacy macros don't make issues with numeric_limits::max()
 #ifdef max
 #undef max
 #endif
 
+// The width of ECS IDs, and how many of those bits hold the generation, are build-time parameters (e.g. set with
+// -DCYAN_ECS_ID_BITS=32 -DCYAN_ECS_GENERATION_BITS=12 for 4 byte IDs with up to ~1M live objects). IDs are 64 bits
+// split evenly by default. Fewer generation bits means slots are retired sooner (see ECS_MAX_GENERATION).
+#ifndef CYAN_ECS_ID_BITS
+#define CYAN_ECS_ID_BITS 64
+#endif
+#ifndef CYAN_ECS_GENERATION_BITS
+#define CYAN_ECS_GENERATION_BITS (CYAN_ECS_ID_BITS / 2)
+#endif
+
 namespace cyan {
+    static_assert(CYAN_ECS_ID_BITS == 32 || CYAN_ECS_ID_BITS == 64, "CYAN_ECS_ID_BITS must be 32 or 64");
+
     // Type aliases and utiltity values for # of bits and masks for use by the ECS generation/index split scheme.
-    using EcsIdT = std::uint64_t;
+    using EcsIdT = std::conditional_t<CYAN_ECS_ID_BITS == 32, std::uint32_t, std::uint64_t>;
     using EcsGenerationT = EcsIdT;
     using EcsIndexT = EcsIdT;
-    constexpr std::uint64_t ENTITY_GENERATION_BITS = 32;
+    constexpr std::uint64_t ENTITY_GENERATION_BITS = CYAN_ECS_GENERATION_BITS;
     constexpr std::uint64_t ECS_INDEX_BITS = std::numeric_limits<EcsIdT>::digits
                                                 - ENTITY_GENERATION_BITS;
     constexpr std::uint64_t ECS_INDEX_MASK = ((~(EcsIdT) 0) >> ENTITY_GENERATION_BITS);
     constexpr std::uint64_t ECS_NULL_INDEX = std::numeric_limits<EcsIdT>::max() & ECS_INDEX_MASK;
     static_assert(ECS_INDEX_BITS > 0);
-    static_assert(ENTITY_GENERATION_BITS > 0);
+    static_assert(ENTITY_GENERATION_BITS > 1, "At least one generation value is needed besides the reserved one");
     static_assert(ECS_INDEX_BITS + ENTITY_GENERATION_BITS == std::numeric_limits<EcsIdT>::digits);
     static_assert(ECS_NULL_INDEX != std::numeric_limits<EcsIdT>::max());
 
+    // The largest generation is reserved for IDs which never refer to a stored object (e.g. the placeholder entities
+    // handed out by EcsCommandBuffer).
+    constexpr EcsGenerationT ECS_RESERVED_GENERATION = (~EcsIdT(0)) >> ECS_INDEX_BITS;
+
+    // The last generation a slot can be given. Rather than wrapping around (which would let a stale ID match a new
+    // object), a slot whose object is removed at this generation is retired: it's never reused, so the registry loses
+    // one slot of capacity each time this happens.
+    constexpr EcsGenerationT ECS_MAX_GENERATION = ECS_RESERVED_GENERATION - 1;
+
+    // The number of slots a registry can hold. The last index is ECS_NULL_INDEX, which never refers to an object.
+    constexpr std::uint64_t ECS_MAX_SLOTS = ECS_NULL_INDEX;
+
+    // Ticks count frames (see ECS::advance_tick()), and are used to record when components were added or changed. At
+    // 60 ticks a second, a 32 bit tick lasts for over two years of continuous running, so wrapping isn't handled.
+    using EcsTickT = std::uint32_t;
+
+    // ObjectRegistry allocates storage in pages of (at most) this many bytes, which are never moved once allocated.
+    constexpr std::size_t ECS_OBJECT_PAGE_BYTES = 16 * 1024;
+
+    // Component type IDs (see ComponentMap) are limited to [0, ECS_MAX_COMPONENT_TYPES), so that the set of component
+    // types an entity has can be stored as a fixed-size bitset indexed by type ID.
+    constexpr std::size_t ECS_MAX_COMPONENT_TYPES = 256;
+    using ComponentSignature = std::bitset<ECS_MAX_COMPONENT_TYPES>;
+
     namespace ecs_impl {
         /** Extracts the generation number from an ECS id.
          * @param id The ECS id value
@@ -51,5 +94,20 @@ namespace cyan {
          * @return A combined bitmanipulated ID value
          */
         EcsIdT make_ecs_id(EcsGenerationT generation, EcsIndexT index);
+
+        /**
+         * Hint that memory will be read soon, so the CPU can start loading it into the cache. This never faults, so
+         * any address may be given. Does nothing on compilers without a prefetch intrinsic.
+         * @param address The address to prefetch.
+         */
+        inline void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+            _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+            (void) address;
+#endif
+        }
     }
 }
\ No newline at end of file
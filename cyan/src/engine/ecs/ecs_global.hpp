@@ -1,5 +1,7 @@
 /**
  * Contains global functions that operate on a global ECS object.
+ * This is a convenience for programs with a single world. An Engine owns it's own ECS (see Engine::ecs()) and never
+ * touches the global one, so any number of engines can run side by side.
  */
 
 #pragma once
@@ -7,9 +9,8 @@
 #include "ecs.hpp"
 
 namespace cyan::ecs {
-    // TODO: If we have issues with this, it may be best to use a pointer that is initialized by the engine setup.
-    //       for now, it has a default constructor, so we should be fine.
-    static ECS global_ecs;
+    /// The global ECS, shared by every translation unit (it's defined in ecs_global.cpp).
+    extern ECS global_ecs;
 
     /**
      * Create a new entity with no associated components.
@@ -51,8 +52,8 @@ namespace cyan::ecs {
      * @return An Entry associated with the newly-added component.
      */
     template <typename T, typename ...Args>
-    ComponentEntry<T> emplace_component(Entity e, Args... args) {
-        return global_ecs.emplace_component<T>(e, std::forward(args...));
+    ComponentEntry<T> emplace_component(Entity e, Args&&... args) {
+        return global_ecs.emplace_component<T>(e, std::forward<Args>(args)...);
     }
 
     /**
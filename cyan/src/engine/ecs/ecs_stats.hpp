@@ -0,0 +1,172 @@
+/**
+ * Optional instrumentation of the ECS's registries (see ECS::stats()).
+ * Footprint figures (sizes, memory, lookup table occupancy) are always available, as they're computed on demand.
+ * Operation counters (lookups, hits and misses, adds and removes, free slot reuse, reallocations) are only kept when
+ * built with CYAN_ECS_STATS=1 (the CYAN_ECS_STATS CMake option), and are compiled out entirely otherwise. Counters are
+ * relaxed atomics, so lookups from several threads (e.g. ECS::par_each() or a PublishedEcs) are counted correctly,
+ * at some cost to those lookups.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <string>
+
+#ifndef CYAN_ECS_STATS
+#define CYAN_ECS_STATS 0
+#endif
+
+/// Add one (or n) to an ecs_impl::StatCounter, when operation counters are enabled.
+#if CYAN_ECS_STATS
+#define CYAN_ECS_COUNT(counter) (counter).add(1)
+#define CYAN_ECS_COUNT_N(counter, n) (counter).add(n)
+#else
+#define CYAN_ECS_COUNT(counter) ((void) 0)
+#define CYAN_ECS_COUNT_N(counter, n) ((void) 0)
+#endif
+
+namespace cyan {
+    /// Whether operation counters are kept (see CYAN_ECS_STATS).
+    constexpr bool ECS_STATS_ENABLED = CYAN_ECS_STATS;
+
+    /**
+     * Operations counted by an object registry (the storage for entities, or for a component type). Every count is
+     * zero unless ECS_STATS_ENABLED.
+     */
+    struct ObjectRegistryStats {
+        /// Lookups by ID, and how many found their object.
+        std::size_t n_gets = 0;
+        std::size_t n_hits = 0;
+        std::size_t n_misses = 0;
+        /// Misses where the slot was live, but held a different generation (i.e. a stale ID).
+        std::size_t n_generation_rejects = 0;
+        std::size_t n_adds = 0;
+        std::size_t n_removes = 0;
+        /// Adds which reused a free slot rather than appending one.
+        std::size_t n_slot_reuses = 0;
+        /// Times the registry's slot table was reallocated to grow it.
+        std::size_t n_reallocations = 0;
+    };
+
+    /**
+     * Statistics for the registry of one component type (see ECS::stats()).
+     */
+    struct ComponentRegistryStats {
+        /// The number of live components, and the number of storage slots (live or not).
+        std::size_t n_components = 0;
+        std::size_t n_slots = 0;
+        /// The bytes allocated by the registry (see IComponentRegistry::memory_bytes()), and that divided by the
+        /// number of live components (0 for an empty registry).
+        std::size_t memory_bytes = 0;
+        double bytes_per_component = 0.0;
+        /// The entity-to-component lookup table (a SparseSet): the number of pages allocated, and the fraction of the
+        /// entity slots in those pages which hold a component.
+        std::size_t n_lookup_pages = 0;
+        double lookup_load_factor = 0.0;
+
+        /// Lookups of a component by entity, and how many found one (counted only if ECS_STATS_ENABLED).
+        std::size_t n_gets = 0;
+        std::size_t n_hits = 0;
+        std::size_t n_misses = 0;
+        /// Misses where the entity's index held a component of a different generation of the entity.
+        std::size_t n_generation_rejects = 0;
+        std::size_t n_adds = 0;
+        std::size_t n_removes = 0;
+        /// The component storage's own counters.
+        ObjectRegistryStats storage;
+    };
+
+    /**
+     * Statistics for a whole ECS (see ECS::stats()).
+     */
+    struct EcsStats {
+        /// Whether the operation counters were kept (see ECS_STATS_ENABLED).
+        bool counters_enabled = ECS_STATS_ENABLED;
+        std::size_t n_entities = 0;
+        /// The entity registry's counters.
+        ObjectRegistryStats entities;
+        /// Lookups of a component registry by type, and how many of them created the registry (counted only if
+        /// ECS_STATS_ENABLED).
+        std::size_t n_registry_lookups = 0;
+        std::size_t n_registries_created = 0;
+        /// Each component registry, keyed by component type name (see ECS::register_component_type()). Types without
+        /// a name are keyed by their type ID, e.g. "#3".
+        std::map<std::string, ComponentRegistryStats> components;
+    };
+
+    namespace ecs_impl {
+        /**
+         * A counter for the ECS's statistics, which can be incremented from several threads at once (with relaxed
+         * ordering, so it's only a count). Copies take the current value.
+         */
+        struct StatCounter {
+            StatCounter() = default;
+            StatCounter(const StatCounter& other) : value(other.get()) {}
+            StatCounter& operator=(const StatCounter& other) {
+                value.store(other.get(), std::memory_order_relaxed);
+                return *this;
+            }
+
+            void add(std::size_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+
+            [[nodiscard]]
+            std::size_t get() const { return value.load(std::memory_order_relaxed); }
+
+        private:
+            std::atomic<std::size_t> value{0};
+        };
+
+        /**
+         * The counters kept by ObjectRegistry and PackedObjectRegistry when ECS_STATS_ENABLED.
+         */
+        struct ObjectRegistryCounters {
+            StatCounter n_gets;
+            StatCounter n_misses;
+            StatCounter n_generation_rejects;
+            StatCounter n_adds;
+            StatCounter n_removes;
+            StatCounter n_slot_reuses;
+            StatCounter n_reallocations;
+
+            [[nodiscard]]
+            ObjectRegistryStats get() const {
+                ObjectRegistryStats stats;
+                stats.n_gets = n_gets.get();
+                stats.n_misses = n_misses.get();
+                stats.n_hits = stats.n_gets - std::min(stats.n_misses, stats.n_gets);
+                stats.n_generation_rejects = n_generation_rejects.get();
+                stats.n_adds = n_adds.get();
+                stats.n_removes = n_removes.get();
+                stats.n_slot_reuses = n_slot_reuses.get();
+                stats.n_reallocations = n_reallocations.get();
+                return stats;
+            }
+        };
+
+        /**
+         * The counters kept by SingleComponentRegistry when ECS_STATS_ENABLED.
+         */
+        struct ComponentRegistryCounters {
+            StatCounter n_gets;
+            StatCounter n_misses;
+            StatCounter n_generation_rejects;
+            StatCounter n_adds;
+            StatCounter n_removes;
+
+            /**
+             * Copy the counts into a ComponentRegistryStats.
+             */
+            void get(ComponentRegistryStats& stats) const {
+                stats.n_gets = n_gets.get();
+                stats.n_misses = n_misses.get();
+                stats.n_hits = stats.n_gets - std::min(stats.n_misses, stats.n_gets);
+                stats.n_generation_rejects = n_generation_rejects.get();
+                stats.n_adds = n_adds.get();
+                stats.n_removes = n_removes.get();
+            }
+        };
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ecs_common.hpp"
+#include "object_registry.hpp"
 
 #include <vector>
 
@@ -8,6 +9,13 @@ namespace cyan {
     struct Entity {
         EcsIdT id = ECS_NULL_INDEX;
     };
+
+    /// The data the ECS stores for each entity.
+    struct EntityRecord {
+        /// The component types the entity has, indexed by component type ID.
+        ComponentSignature signature;
+    };
+    using EntityRegistry = ecs_impl::ObjectRegistry<EntityRecord>;
 }
 
 namespace std
@@ -1,10 +1,19 @@
 #pragma once
 
 #include "cyan/src/engine/ecs/ecs_common.hpp"
+#include "cyan/src/engine/ecs/ecs_stats.hpp"
 #include "cyan/src/logging/assert.hpp"
+#include "cyan/src/logging/error.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
 #include <queue>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace cyan::ecs_impl {
@@ -12,9 +21,15 @@ namespace cyan::ecs_impl {
      * Provides a reusable array of objects with unique identifiers.
      * Identifiers combine an index within an internal array and a generation value to prevent incidences of deleting
      * an object and having it's index reused causing errors.
-     * Important note: Object registry functions return Entries, which are simple pointer + id combinations.
-     * You should save the ID of an object, NOT the entry - the entry pointer may become invalidated. When you want to
-     * use an object, the entry should be obtained via ID lookup (see get() function).
+     * Objects are stored in fixed-size pages (see ECS_OBJECT_PAGE_BYTES), which are allocated as the registry grows
+     * and never moved, so adding objects never copies existing ones and an object's address is stable for it's whole
+     * lifetime.
+     * A slot whose generation reaches ECS_MAX_GENERATION is retired once it's object is removed, rather than reused, so
+     * old IDs can never match a newer object.
+     * Important note: Object registry functions return Entries, which are simple pointer + id combinations. An entry's
+     * pointer stays valid until the object is removed, but you should still save the ID of an object, NOT the entry -
+     * once the object is removed, the pointer may refer to an unrelated object which reused the slot, whereas the ID
+     * will correctly fail to look up (see get() function).
      * @tparam T The type of object to be stored.
      */
     template <typename T>
@@ -27,89 +42,157 @@ namespace cyan::ecs_impl {
             EcsIndexT id = ECS_NULL_INDEX;
             T* value;
 
-            /// operator* overloads to allow this object to be used as if it's a pointer.
+            /// operator* and operator-> overloads to allow this object to be used as if it's a pointer.
             T& operator*() { return *value; }
             const T& operator*() const { return *value; }
+            T* operator->() { return value; }
+            const T* operator->() const { return value; }
 
             /// Boolean conversion to check if the entry is valid.
             explicit operator bool() { return value != nullptr; }
         };
 
+        ObjectRegistry() = default;
+
+        ObjectRegistry(const ObjectRegistry& other)
+            : entries(other.entries), empty_indices(other.empty_indices), n_retired(other.n_retired)
+        {
+            // The objects are copied into pages of our own, so every live entry's pointer has to be redirected.
+            reserve_pages(other.pages.size());
+            for (std::size_t index = 0; index < entries.size(); index += 1) {
+                if (!entries[index].value) continue;
+                entries[index].value = construct_in_slot(index, *other.entries[index].value);
+            }
+        }
+
+        ObjectRegistry(ObjectRegistry&& other) noexcept
+            : entries(std::move(other.entries)),
+              empty_indices(std::move(other.empty_indices)),
+              n_retired(other.n_retired),
+              pages(std::move(other.pages))
+        {
+            other.entries.clear();
+            other.empty_indices = {};
+            other.n_retired = 0;
+        }
+
+        ObjectRegistry& operator=(ObjectRegistry other) noexcept {
+            std::swap(entries, other.entries);
+            std::swap(empty_indices, other.empty_indices);
+            std::swap(n_retired, other.n_retired);
+            std::swap(pages, other.pages);
+            return *this;
+        }
+
+        ~ObjectRegistry() {
+            for (auto& entry : entries) {
+                if (entry.value) std::destroy_at(entry.value);
+            }
+        }
+
         /**
          * Add a copy of an object to the array and return a reference entry.
-         * TODO: We probably want an rvalue-reference argument option.
          * @param object The object to make a copy of.
          * @return An entry which can be used to retrieve the value.
          */
         Entry add(const T& object) {
-            CYAN_ASSERT(entries.size() == object_array.size());
-
-            EcsIndexT target_index = ECS_NULL_INDEX;
-
-            if (!empty_indices.empty()) {
-                // If we have empty indices, use those first.
-                target_index = empty_indices.front();
-                empty_indices.pop();
-                CYAN_ASSERT(!entries[target_index]);
-                entries[target_index].id = make_ecs_id(
-                        get_generation(entries[target_index].id) + 1,
-                        target_index);
-                entries[target_index].value = &object_array[target_index];
-                object_array[target_index] = object;
-            } else {
-                // Otherwise, we allocate a new slot for the component.
-                target_index = object_array.size();
-                object_array.push_back(object);
-                entries.push_back({target_index, &object_array[target_index]});
-            }
+            return emplace(object);
+        }
 
-            return entries[target_index];
+        /**
+         * Move an object into the array and return a reference entry.
+         * @param object The object to move from.
+         * @return An entry which can be used to retrieve the value.
+         */
+        Entry add(T&& object) {
+            return emplace(std::move(object));
         }
 
         /**
          * Create an object in-place and return a reference entry.
+         * The object is constructed directly in it's slot and is never moved, so T doesn't need to be
+         * default-constructible, copyable or movable.
          * @tparam Args The types to construct the object from.
          * @param args The values to construct the object from.
          * @return An entry which can be used to retrieve the value.
          */
         template <typename ...Args>
-        Entry emplace(Args... args) {
-            CYAN_ASSERT(entries.size() == object_array.size());
-
+        Entry emplace(Args&&... args) {
             EcsIndexT target_index;
 
             if (!empty_indices.empty()) {
                 // If we have empty indices, use those first.
                 target_index = empty_indices.front();
-                empty_indices.pop();
                 CYAN_ASSERT(!entries[target_index]);
+                T* object = construct_in_slot(target_index, std::forward<Args>(args)...);
+                CYAN_ECS_COUNT(counters.n_slot_reuses);
+                empty_indices.pop();
                 entries[target_index].id = make_ecs_id(
-                        get_generation(component_entries[target_index].id) + 1,
+                        get_generation(entries[target_index].id) + 1,
                         target_index);
-                entries[target_index].value = &object_array[target_index];
-                object_array[target_index] = T(args...);
+                entries[target_index].value = object;
             } else {
-                // Otherwise, we allocate a new slot for the component.
-                target_index = components.size();
-                object_array.emplace_back(std::forward(args...));
-                entries.emplace_back(e, target_index, &object_array[target_index]);
+                // Otherwise, we allocate a new slot for the object.
+                target_index = entries.size();
+                if (target_index >= ECS_MAX_SLOTS) {
+                    throw cyan::Error("ObjectRegistry is full: all {} slots are in use or retired", ECS_MAX_SLOTS);
+                }
+                reserve_pages(target_index / OBJECTS_PER_PAGE + 1);
+                // Make room before constructing, so push_back() can't throw with a live object in the slot. This grows
+                // geometrically, as reserve() on it's own allocates exactly what's asked for.
+                if (entries.size() == entries.capacity()) {
+                    grow_entries(std::max<std::size_t>(MIN_ENTRY_CAPACITY, entries.capacity() * 2));
+                }
+                T* object = construct_in_slot(target_index, std::forward<Args>(args)...);
+                entries.push_back({target_index, object});
             }
 
+            CYAN_ECS_COUNT(counters.n_adds);
             return entries[target_index];
         }
 
+        /**
+         * Add copies of an array of trivially copyable objects, e.g. straight out of a memory-mapped snapshot. The
+         * objects are given new slots at the end of the registry (so they're stored in order, and copied in a memcpy
+         * per page), regardless of any free slots.
+         * @param objects The objects to copy.
+         * @param n The number of objects.
+         * @return The index of the first object's slot. Object i has the ID make_ecs_id(0, index + i).
+         */
+        EcsIndexT add_copies(const T* objects, std::size_t n) {
+            static_assert(std::is_trivially_copyable_v<T>, "add_copies() needs a trivially copyable type");
+            auto first = entries.size();
+            if (first + n > ECS_MAX_SLOTS) {
+                throw cyan::Error("ObjectRegistry is full: all {} slots are in use or retired", ECS_MAX_SLOTS);
+            }
+            reserve(first + n);
+            for (std::size_t index = first; index < first + n;) {
+                auto n_in_page = std::min(OBJECTS_PER_PAGE - index % OBJECTS_PER_PAGE, first + n - index);
+                auto& page = pages[index / OBJECTS_PER_PAGE];
+                if (!page) page.reset(new Slot[OBJECTS_PER_PAGE]);
+                auto slots = page.get() + index % OBJECTS_PER_PAGE;
+                std::memcpy(slots, objects + (index - first), n_in_page * sizeof(T));
+                for (std::size_t i = 0; i < n_in_page; i += 1) {
+                    entries.push_back({make_ecs_id(0, index + i), reinterpret_cast<T*>(slots[i].bytes)});
+                }
+                index += n_in_page;
+            }
+            CYAN_ECS_COUNT_N(counters.n_adds, n);
+            return first;
+        }
+
         /**
          * Look up an entry from an ID.
          * @param id The id of the object.
          * @return
          */
         Entry get(EcsIndexT id) {
-            CYAN_ASSERT(entries.size() == object_array.size());
-
             auto index = get_index(id);
+            CYAN_ECS_COUNT(counters.n_gets);
 
             // Make sure the provided index is exists within the array.
             if (index >= entries.size()) {
+                CYAN_ECS_COUNT(counters.n_misses);
                 return make_null_entry();
             }
 
@@ -117,24 +200,38 @@ namespace cyan::ecs_impl {
             // the requested object.
             Entry& entry = entries[index];
             if (entry.value == nullptr || entry.id != id) {
+                CYAN_ECS_COUNT(counters.n_misses);
+                if (entry.value) CYAN_ECS_COUNT(counters.n_generation_rejects);
                 return make_null_entry();
             }
 
-            // add() and emplace() calls can invalidate our pointers within entries.
-            // This is fine - we don't use the pointers internally, they're for use by the caller, but it means we have
-            // to ensure that an entry has an up-to-date pointer on each get() call.
-            entry.value = &object_array[index];
-
             return entry;
         }
 
+        /**
+         * Look up the object in a slot by it's index alone, e.g. for an index recorded alongside the registry, whose
+         * slot is known to hold the right object.
+         * @param index The index of the slot, less than slot_count().
+         * @return The object, or nullptr if the slot is empty.
+         */
+        T* get_in_slot(EcsIndexT index) {
+            return entries[index].value;
+        }
+
+        /**
+         * Prefetch the slot of an ID, ahead of a get() of it. Does nothing if the ID's index is out of range.
+         * @param id The ID which will be looked up.
+         */
+        void prefetch(EcsIndexT id) const {
+            auto index = get_index(id);
+            if (index < entries.size()) ecs_impl::prefetch(&entries[index]);
+        }
+
         /**
          * Remove an object from the array.
          * @param id The id of the object to remove.
          */
         void remove(EcsIndexT id) {
-            CYAN_ASSERT(entries.size() == object_array.size());
-
             auto index = get_index(id);
 
             // Make sure the provided index is exists within the array.
@@ -147,13 +244,71 @@ namespace cyan::ecs_impl {
                 return;
             }
 
-            // Ensure this object index is stored as free-to-use.
-            empty_indices.push(index);
+            // Ensure this object index is stored as free-to-use (or retired, if it's out of generations).
+            release_slot(index);
 
-            // Object removal is as simple as setting the entry pointer to null - this will allow it to be overwritten
-            // when needed (as long as no-one has saved a pointer to the object instead of using an ID, which is not
-            // what should be happening).
+            // The object is destroyed straight away (freeing anything it owns), and the entry pointer is set to null
+            // so the slot can be reused. Anyone who saved a pointer to the object instead of using an ID will be left
+            // with a dangling pointer, which is not what should be happening.
+            std::destroy_at(entry.value);
             entry.value = nullptr;
+            CYAN_ECS_COUNT(counters.n_removes);
+        }
+
+        /**
+         * Reserve memory for a total of n objects, so adding up to that many doesn't allocate.
+         */
+        void reserve(std::size_t n) {
+            if (n > entries.capacity()) grow_entries(n);
+            reserve_pages((n + OBJECTS_PER_PAGE - 1) / OBJECTS_PER_PAGE);
+        }
+
+        /**
+         * Remove every object. Slots are kept (with their generations), so the IDs of removed objects remain invalid.
+         */
+        void clear() {
+            for (std::size_t index = 0; index < entries.size(); index += 1) {
+                if (!entries[index].value) continue;
+                std::destroy_at(entries[index].value);
+                entries[index].value = nullptr;
+                release_slot(index);
+                CYAN_ECS_COUNT(counters.n_removes);
+            }
+        }
+
+        /**
+         * Release pages which hold no live objects, and spare capacity in the slot table. The slot table itself is kept
+         * (it's needed to keep the IDs of removed objects invalid), and released pages are allocated again if their
+         * slots are reused.
+         */
+        void shrink_to_fit() {
+            for (std::size_t page = 0; page < pages.size(); page += 1) {
+                if (!pages[page]) continue;
+                auto first = page * OBJECTS_PER_PAGE;
+                auto last = std::min(first + OBJECTS_PER_PAGE, entries.size());
+                bool used = false;
+                for (auto index = first; index < last && !used; index += 1) {
+                    used = entries[index].value != nullptr;
+                }
+                if (!used) pages[page].reset();
+            }
+            entries.shrink_to_fit();
+            pages.shrink_to_fit();
+        }
+
+        /**
+         * Get the (approximate) number of bytes allocated by the registry, including unused capacity.
+         */
+        [[nodiscard]]
+        std::size_t memory_bytes() const {
+            std::size_t n_pages = 0;
+            for (auto& page : pages) {
+                if (page) n_pages += 1;
+            }
+            return n_pages * OBJECTS_PER_PAGE * sizeof(Slot)
+                   + pages.capacity() * sizeof(std::unique_ptr<Slot[]>)
+                   + entries.capacity() * sizeof(Entry)
+                   + empty_indices.size() * sizeof(EcsIndexT);
         }
 
         /**
@@ -161,14 +316,211 @@ namespace cyan::ecs_impl {
          */
         [[nodiscard]]
         std::size_t size() const {
-            CYAN_ASSERT(entries.size() == object_array.size());
-            return entries.size() - empty_indices.size();
+            return entries.size() - empty_indices.size() - n_retired;
+        }
+
+        /**
+         * Get the registry's operation counters (all zero unless ECS_STATS_ENABLED, see ecs_stats.hpp).
+         */
+        [[nodiscard]]
+        ObjectRegistryStats get_stats() const {
+#if CYAN_ECS_STATS
+            return counters.get();
+#else
+            return ObjectRegistryStats{};
+#endif
+        }
+
+        /**
+         * Call a function on each live object, in index order. Removed slots are skipped.
+         * @param fn A function taking (EcsIdT id, T& object).
+         */
+        template <typename Fn>
+        void for_each(Fn&& fn) {
+            for_each_in_range(0, entries.size(), fn);
+        }
+
+        /**
+         * Get the number of slots (both live and removed), which is the end of the range of indices accepted by
+         * for_each_in_range().
+         */
+        [[nodiscard]]
+        std::size_t slot_count() const {
+            return entries.size();
+        }
+
+        /**
+         * Get the ID held by a slot, whether or not the slot holds a live object.
+         * @param index A slot index in [0, slot_count()).
+         */
+        [[nodiscard]]
+        EcsIdT slot_id(std::size_t index) const {
+            return entries[index].id;
+        }
+
+        /**
+         * Check whether a slot holds a live object.
+         * @param index A slot index in [0, slot_count()).
+         */
+        [[nodiscard]]
+        bool slot_is_live(std::size_t index) const {
+            return entries[index].value != nullptr;
+        }
+
+        /**
+         * Get the indices of the slots waiting to be reused, in the order they'll be reused.
+         */
+        [[nodiscard]]
+        std::vector<EcsIndexT> free_slots() const {
+            std::vector<EcsIndexT> indices;
+            indices.reserve(empty_indices.size());
+            auto queue = empty_indices;
+            while (!queue.empty()) {
+                indices.push_back(queue.front());
+                queue.pop();
+            }
+            return indices;
+        }
+
+        /**
+         * Replace the contents of the registry with a given set of slots, e.g. as saved in a snapshot. Each live slot
+         * is given a default-constructed object, and slots which are neither live nor free are retired.
+         * The slots are checked before anything is replaced, as they may come from a corrupt file: each free slot must
+         * be in range, not live, and listed once (otherwise later additions could share a slot).
+         * @throws cyan::Error if the slots are inconsistent, leaving the registry unchanged.
+         * @param ids The ID of each slot (see slot_id()). The index of slot i's ID must be i.
+         * @param live Whether each slot is live (see slot_is_live()), one byte per slot.
+         * @param n_slots The number of slots.
+         * @param free The indices of the free slots, in the order they'll be reused (see free_slots()).
+         * @param n_free The number of free slots.
+         */
+        void restore_slots(const EcsIdT* ids, const std::uint8_t* live, std::size_t n_slots,
+                           const EcsIndexT* free, std::size_t n_free) {
+            for (std::size_t index = 0; index < n_slots; index += 1) {
+                if (get_index(ids[index]) != index) {
+                    throw cyan::Error("Can't restore slot {} of an ObjectRegistry from ID {}, which has index {}",
+                                      index, ids[index], get_index(ids[index]));
+                }
+            }
+            std::vector<bool> is_free(n_slots, false);
+            for (std::size_t i = 0; i < n_free; i += 1) {
+                if (free[i] >= n_slots || live[free[i]]) {
+                    throw cyan::Error("Can't restore an ObjectRegistry with {} slots and free slot {}", n_slots,
+                                      free[i]);
+                }
+                if (is_free[free[i]]) {
+                    throw cyan::Error("Can't restore an ObjectRegistry with free slot {} listed more than once",
+                                      free[i]);
+                }
+                is_free[free[i]] = true;
+            }
+
+            *this = ObjectRegistry();
+            reserve(n_slots);
+            std::size_t n_live = 0;
+            for (std::size_t index = 0; index < n_slots; index += 1) {
+                T* object = live[index] ? construct_in_slot(index) : nullptr;
+                entries.push_back({ids[index], object});
+                if (object) n_live += 1;
+            }
+            for (std::size_t i = 0; i < n_free; i += 1) {
+                empty_indices.push(free[i]);
+            }
+            // Free slots are unique and not live, so there are at most n_slots live and free slots together.
+            n_retired = n_slots - n_live - n_free;
+        }
+
+        /**
+         * Call a function on each live object with an index in [first, last). Removed slots are skipped. Ranges are
+         * used to split iteration into independent pieces (e.g. to be run in parallel).
+         * @param fn A function taking (EcsIdT id, T& object).
+         */
+        template <typename Fn>
+        void for_each_in_range(std::size_t first, std::size_t last, Fn&& fn) {
+            for (std::size_t index = first; index < last; index += 1) {
+                if (entries[index].value == nullptr) continue;
+                fn(entries[index].id, *entries[index].value);
+            }
         }
 
     private:
+        /// Raw, suitably aligned storage for a single object. Objects are constructed in and destroyed from slots
+        /// explicitly, so a slot only holds a live object while it's entry's value pointer is non-null.
+        struct Slot {
+            alignas(T) unsigned char bytes[sizeof(T)];
+        };
+
+        /**
+         * Internal function to get the number of objects per page: the largest power of two whose objects fit in
+         * ECS_OBJECT_PAGE_BYTES (or 1, for objects larger than a page), so slot lookup is a shift and a mask.
+         */
+        static constexpr std::size_t objects_per_page() {
+            std::size_t count = 1;
+            while (count * 2 * sizeof(Slot) <= ECS_OBJECT_PAGE_BYTES) {
+                count *= 2;
+            }
+            return count;
+        }
+
+        static constexpr std::size_t OBJECTS_PER_PAGE = objects_per_page();
+        /// The smallest capacity the slot table grows to.
+        static constexpr std::size_t MIN_ENTRY_CAPACITY = 16;
+
         std::vector<Entry> entries{};
-        std::vector<T> object_array;
         std::queue<EcsIndexT> empty_indices;
+        /// The number of slots which have run out of generations and are never reused.
+        std::size_t n_retired = 0;
+        /// Pages of OBJECTS_PER_PAGE slots. Slot i is slot (i % OBJECTS_PER_PAGE) of page (i / OBJECTS_PER_PAGE).
+        std::vector<std::unique_ptr<Slot[]>> pages;
+#if CYAN_ECS_STATS
+        ObjectRegistryCounters counters;
+#endif
+
+        /**
+         * Internal function to reallocate the slot table with room for n entries.
+         */
+        void grow_entries(std::size_t n) {
+            entries.reserve(n);
+            CYAN_ECS_COUNT(counters.n_reallocations);
+        }
+
+        /**
+         * Internal function to make a slot available for reuse once it's object has been destroyed. Slots at the last
+         * generation are retired instead, since giving them a new generation would wrap around to IDs already used.
+         */
+        void release_slot(EcsIndexT index) {
+            if (get_generation(entries[index].id) >= ECS_MAX_GENERATION) {
+                n_retired += 1;
+            } else {
+                empty_indices.push(index);
+            }
+        }
+
+        /**
+         * Internal function to construct an object in a slot, which must not hold a live object.
+         * Aggregates are constructed with braces, so e.g. emplace(1, 2) works for `struct Point { int x, y; }`.
+         */
+        template <typename ...Args>
+        T* construct_in_slot(std::size_t index, Args&&... args) {
+            auto& page = pages[index / OBJECTS_PER_PAGE];
+            // Pages released by shrink_to_fit() are allocated again when one of their slots is reused.
+            if (!page) page.reset(new Slot[OBJECTS_PER_PAGE]);
+            void* slot = page[index % OBJECTS_PER_PAGE].bytes;
+            if constexpr (std::is_constructible_v<T, Args&&...>) {
+                return new (slot) T(std::forward<Args>(args)...);
+            } else {
+                return new (slot) T{std::forward<Args>(args)...};
+            }
+        }
+
+        /**
+         * Internal function to allocate pages until there are at least n_pages.
+         */
+        void reserve_pages(std::size_t n_pages) {
+            while (pages.size() < n_pages) {
+                pages.push_back(std::unique_ptr<Slot[]>(new Slot[OBJECTS_PER_PAGE]));
+            }
+        }
 
         /**
          * Internal function to make a null entry.
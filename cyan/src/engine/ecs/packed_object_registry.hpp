@@ -0,0 +1,365 @@
+#pragma once
+
+#include "cyan/src/engine/ecs/ecs_common.hpp"
+#include "cyan/src/engine/ecs/ecs_stats.hpp"
+#include "cyan/src/logging/assert.hpp"
+#include "cyan/src/logging/error.hpp"
+
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cyan::ecs_impl {
+    /** PackedObjectRegistry
+     * A variant of ObjectRegistry that keeps it's live objects densely packed: the objects always occupy positions
+     * [0, size()) of the internal object array, so iterating over them never has to skip dead slots.
+     * Removal moves the last object into the removed object's position (swap-and-pop). Because objects move, IDs don't
+     * refer to object positions directly - they refer to a slot in an indirection table, which holds the current
+     * position of the object. Slots (and thus IDs) are reused with the same generation scheme as ObjectRegistry, so
+     * IDs stay stable for the lifetime of the object and stale IDs are rejected, and slots which run out of
+     * generations are retired in the same way.
+     * The same caveats as ObjectRegistry apply to Entries: save the ID, not the entry. Note that any remove() can move
+     * an object, so entry pointers are invalidated by removal as well as addition.
+     * @tparam T The type of object to be stored.
+     */
+    template <typename T>
+    struct PackedObjectRegistry {
+        /**
+         * PackedObjectRegistry<T>::Entry objects are used to refer to values within the array.
+         * These act as a pointer to the value, as well as holding whether the value is active.
+         */
+        struct Entry {
+            EcsIndexT id = ECS_NULL_INDEX;
+            T* value;
+
+            /// operator* and operator-> overloads to allow this object to be used as if it's a pointer.
+            T& operator*() { return *value; }
+            const T& operator*() const { return *value; }
+            T* operator->() { return value; }
+            const T* operator->() const { return value; }
+
+            /// Boolean conversion to check if the entry is valid.
+            explicit operator bool() { return value != nullptr; }
+        };
+
+        /**
+         * Add a copy of an object to the array and return a reference entry.
+         * @param object The object to make a copy of.
+         * @return An entry which can be used to retrieve the value.
+         */
+        Entry add(const T& object) {
+            return emplace(object);
+        }
+
+        /**
+         * Move an object into the array and return a reference entry.
+         * @param object The object to move from.
+         * @return An entry which can be used to retrieve the value.
+         */
+        Entry add(T&& object) {
+            return emplace(std::move(object));
+        }
+
+        /**
+         * Create an object in-place and return a reference entry.
+         * Aggregates are constructed with braces, so e.g. emplace(1, 2) works for `struct Point { int x, y; }`.
+         * @tparam Args The types to construct the object from.
+         * @param args The values to construct the object from.
+         * @return An entry which can be used to retrieve the value.
+         */
+        template <typename ...Args>
+        Entry emplace(Args&&... args) {
+            // Construct the object before claiming a slot, so a throwing constructor leaves the registry unchanged.
+            bool reallocates = object_array.size() == object_array.capacity();
+            if constexpr (std::is_constructible_v<T, Args&&...>) {
+                object_array.emplace_back(std::forward<Args>(args)...);
+            } else {
+                object_array.push_back(T{std::forward<Args>(args)...});
+            }
+            EcsIdT id;
+            try {
+                id = claim_slot();
+            } catch (...) {
+                object_array.pop_back();
+                throw;
+            }
+            CYAN_ECS_COUNT(counters.n_adds);
+            if (reallocates) CYAN_ECS_COUNT(counters.n_reallocations);
+            return Entry{id, &object_array.back()};
+        }
+
+        /**
+         * Add copies of an array of trivially copyable objects, e.g. straight out of a memory-mapped snapshot. The
+         * objects are appended to the packed array in one copy, and given new slots regardless of any free slots.
+         * @param objects The objects to copy.
+         * @param n The number of objects.
+         * @return The index of the first object's slot. Object i has the ID make_ecs_id(0, index + i).
+         */
+        EcsIndexT add_copies(const T* objects, std::size_t n) {
+            static_assert(std::is_trivially_copyable_v<T>, "add_copies() needs a trivially copyable type");
+            auto first = slots.size();
+            if (first + n > ECS_MAX_SLOTS) {
+                throw cyan::Error("PackedObjectRegistry is full: all {} slots are in use or retired", ECS_MAX_SLOTS);
+            }
+            auto position = object_array.size();
+            if (position + n > object_array.capacity()) CYAN_ECS_COUNT(counters.n_reallocations);
+            CYAN_ECS_COUNT_N(counters.n_adds, n);
+            object_array.insert(object_array.end(), objects, objects + n);
+            slots.reserve(first + n);
+            position_slots.reserve(position + n);
+            for (std::size_t i = 0; i < n; i += 1) {
+                slots.push_back({make_ecs_id(0, static_cast<EcsIndexT>(first + i)),
+                                 static_cast<EcsIndexT>(position + i)});
+                position_slots.push_back(static_cast<EcsIndexT>(first + i));
+            }
+            return first;
+        }
+
+        /**
+         * Look up an entry from an ID.
+         * @param id The id of the object.
+         * @return An entry for the object, or a null entry if no object with the given ID exists.
+         */
+        Entry get(EcsIndexT id) {
+            auto index = get_index(id);
+            CYAN_ECS_COUNT(counters.n_gets);
+            if (index >= slots.size()) {
+                CYAN_ECS_COUNT(counters.n_misses);
+                return make_null_entry();
+            }
+
+            Slot& slot = slots[index];
+            if (slot.position == ECS_NULL_INDEX || slot.id != id) {
+                CYAN_ECS_COUNT(counters.n_misses);
+                if (slot.position != ECS_NULL_INDEX) CYAN_ECS_COUNT(counters.n_generation_rejects);
+                return make_null_entry();
+            }
+
+            return Entry{id, &object_array[slot.position]};
+        }
+
+        /**
+         * Look up the object in a slot by it's index alone (see ObjectRegistry::get_in_slot()).
+         * @param index The index of the slot. Unlike ObjectRegistry, this is independent of the object's position.
+         * @return The object, or nullptr if the slot is empty or out of range.
+         */
+        T* get_in_slot(EcsIndexT index) {
+            if (index >= slots.size() || slots[index].position == ECS_NULL_INDEX) return nullptr;
+            return &object_array[slots[index].position];
+        }
+
+        /**
+         * Prefetch the slot of an ID, ahead of a get() of it. Does nothing if the ID's index is out of range.
+         * @param id The ID which will be looked up.
+         */
+        void prefetch(EcsIndexT id) const {
+            auto index = get_index(id);
+            if (index < slots.size()) ecs_impl::prefetch(&slots[index]);
+        }
+
+        /**
+         * Remove an object from the array. The last object in the array is moved into the removed object's position.
+         * @param id The id of the object to remove.
+         */
+        void remove(EcsIndexT id) {
+            auto index = get_index(id);
+            if (index >= slots.size()) return;
+
+            Slot& slot = slots[index];
+            if (slot.position == ECS_NULL_INDEX || slot.id != id) {
+                return;
+            }
+
+            auto position = slot.position;
+            auto last_position = object_array.size() - 1;
+            if (position != last_position) {
+                object_array[position] = std::move(object_array[last_position]);
+                position_slots[position] = position_slots[last_position];
+                slots[position_slots[position]].position = position;
+            }
+            object_array.pop_back();
+            position_slots.pop_back();
+
+            slot.position = ECS_NULL_INDEX;
+            release_slot(index);
+            CYAN_ECS_COUNT(counters.n_removes);
+        }
+
+        /**
+         * Reserve memory for a total of n objects, so adding up to that many doesn't reallocate.
+         */
+        void reserve(std::size_t n) {
+            if (n > object_array.capacity()) CYAN_ECS_COUNT(counters.n_reallocations);
+            object_array.reserve(n);
+            position_slots.reserve(n);
+            slots.reserve(n);
+        }
+
+        /**
+         * Remove every object. The slots are kept, so the IDs of removed objects remain invalid.
+         */
+        void clear() {
+            CYAN_ECS_COUNT_N(counters.n_removes, position_slots.size());
+            for (auto index : position_slots) {
+                slots[index].position = ECS_NULL_INDEX;
+                release_slot(index);
+            }
+            object_array.clear();
+            position_slots.clear();
+        }
+
+        /**
+         * Release spare capacity in the packed arrays. The slot table is kept (it's needed to keep the IDs of removed
+         * objects invalid).
+         */
+        void shrink_to_fit() {
+            object_array.shrink_to_fit();
+            position_slots.shrink_to_fit();
+        }
+
+        /**
+         * Get the (approximate) number of bytes allocated by the registry, including unused capacity.
+         */
+        [[nodiscard]]
+        std::size_t memory_bytes() const {
+            return object_array.capacity() * sizeof(T)
+                   + position_slots.capacity() * sizeof(EcsIndexT)
+                   + slots.capacity() * sizeof(Slot)
+                   + empty_indices.size() * sizeof(EcsIndexT);
+        }
+
+        /**
+         * Get the number of currently active elements in the registry.
+         */
+        [[nodiscard]]
+        std::size_t size() const {
+            CYAN_ASSERT(object_array.size() == position_slots.size());
+            return object_array.size();
+        }
+
+        /**
+         * Get the ID of the object at a given position in the packed array.
+         * @param position A position in the range [0, size()).
+         */
+        [[nodiscard]]
+        EcsIdT id_at(std::size_t position) const {
+            return slots[position_slots[position]].id;
+        }
+
+        /**
+         * Get the registry's operation counters (all zero unless ECS_STATS_ENABLED, see ecs_stats.hpp). Reallocations
+         * count growth of the packed object array.
+         */
+        [[nodiscard]]
+        ObjectRegistryStats get_stats() const {
+#if CYAN_ECS_STATS
+            return counters.get();
+#else
+            return ObjectRegistryStats{};
+#endif
+        }
+
+        /// Iteration over the (packed) live objects.
+        T* begin() { return object_array.data(); }
+        T* end() { return object_array.data() + object_array.size(); }
+        const T* begin() const { return object_array.data(); }
+        const T* end() const { return object_array.data() + object_array.size(); }
+
+        /**
+         * Call a function on each live object.
+         * @param fn A function taking (EcsIdT id, T& object).
+         */
+        template <typename Fn>
+        void for_each(Fn&& fn) {
+            for_each_in_range(0, object_array.size(), fn);
+        }
+
+        /**
+         * Get the end of the range of positions accepted by for_each_in_range(). For a packed registry, this is size().
+         */
+        [[nodiscard]]
+        std::size_t slot_count() const {
+            return object_array.size();
+        }
+
+        /**
+         * Call a function on each object at a position in [first, last). Ranges are used to split iteration into
+         * independent pieces (e.g. to be run in parallel).
+         * @param fn A function taking (EcsIdT id, T& object).
+         */
+        template <typename Fn>
+        void for_each_in_range(std::size_t first, std::size_t last, Fn&& fn) {
+            for (std::size_t position = first; position < last; position += 1) {
+                fn(id_at(position), object_array[position]);
+            }
+        }
+
+    private:
+        /// Indirection table entry: the current ID assigned to a slot, and the object's position in object_array.
+        struct Slot {
+            EcsIdT id;
+            EcsIndexT position;
+        };
+
+        std::vector<Slot> slots;
+        std::vector<EcsIndexT> position_slots;
+        std::vector<T> object_array;
+        std::queue<EcsIndexT> empty_indices;
+#if CYAN_ECS_STATS
+        ObjectRegistryCounters counters;
+#endif
+
+        /**
+         * Internal function to claim a slot for the object which was just appended to object_array. If this throws, the
+         * slots are left unchanged.
+         * @return The ID of the claimed slot.
+         */
+        EcsIdT claim_slot() {
+            EcsIndexT position = object_array.size() - 1;
+            EcsIndexT index;
+            if (!empty_indices.empty()) {
+                // If we have empty indices, use those first.
+                index = empty_indices.front();
+                CYAN_ASSERT(slots[index].position == ECS_NULL_INDEX);
+                position_slots.push_back(index);
+                empty_indices.pop();
+                CYAN_ECS_COUNT(counters.n_slot_reuses);
+                slots[index].id = make_ecs_id(get_generation(slots[index].id) + 1, index);
+            } else {
+                // Otherwise, we allocate a new slot.
+                index = slots.size();
+                if (index >= ECS_MAX_SLOTS) {
+                    throw cyan::Error("PackedObjectRegistry is full: all {} slots are in use or retired",
+                                      ECS_MAX_SLOTS);
+                }
+                position_slots.push_back(index);
+                try {
+                    slots.push_back({make_ecs_id(0, index), ECS_NULL_INDEX});
+                } catch (...) {
+                    position_slots.pop_back();
+                    throw;
+                }
+            }
+            slots[index].position = position;
+            return slots[index].id;
+        }
+
+        /**
+         * Internal function to make a slot available for reuse once it's object has been removed. Slots at the last
+         * generation are retired instead (see ObjectRegistry).
+         */
+        void release_slot(EcsIndexT index) {
+            if (get_generation(slots[index].id) < ECS_MAX_GENERATION) {
+                empty_indices.push(index);
+            }
+        }
+
+        /**
+         * Internal function to make a null entry.
+         */
+        Entry make_null_entry() const {
+            return Entry{ECS_NULL_INDEX, nullptr};
+        }
+    };
+}
@@ -0,0 +1,20 @@
+#include "published_ecs.hpp"
+
+
+std::uint64_t cyan::PublishedEcs::get_version() const
+{
+    return version;
+}
+
+
+cyan::EcsTickT cyan::PublishedEcs::get_tick() const
+{
+    return tick;
+}
+
+
+bool cyan::PublishedEcs::exists(cyan::Entity e) const
+{
+    auto index = ecs_impl::get_index(e.id);
+    return entity_ids && index < entity_ids->size() && (*entity_ids)[index] == e.id;
+}
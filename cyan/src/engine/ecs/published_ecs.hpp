@@ -0,0 +1,97 @@
+#pragma once
+
+#include "ecs_common.hpp"
+#include "entity.hpp"
+#include "component_map.hpp"
+#include "single_component_registry.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cyan {
+    /** PublishedEcs
+     * An immutable, versioned copy of the entities and components of an ECS, made by ECS::publish() at the end of a
+     * tick. It's safe to read from any number of threads without locking while the ECS moves on to the next tick, e.g.
+     * to build render lists or run AI queries on other threads.
+     * Component registries are copied at registry granularity, and only when they've changed since the last
+     * publish(), so consecutive versions share the copies of registries which didn't change. A version stays valid
+     * for as long as a reader holds it (even after the ECS is destroyed), and is released once the last reader drops
+     * it.
+     * Components of deleted entities (which the ECS hasn't collected yet) are never visited.
+     */
+    struct PublishedEcs {
+        /**
+         * Get the version, which starts at 1 and increases by 1 with every ECS::publish().
+         */
+        [[nodiscard]]
+        std::uint64_t get_version() const;
+
+        /**
+         * Get the tick of the ECS when it was published (see ECS::current_tick()).
+         */
+        [[nodiscard]]
+        EcsTickT get_tick() const;
+
+        /**
+         * Check whether an entity existed when the ECS was published.
+         */
+        [[nodiscard]]
+        bool exists(Entity e) const;
+
+        /**
+         * Get the published registry of a component type.
+         * @return The registry, or nullptr if the ECS had no registry for T (or T can't be copied).
+         */
+        template <typename T>
+        const SingleComponentRegistry<T>* get_component_registry() const {
+            auto position = ecs_impl::ComponentMap::get_registry_position<T>();
+            if (position >= registries.size()) return nullptr;
+            return static_cast<const SingleComponentRegistry<T>*>(registries[position].get());
+        }
+
+        /**
+         * Get an entity's component of type T.
+         * @return The component, or nullptr if the entity didn't exist or had no such component.
+         */
+        template <typename T>
+        const T* find_component(Entity e) const {
+            auto registry = get_component_registry<T>();
+            if (!registry || !exists(e)) return nullptr;
+            return registry->find(e);
+        }
+
+        /**
+         * Check whether an entity had a component of type T.
+         */
+        template <typename T>
+        bool has_component(Entity e) const {
+            return find_component<T>(e) != nullptr;
+        }
+
+        /**
+         * Call a function on every component of type T (and it's entity).
+         * @param fn A function taking (Entity, const T&).
+         */
+        template <typename T, typename Fn>
+        void each(Fn&& fn) const {
+            auto registry = get_component_registry<T>();
+            if (!registry) return;
+            registry->for_each_in_range(0, registry->slot_count(), [&](Entity e, const T& component) {
+                if (exists(e)) fn(e, component);
+            });
+        }
+
+    private:
+        friend struct ECS;
+
+        std::uint64_t version = 0;
+        EcsTickT tick = 0;
+        /// The ID in each entity slot, or ECS_NULL_INDEX for slots which weren't live. This is shared between versions
+        /// until entities are created or deleted.
+        std::shared_ptr<const std::vector<EcsIdT>> entity_ids;
+        /// The published registries, indexed by registry position (see ComponentMap::registry_position_count()).
+        std::vector<std::shared_ptr<const IComponentRegistry>> registries;
+    };
+}
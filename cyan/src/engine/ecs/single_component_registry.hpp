@@ -1,38 +1,80 @@
 #pragma once
 
 #include "entity.hpp"
+#include "component_registry_interface.hpp"
 #include "cyan/src/logging/assert.hpp"
 #include "cyan/src/engine/ecs/object_registry.hpp"
+#include "cyan/src/engine/ecs/packed_object_registry.hpp"
+#include "cyan/src/engine/ecs/slot_ticks.hpp"
+#include "cyan/src/engine/ecs/sparse_set.hpp"
 #include "cyan/src/logging/logger.hpp"
 #include "cyan/src/logging/error.hpp"
 
-#include <queue>
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace cyan {
+    /**
+     * Selects the registry used to store the components of type T.
+     * By default components are stored in an ObjectRegistry, where a component never moves until it's removed.
+     * Component types that are frequently created and destroyed and mostly iterated over can instead be stored densely
+     * packed (at the cost of components moving when others are removed) by specializing this for the type, e.g.
+     *      template <>
+     *      struct cyan::ComponentStorage<Particle> { using type = ecs_impl::PackedObjectRegistry<Particle>; };
+     * The specialization must be visible wherever the component type is used with the ECS.
+     * @tparam T The component type.
+     */
+    template <typename T>
+    struct ComponentStorage {
+        using type = ecs_impl::ObjectRegistry<T>;
+    };
+
     /** SingleComponentRegistry
      * Provides a wrapper over an ObjectRegistry with the addition of an entity-to-component ID mapping (and also in
-     * reverse).
+     * reverse). The entity-to-component mapping is a sparse set over entity indices, so looking up a component by
+     * entity never hashes.
+     * Registries can also be used without knowing T via IComponentRegistry.
+     * Each component slot records the tick (see set_tick()) at which it's component was added and last changed, along
+     * with a log of the slots stamped in each tick (see ecs_impl::SlotTicks), so systems can visit only the components
+     * which changed since they last ran (see changed_since()). Components are marked as changed by mutable access
+     * through an Entry, by find_for_write(), and by modify_each_in_range().
+     * Observers can be added for components being added, removed or changed (see observe()). Rather than calling
+     * observers as things happen, the events are recorded (only for kinds of event with an observer), and dispatched
+     * in batches by flush_events().
+     * An immutable copy of the registry can be made for readers on other threads (see publish()).
      * @tparam T The type of the component to wrap.
      */
     template <typename T>
-    struct SingleComponentRegistry {
+    struct SingleComponentRegistry final: public IComponentRegistry {
         /// Handle on an ID for cleaner code.
         struct Id { EcsIndexT id = ECS_NULL_INDEX; };
 
+        /// The registry type the components are stored in (see ComponentStorage).
+        using StorageT = typename ComponentStorage<T>::type;
+
         /**
          * ComponentArray<T>::Entry objects are used to refer to component values.
          * These act as a pointer to the value.
+         * Mutable access (non-const operator* or get()) marks the component as changed. Writing through `value`
+         * directly doesn't, so use read() (or a const Entry) for access that only reads.
          * Should **not** be stored as a handle to the component (use an ID for that).
          */
         struct Entry {
             Entity entity;
             Id id;
             T* value;
+            /// The registry holding the component, which records changes (null for components without a registry).
+            SingleComponentRegistry<T>* registry = nullptr;
 
             /// operator* overloads to allow this object to be used as if it's a pointer.
-            T& operator*() { return *value; }
+            T& operator*() { mark_changed(); return *value; }
             const T& operator*() const { return *value; }
 
             /// Boolean conversion to check if the entry is valid.
@@ -40,33 +82,51 @@ namespace cyan {
 
             /// get() allows easy unwrapping of the underlying component.
             T& get() {
+                if (!value) throw cyan::Error("Attempt to unwrap invalid component");
+                mark_changed();
+                return *value;
+            }
+
+            /// read() unwraps the underlying component without marking it as changed.
+            const T& read() const {
                 if (!value) throw cyan::Error("Attempt to unwrap invalid component");
                 return *value;
             }
 
         private:
             /// Constructor to move an underlying ObjectRegistry entry into this entry.
-            static Entry make_from_object_registry_entry(Entity e, typename ecs_impl::ObjectRegistry<T>::Entry entry)
+            static Entry make_from_object_registry_entry(SingleComponentRegistry<T>* registry, Entity e,
+                                                         typename StorageT::Entry entry)
             {
-                return Entry{e, Id{entry.id}, entry.value};
+                return Entry{e, Id{entry.id}, entry.value, registry};
+            }
+
+            void mark_changed() {
+                if (registry) registry->mark_changed(id);
             }
 
             friend SingleComponentRegistry<T>;
         };
 
+        SingleComponentRegistry() = default;
+
+        // Registries are only copied by publish(), so the copy constructor is private.
+        SingleComponentRegistry& operator=(const SingleComponentRegistry&) = delete;
+
         /**
          * Set the component type name, used for debugging purposes.
          * @param name The name to be assigned to the component type.
          */
         void set_component_type_name(const std::string& name) {
             this->component_type_name = name;
+            mark_unpublished();
         }
 
         /**
          * Get the name of the component. Useful for debugging purposes.
          * @return A std::string of the name that has been assigned to this component type.
          */
-        std::string get_component_type_name() {
+        std::string get_component_type_name() override {
             return component_type_name;
         }
 
@@ -76,8 +136,7 @@ namespace cyan {
          * @return An entry which can be used to retrieve the value.
          */
         Entry add(Entity e, const T& object) {
-            auto entity_component_iter = entity_component_map.find(e.id);
-            if (entity_component_iter != entity_component_map.end()) {
+            if (auto existing_component_id = entity_components.find(e.id)) {
                 LOG(WARN, "Attempted to add a component of type \"{}\" to entity {}, but that component "
                           "already has an existing component of this type. The provided component will be discarded.",
                     component_type_name, e.id);
@@ -86,15 +145,23 @@ namespace cyan {
                 //       type should throw an error, and this may be a good idea in non-release builds. This is a
                 //       non-fatal error though, so in release we want the engine to keep running wherever possible
                 //       rather than failing outright.
-                return get(Id{entity_component_iter->second});
+                return get(Id{*existing_component_id});
             }
+            if (!make_room_for_entity(e)) return make_null_entry();
 
             auto component_entry = components.add(object);
+            link_component(e, component_entry.id);
 
-            entity_component_map.insert({e.id, component_entry.id});
-            component_entity_map.insert({component_entry.id, e.id});
+            return Entry::make_from_object_registry_entry(this, e, component_entry);
+        }
 
-            return Entry::make_from_object_registry_entry(e, component_entry);
+        /**
+         * Move an object into the array and return a reference entry.
+         * @param object The object to move from.
+         * @return An entry which can be used to retrieve the value.
+         */
+        Entry add(Entity e, T&& object) {
+            return emplace(e, std::move(object));
         }
 
         /**
@@ -104,22 +171,20 @@ namespace cyan {
          * @return An entry which can be used to retrieve the value.
          */
         template <typename ...Args>
-        Entry emplace(Entity e, Args... args) {
-            auto entity_component_iter = entity_component_map.find(e.id);
-            if (entity_component_iter != entity_component_map.end()) {
+        Entry emplace(Entity e, Args&&... args) {
+            if (auto existing_component_id = entity_components.find(e.id)) {
                 LOG(WARN, "Attempted to emplace a component of type \"{}\" to entity {}, but that component "
                           "already has an existing component of this type. The provided component will be discarded.",
                     component_type_name, e.id);
                 // We return the existing component.
-                return get(Id{entity_component_iter->second});
+                return get(Id{*existing_component_id});
             }
+            if (!make_room_for_entity(e)) return make_null_entry();
 
-            auto component_entry = components.emplace(std::forward(args...));
-
-            entity_component_map.insert({e.id, component_entry.id});
-            component_entity_map.insert({component_entry.id, e.id});
+            auto component_entry = components.emplace(std::forward<Args>(args)...);
+            link_component(e, component_entry.id);
 
-            return Entry::make_from_object_registry_entry(e, component_entry);
+            return Entry::make_from_object_registry_entry(this, e, component_entry);
         }
 
         /**
@@ -128,10 +193,269 @@ namespace cyan {
          * @return An entry corresponding with the component associated with the provided entity
          */
         Entry get(Entity e) {
-            auto entity_component_iter = entity_component_map.find(e.id);
-            if (entity_component_iter == entity_component_map.end()) return make_null_entry();
-            auto id = entity_component_iter->second;
-            return get(Id{id});
+            auto component_id = find_component_id(e);
+            if (!component_id) return make_null_entry();
+            auto component_entry = components.get(*component_id);
+            if (!component_entry) return make_null_entry();
+            return Entry::make_from_object_registry_entry(this, e, component_entry);
+        }
+
+        /**
+         * Look up a component from an Entity ID without constructing an Entry.
+         * This is the cheapest way to probe a registry for an entity.
+         * @param e The entity to look up.
+         * @return A pointer to the entity's component, or nullptr if it has no component in this registry.
+         */
+        T* find(Entity e) {
+            auto component_id = find_component_id(e);
+            if (!component_id) return nullptr;
+            return components.get(*component_id).value;
+        }
+        const T* find(Entity e) const {
+            // Looking a component up doesn't modify the registry.
+            return const_cast<SingleComponentRegistry*>(this)->find(e);
+        }
+
+        /**
+         * Look up a component as find() does, also giving the index of it's slot, so the component can be marked as
+         * changed later (see mark_changed_in_slot()) without being looked up again.
+         * @param e The entity to look up.
+         * @param slot Set to the index of the component's slot, if it's found.
+         * @return A pointer to the entity's component, or nullptr if it has no component in this registry.
+         */
+        T* find(Entity e, EcsIndexT& slot) {
+            auto component_id = find_component_id(e);
+            if (!component_id) return nullptr;
+            slot = ecs_impl::get_index(*component_id);
+            return components.get(*component_id).value;
+        }
+
+        /// The number of steps a prefetched lookup is split into: those of prefetch_lookup(), then resolve_lookup().
+        static constexpr int LOOKUP_PREFETCH_STEPS = 3;
+
+        /**
+         * Prefetch the memory the lookup of an entity's component will read. A lookup is a chain of dependent loads
+         * (the entity's sparse slot, then it's component ID, then the component's storage slot), so it's split into
+         * steps which each read what the step before prefetched: the steps of this function, then resolve_lookup(),
+         * then find_resolved(). The component itself isn't prefetched, as the caller may not read it until much later.
+         * Each step should be taken for an entity a few lookups after the step before it (see ECS::get_components()).
+         * @param e The entity which will be looked up.
+         * @param step The step, from 0 to LOOKUP_PREFETCH_STEPS - 2.
+         */
+        void prefetch_lookup(Entity e, int step) const {
+            if (step == 0) {
+                entity_components.prefetch(e.id);
+            } else {
+                entity_components.prefetch_value(e.id);
+            }
+        }
+
+        /**
+         * Take the last prefetch step of a lookup (see prefetch_lookup()): find the entity's component ID, whose loads
+         * the earlier steps prefetched, and prefetch it's storage slot. The lookup is finished by passing the ID to
+         * find_resolved() a few lookups later, so the chain is only walked once. The ID is only valid until components
+         * are next added or removed.
+         * @param e The entity to look up.
+         * @return The ID of the entity's component, or ECS_NULL_INDEX if it has none.
+         */
+        EcsIdT resolve_lookup(Entity e) const {
+            auto component_id = entity_components.find(e.id);
+            if (!component_id) return ECS_NULL_INDEX;
+            components.prefetch(*component_id);
+            return *component_id;
+        }
+
+        /**
+         * Finish a lookup started with resolve_lookup().
+         * @param component_id The ID resolve_lookup() gave.
+         * @return The component, or nullptr if the entity had none.
+         */
+        T* find_resolved(EcsIdT component_id) {
+            CYAN_ECS_COUNT(counters.n_gets);
+            if (component_id == ECS_NULL_INDEX) {
+                CYAN_ECS_COUNT(counters.n_misses);
+                return nullptr;
+            }
+            return components.get(component_id).value;
+        }
+
+        /**
+         * As find_resolved(), but for modification, marking the component as changed.
+         */
+        T* find_resolved_for_write(EcsIdT component_id) {
+            auto component = find_resolved(component_id);
+            if (component) mark_changed_at(ecs_impl::get_index(component_id));
+            return component;
+        }
+
+        /**
+         * Look up a component from an Entity ID for modification, marking it as changed.
+         * @param e The entity to look up.
+         * @return A pointer to the entity's component, or nullptr if it has no component in this registry.
+         */
+        T* find_for_write(Entity e) {
+            auto component_id = find_component_id(e);
+            if (!component_id) return nullptr;
+            auto component = components.get(*component_id).value;
+            if (component) mark_changed_at(ecs_impl::get_index(*component_id));
+            return component;
+        }
+
+        /**
+         * Mark a component as changed at the current tick. Does nothing if the component doesn't exist.
+         * @param id The ID of the component.
+         */
+        void mark_changed(Id id) {
+            if (!components.get(id.id)) return;
+            mark_changed_at(ecs_impl::get_index(id.id));
+        }
+
+        /**
+         * Mark the component in a slot, as found by find(Entity, EcsIndexT&), as changed at the current tick.
+         * @param slot The index of the component's slot.
+         */
+        void mark_changed_in_slot(EcsIndexT slot) {
+            mark_changed_at(slot);
+        }
+
+        /**
+         * Mark an entity's component as changed at the current tick. Does nothing if the entity has no component here.
+         * @param e The entity whose component changed.
+         */
+        void mark_changed(Entity e) {
+            if (auto component_id = entity_components.find(e.id)) {
+                mark_changed_at(ecs_impl::get_index(*component_id));
+            }
+        }
+
+        /**
+         * Set the tick that components added or changed from now on are stamped with.
+         */
+        void set_tick(EcsTickT tick) override {
+            current_tick = tick;
+            added_ticks.set_tick(tick);
+            changed_ticks.set_tick(tick);
+        }
+
+        /**
+         * Get the tick that components added or changed now are stamped with.
+         */
+        [[nodiscard]]
+        EcsTickT get_tick() const {
+            return current_tick;
+        }
+
+        /**
+         * Add an observer for a kind of component event. Events are only recorded once an observer for their kind has
+         * been added.
+         * @param event The kind of event to observe.
+         * @param fn The observer, called with each batch of events by flush_events().
+         * @return The observer's ID (never 0), for unobserve().
+         */
+        std::uint64_t observe(ComponentEvent event, ComponentObserverFn fn) override {
+            auto observer_id = next_observer_id;
+            next_observer_id += 1;
+            observers[std::size_t(event)].push_back({observer_id, std::move(fn)});
+            update_recording();
+            return observer_id;
+        }
+
+        /**
+         * Remove an observer added with observe(). Once a kind of event has no observers, it's no longer recorded, and
+         * events of that kind which haven't been flushed yet are discarded. Observers may remove themselves (or each
+         * other) while they're being called by flush_events(), and removed observers aren't called again.
+         * @param observer_id The ID observe() returned.
+         * @return Whether the observer was found (and removed).
+         */
+        bool unobserve(std::uint64_t observer_id) override {
+            for (auto& event_observers : observers) {
+                for (auto& observer : event_observers) {
+                    if (observer.id != observer_id || !observer.fn) continue;
+                    // Observers are only erased once nothing is being dispatched, so dispatch() can index them safely.
+                    observer.fn = nullptr;
+                    if (dispatch_depth == 0) erase_unobserved();
+                    update_recording();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * Dispatch the events recorded since the last flush to their observers: first the entities whose component
+         * was removed, then those whose component was added, then those whose component was changed. Each entity
+         * appears at most once per batch, and events which cancel out (e.g. a component which was added and then
+         * removed again) aren't reported. A component which was replaced is reported as removed and then added.
+         * Events caused by the observers themselves are kept for the next flush.
+         */
+        void flush_events() override {
+            // Take the recorded events first, so events recorded by observers are kept for the next flush.
+            std::vector<PendingEvent> events;
+            std::swap(events, pending_events);
+            // Only the components marked since the last flush are visited (in index order, as if every slot had been
+            // scanned). Indices marked again after being reused appear twice, but only the first clears the mark.
+            std::vector<EcsIndexT> changed_indices;
+            std::swap(changed_indices, pending_change_indices);
+            std::sort(changed_indices.begin(), changed_indices.end());
+            std::vector<Entity> changed;
+            for (auto index : changed_indices) {
+                if (!change_pending[index]) continue;
+                change_pending[index] = 0;
+                if (component_entities[index] == ECS_NULL_INDEX) continue;
+                changed.push_back(Entity{component_entities[index]});
+            }
+
+            // Reduce each entity's events to their overall effect.
+            std::vector<Entity> added;
+            std::vector<Entity> removed;
+            std::stable_sort(events.begin(), events.end(), [](const PendingEvent& a, const PendingEvent& b) {
+                return a.entity.id < b.entity.id;
+            });
+            for (std::size_t first = 0, last = 0; first < events.size(); first = last) {
+                while (last < events.size() && events[last].entity.id == events[first].entity.id) last += 1;
+                auto e = events[first].entity;
+                bool existed_before = !events[first].added;
+                bool exists_now = find(e) != nullptr;
+                if (existed_before) removed.push_back(e);
+                if (exists_now) added.push_back(e);
+            }
+
+            dispatch(ComponentEvent::Removed, removed);
+            dispatch(ComponentEvent::Added, added);
+            dispatch(ComponentEvent::Changed, changed);
+        }
+
+        /**
+         * Call a function on each component which was changed (or added) at or after a given tick.
+         * Only the log of the slots stamped since then is read, so this takes time proportional to the number of
+         * changed components (plus those changed again since, which are skipped), not the size of the registry. A
+         * system which passes the tick it last ran at sees every change since then (changes made earlier in that same
+         * tick are seen again).
+         * @param tick The earliest tick of interest.
+         * @param fn A function taking (Entity, const T&).
+         */
+        template <typename Fn>
+        void changed_since(EcsTickT tick, Fn&& fn) {
+            for_each_ticked_since(changed_ticks, tick, fn);
+        }
+
+        /**
+         * Call a function on each component which was added at or after a given tick (see changed_since()).
+         * @param tick The earliest tick of interest.
+         * @param fn A function taking (Entity, const T&).
+         */
+        template <typename Fn>
+        void added_since(EcsTickT tick, Fn&& fn) {
+            for_each_ticked_since(added_ticks, tick, fn);
+        }
+
+        /**
+         * Get the IDs of every entity with a component in this registry, packed with no gaps.
+         * The order is unspecified, and is changed by removal. Adding or removing components invalidates the reference.
+         */
+        [[nodiscard]]
+        const std::vector<EcsIdT>& entity_ids() const {
+            return entity_components.keys();
         }
 
         /**
@@ -142,7 +466,8 @@ namespace cyan {
         Entry get(Id id) {
             auto component_entry = components.get(id.id);
             if (!component_entry) return make_null_entry();
-            return Entry::make_from_object_registry_entry(Entity{component_entity_map[id.id]}, component_entry);
+            return Entry::make_from_object_registry_entry(
+                    this, Entity{component_entities[ecs_impl::get_index(id.id)]}, component_entry);
         }
 
         /**
@@ -150,34 +475,319 @@ namespace cyan {
          * @param id The id of the object to remove.
          */
         void remove(Id id) {
-            auto component_entity_iter = component_entity_map.find(id.id);
-            if (component_entity_iter == component_entity_map.end()) return;
-            auto entity_id = component_entity_iter->second;
-            entity_component_map.erase(entity_id);
-            component_entity_map.erase(component_entity_iter);
+            if (!components.get(id.id)) return;
+            auto& entity_id = component_entities[ecs_impl::get_index(id.id)];
+            if (record_lifecycle) pending_events.push_back({Entity{entity_id}, false});
+            entity_components.erase(entity_id);
+            entity_id = ECS_NULL_INDEX;
+            forget_ticks(ecs_impl::get_index(id.id));
             components.remove(id.id);
+            mark_unpublished();
+            CYAN_ECS_COUNT(counters.n_removes);
         }
 
         /**
          * Remove an object from the array via the ID of it's owning entity.
          * @param e The entity id from which to remove the component.
          */
-        void remove(Entity e) {
-            auto entity_component_iter = entity_component_map.find(e.id);
-            // TODO: since remove(Id) looks up in component_entity_map to clear the values there, this is inefficient,
-            // TODO: so it should be checked with a profiler to double-check the multiple lookups aren't a problem.
-            if (entity_component_iter == entity_component_map.end()) return;
-            remove(Id{entity_component_iter->second});
+        void remove(Entity e) override {
+            auto component_id = entity_components.find(e.id);
+            if (!component_id) return;
+            auto id = *component_id;
+            if (record_lifecycle) pending_events.push_back({e, false});
+            entity_components.erase(e.id);
+            component_entities[ecs_impl::get_index(id)] = ECS_NULL_INDEX;
+            forget_ticks(ecs_impl::get_index(id));
+            components.remove(id);
+            mark_unpublished();
+            CYAN_ECS_COUNT(counters.n_removes);
+        }
+
+        /**
+         * Reserve memory for a total of n components, so adding up to that many doesn't reallocate.
+         */
+        void reserve(std::size_t n) override {
+            components.reserve(n);
+            component_entities.reserve(n);
+            added_ticks.reserve(n);
+            changed_ticks.reserve(n);
+            change_pending.reserve(n);
+            entity_components.reserve(n);
+        }
+
+        /**
+         * Remove every component in the registry.
+         */
+        void clear() override {
+            CYAN_ECS_COUNT_N(counters.n_removes, entity_components.size());
+            if (record_lifecycle) {
+                for (auto entity_id : entity_components.keys()) {
+                    pending_events.push_back({Entity{entity_id}, false});
+                }
+            }
+            components.clear();
+            std::fill(component_entities.begin(), component_entities.end(), ECS_NULL_INDEX);
+            added_ticks.forget_all();
+            changed_ticks.forget_all();
+            entity_components.clear();
+            mark_unpublished();
+        }
+
+        /**
+         * Release as much unused memory as possible (see IComponentRegistry::shrink_to_fit()).
+         */
+        void shrink_to_fit() override {
+            components.shrink_to_fit();
+            component_entities.shrink_to_fit();
+            added_ticks.shrink_to_fit();
+            changed_ticks.shrink_to_fit();
+            change_pending.shrink_to_fit();
+            pending_change_indices.shrink_to_fit();
+            entity_components.shrink_to_fit();
+        }
+
+        /**
+         * Get the registry's footprint and operation counters (see IComponentRegistry::get_stats()).
+         */
+        [[nodiscard]]
+        ComponentRegistryStats get_stats() const override {
+            ComponentRegistryStats stats;
+            stats.n_components = size();
+            stats.n_slots = slot_count();
+            stats.memory_bytes = memory_bytes();
+            stats.bytes_per_component = stats.n_components ? double(stats.memory_bytes) / stats.n_components : 0.0;
+            stats.n_lookup_pages = entity_components.allocated_page_count();
+            auto n_lookup_slots = stats.n_lookup_pages * ecs_impl::SparseSet<EcsIdT>::PAGE_SIZE;
+            stats.lookup_load_factor = n_lookup_slots ? double(entity_components.size()) / n_lookup_slots : 0.0;
+#if CYAN_ECS_STATS
+            counters.get(stats);
+#endif
+            stats.storage = components.get_stats();
+            return stats;
         }
 
         /**
          * Get the number of currently active elements in the registry.
          */
         [[nodiscard]]
-        std::size_t size() const {
+        std::size_t size() const override {
             return components.size();
         }
 
+        /**
+         * Get the (approximate) number of bytes allocated by the registry, including unused capacity.
+         */
+        [[nodiscard]]
+        std::size_t memory_bytes() const override {
+            return components.memory_bytes()
+                   + component_entities.capacity() * sizeof(EcsIdT)
+                   + added_ticks.memory_bytes() + changed_ticks.memory_bytes()
+                   + change_pending.capacity() + pending_change_indices.capacity() * sizeof(EcsIndexT)
+                   + pending_events.capacity() * sizeof(PendingEvent)
+                   + entity_components.memory_bytes();
+        }
+
+        /**
+         * Get the end of the range of storage positions accepted by for_each_in_range(). This is size() for packed
+         * storage, and may be larger (including removed slots) otherwise.
+         */
+        [[nodiscard]]
+        std::size_t slot_count() const {
+            return components.slot_count();
+        }
+
+        /**
+         * Call a function on each component stored at a position in [first, last) of the underlying storage.
+         * Ranges are used to split iteration into independent pieces, e.g. for ECS::par_each().
+         * @param fn A function taking (Entity, T&).
+         */
+        template <typename Fn>
+        void for_each_in_range(std::size_t first, std::size_t last, Fn&& fn) {
+            components.for_each_in_range(first, last, [&](EcsIdT id, T& component) {
+                fn(Entity{component_entities[ecs_impl::get_index(id)]}, component);
+            });
+        }
+
+        /**
+         * As for_each_in_range(), on a const registry.
+         * @param fn A function taking (Entity, const T&).
+         */
+        template <typename Fn>
+        void for_each_in_range(std::size_t first, std::size_t last, Fn&& fn) const {
+            const_cast<SingleComponentRegistry*>(this)->for_each_in_range(first, last, [&](Entity e, T& component) {
+                fn(e, std::as_const(component));
+            });
+        }
+
+        /**
+         * As for_each_in_range(), but for functions which modify the components: each component visited is marked as
+         * changed. Different ranges may be processed concurrently.
+         * @param fn A function taking (Entity, T&).
+         */
+        template <typename Fn>
+        void modify_each_in_range(std::size_t first, std::size_t last, Fn&& fn) {
+            // Slots are stamped as they're visited, but only added to the shared change log once the range is done.
+            // The same goes for components marked as pending a change event.
+            std::vector<EcsIndexT> stamped;
+            std::vector<EcsIndexT> marked;
+            components.for_each_in_range(first, last, [&](EcsIdT id, T& component) {
+                auto index = ecs_impl::get_index(id);
+                if (changed_ticks.stamp_unlogged(index, current_tick)) stamped.push_back(index);
+                if (record_changes && !change_pending[index]) {
+                    change_pending[index] = 1;
+                    marked.push_back(index);
+                }
+                mark_unpublished();
+                fn(Entity{component_entities[index]}, component);
+            });
+            if (stamped.empty() && marked.empty()) return;
+            std::lock_guard lock(change_log_mutex);
+            changed_ticks.append_log(stamped, current_tick);
+            pending_change_indices.insert(pending_change_indices.end(), marked.begin(), marked.end());
+        }
+
+        /**
+         * Remove orphaned components from part of the underlying storage (see IComponentRegistry::remove_orphans()).
+         */
+        OrphanSweep remove_orphans(std::size_t& cursor, std::size_t max_slots, EntityRegistry& entities) override {
+            OrphanSweep sweep;
+            auto n_slots = slot_count();
+            auto first = std::min(cursor, n_slots);
+            auto last = first + std::min(max_slots, n_slots - first);
+
+            // Collect the orphans first, as removal can move components around.
+            std::vector<Entity> orphans;
+            for_each_in_range(first, last, [&](Entity e, T&) {
+                if (!entities.get(e.id)) orphans.push_back(e);
+            });
+            for (auto e : orphans) {
+                remove(e);
+            }
+
+            sweep.n_slots_scanned = last - first;
+            sweep.n_removed = orphans.size();
+            sweep.bytes_removed = orphans.size() * sizeof(T);
+            sweep.reached_end = last >= n_slots;
+            cursor = sweep.reached_end ? 0 : last;
+            return sweep;
+        }
+
+        /**
+         * Write the components to a snapshot (see IComponentRegistry::save_snapshot()). Trivially copyable components
+         * are written as a plain array, and others with their serializer.
+         */
+        void save_snapshot(SnapshotWriter& writer) override {
+            if (size() == 0) return;
+            if (component_type_name.empty()) {
+                LOG(WARN, "Skipping {} components of an unnamed type while saving a snapshot. Name the type with "
+                          "ECS::register_component_type() to include it.", size());
+                return;
+            }
+            if constexpr (!is_snapshot_serializable<T>) {
+                LOG(WARN, "Skipping {} components of type \"{}\" while saving a snapshot, as the type isn't trivially "
+                          "copyable and has no serializer.", size(), component_type_name);
+            } else {
+                constexpr bool trivially_copied = std::is_trivially_copyable_v<T>;
+                writer.begin_section(SnapshotSectionKind::Components, component_type_name, sizeof(T), size(),
+                                     trivially_copied ? SNAPSHOT_TRIVIALLY_COPIED : 0);
+                writer.begin_block();
+                for_each_in_range(0, slot_count(), [&](Entity e, T&) {
+                    writer.write_bytes(&e.id, sizeof(e.id));
+                });
+                writer.begin_block();
+                for_each_in_range(0, slot_count(), [&](Entity, T& component) {
+                    if constexpr (trivially_copied) {
+                        writer.write_bytes(&component, sizeof(T));
+                    } else {
+                        writer.write(component);
+                    }
+                });
+            }
+        }
+
+        /**
+         * Replace the components with those in a snapshot (see IComponentRegistry::load_snapshot()). Trivially copyable
+         * components are copied straight out of the snapshot into fresh storage; others are deserialized one at a time,
+         * and need to be default-constructible.
+         */
+        void load_snapshot(const SnapshotSection& section) override {
+            if constexpr (!is_snapshot_serializable<T>) {
+                throw cyan::Error("Component type \"{}\" can't be loaded from a snapshot, as it isn't trivially "
+                                  "copyable and has no serializer", component_type_name);
+            } else {
+                constexpr bool trivially_copied = std::is_trivially_copyable_v<T>;
+                if (section.element_bytes != sizeof(T)
+                    || bool(section.flags & SNAPSHOT_TRIVIALLY_COPIED) != trivially_copied) {
+                    throw cyan::Error("The snapshot of component type \"{}\" doesn't match the type: it has {} byte "
+                                      "components{}, but the type is {} bytes{}", component_type_name,
+                                      section.element_bytes,
+                                      section.flags & SNAPSHOT_TRIVIALLY_COPIED ? "" : " (serialized)",
+                                      sizeof(T), trivially_copied ? "" : " (serialized)");
+                }
+                auto n_components = std::size_t(section.n_elements);
+                auto entity_ids = reinterpret_cast<const EcsIdT*>(
+                        section.get_block(0, n_components * sizeof(EcsIdT)).data);
+
+                // Start from fresh storage, so the loaded components are stored in order.
+                clear();
+                components = StorageT();
+                component_entities.clear();
+                added_ticks.clear();
+                changed_ticks.clear();
+                change_pending.clear();
+                pending_change_indices.clear();
+                reserve(n_components);
+                auto check_entity = [&](Entity e) {
+                    if (entity_components.contains(e.id)) {
+                        throw cyan::Error("The snapshot of component type \"{}\" has entity {} more than once",
+                                          component_type_name, e.id);
+                    }
+                };
+                if constexpr (trivially_copied) {
+                    auto first = components.add_copies(
+                            reinterpret_cast<const T*>(section.get_block(1, n_components * sizeof(T)).data),
+                            n_components);
+                    for (std::size_t i = 0; i < n_components; i += 1) {
+                        check_entity(Entity{entity_ids[i]});
+                        link_component(Entity{entity_ids[i]}, ecs_impl::make_ecs_id(0, first + i));
+                    }
+                } else {
+                    SnapshotBlockReader in(section.get_block(1));
+                    for (std::size_t i = 0; i < n_components; i += 1) {
+                        check_entity(Entity{entity_ids[i]});
+                        T component{};
+                        in.read(component);
+                        add(Entity{entity_ids[i]}, std::move(component));
+                    }
+                }
+            }
+        }
+
+        /**
+         * Get an immutable copy of the components, for readers on other threads (see ECS::publish()). A new copy is
+         * only made if components have been added, removed, or changed (as recorded by change tracking, see
+         * changed_since()) since the last one, and otherwise the last copy is returned again, so the registry keeps
+         * it's last copy alive. Observers and pending events aren't copied.
+         * Writes through a pointer which didn't mark the component as changed (e.g. from find()) aren't noticed.
+         * @return The copy, or nullptr (with a warning) if T can't be copied.
+         */
+        std::shared_ptr<const IComponentRegistry> publish() override {
+            if constexpr (!std::is_copy_constructible_v<T>) {
+                if (!published_unsupported_warned) {
+                    LOG(WARN, "Component type \"{}\" can't be copied, so it's components won't be published.",
+                        component_type_name);
+                    published_unsupported_warned = true;
+                }
+                return nullptr;
+            } else {
+                if (!published || unpublished_changes.load(std::memory_order_relaxed)) {
+                    unpublished_changes.store(false, std::memory_order_relaxed);
+                    published.reset(new SingleComponentRegistry(*this));
+                }
+                return published;
+            }
+        }
+
         /**
          * Utility function to make a null entry.
          */
@@ -186,16 +796,221 @@ namespace cyan {
         }
 
     private:
-        std::unordered_map<EcsIdT, EcsIdT> entity_component_map;
-        std::unordered_map<EcsIdT, EcsIdT> component_entity_map;
-        ecs_impl::ObjectRegistry<T> components;
+        /**
+         * Internal function to copy a registry's components for publish(), leaving out it's observers, pending events
+         * and published copy.
+         */
+        SingleComponentRegistry(const SingleComponentRegistry& other)
+            : entity_components(other.entity_components), component_entities(other.component_entities),
+              added_ticks(other.added_ticks), changed_ticks(other.changed_ticks), current_tick(other.current_tick),
+              components(other.components), component_type_name(other.component_type_name)
+        {}
+
+        /**
+         * Internal function to ensure the slot for an entity's index is free before a component is added.
+         * A registry holds at most one component per entity index. If the slot is held by an older generation of the
+         * entity (i.e. an orphaned component left behind by a deleted entity), that component is removed. If it is held
+         * by a newer generation, the provided entity must have been deleted, so the add is refused.
+         * @param e The entity that a component is about to be added to.
+         * @return Whether the entity's slot is free to use.
+         */
+        bool make_room_for_entity(Entity e) {
+            auto occupant = entity_components.find_occupant(e.id);
+            if (occupant == ECS_NULL_INDEX) return true;
+            if (ecs_impl::get_generation(occupant) > ecs_impl::get_generation(e.id)) {
+                LOG(WARN, "Attempted to add a component of type \"{}\" to entity {}, but a newer entity {} has "
+                          "replaced it. The provided component will be discarded.",
+                    component_type_name, e.id, occupant);
+                return false;
+            }
+            remove(Entity{occupant});
+            return true;
+        }
+
+        /**
+         * Internal function to record the entity/component association of a newly added component.
+         */
+        void link_component(Entity e, EcsIdT component_id) {
+            auto component_index = ecs_impl::get_index(component_id);
+            if (component_entities.size() <= component_index) {
+                component_entities.resize(component_index + 1, ECS_NULL_INDEX);
+                added_ticks.resize(component_index + 1);
+                changed_ticks.resize(component_index + 1);
+                change_pending.resize(component_index + 1);
+            }
+            component_entities[component_index] = e.id;
+            added_ticks.stamp(component_index, current_tick);
+            changed_ticks.stamp(component_index, current_tick);
+            change_pending[component_index] = 0;
+            entity_components.insert(e.id, component_id);
+            if (record_lifecycle) pending_events.push_back({e, true});
+            mark_unpublished();
+            CYAN_ECS_COUNT(counters.n_adds);
+        }
+
+        /**
+         * Internal function to look up the ID of an entity's component, counting the lookup (see ecs_stats.hpp).
+         */
+        EcsIdT* find_component_id(Entity e) {
+            auto component_id = entity_components.find(e.id);
+#if CYAN_ECS_STATS
+            counters.n_gets.add(1);
+            if (!component_id) {
+                counters.n_misses.add(1);
+                if (entity_components.find_occupant(e.id) != ECS_NULL_INDEX) counters.n_generation_rejects.add(1);
+            }
+#endif
+            return component_id;
+        }
+
+        /**
+         * Internal function to forget the ticks of a component index whose component has been removed.
+         */
+        void forget_ticks(EcsIndexT index) {
+            added_ticks.forget(index, current_tick);
+            changed_ticks.forget(index, current_tick);
+        }
+
+        /**
+         * Internal function to mark the component at a component index as changed.
+         */
+        void mark_changed_at(EcsIndexT index) {
+            changed_ticks.stamp(index, current_tick);
+            if (record_changes && !change_pending[index]) {
+                change_pending[index] = 1;
+                pending_change_indices.push_back(index);
+            }
+            mark_unpublished();
+        }
+
+        /**
+         * Internal function to note that the registry differs from it's last published copy. This may be called
+         * concurrently (see modify_each_in_range()), and the flag is only written if it isn't already set, so threads
+         * marking many components don't contend on it.
+         */
+        void mark_unpublished() {
+            if (!unpublished_changes.load(std::memory_order_relaxed)) {
+                unpublished_changes.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * Internal function to call each observer of an event with a batch of entities. Observers added by the
+         * observers aren't called until the next batch, and observers they remove aren't called at all.
+         */
+        void dispatch(ComponentEvent event, const std::vector<Entity>& batch) {
+            if (batch.empty()) return;
+            auto& event_observers = observers[std::size_t(event)];
+            auto n_observers = event_observers.size();
+            dispatch_depth += 1;
+            try {
+                for (std::size_t i = 0; i < n_observers; i += 1) {
+                    // A copy, as the observer may add observers (moving the others) or remove itself while it runs.
+                    auto fn = event_observers[i].fn;
+                    if (fn) fn(batch);
+                }
+            } catch (...) {
+                dispatch_depth -= 1;
+                throw;
+            }
+            dispatch_depth -= 1;
+            if (dispatch_depth == 0) erase_unobserved();
+        }
+
+        /**
+         * Internal function to update which kinds of event are recorded after observers are added or removed.
+         * Events of a kind which is no longer observed are discarded.
+         */
+        void update_recording() {
+            auto is_observed = [&](ComponentEvent event) {
+                auto& event_observers = observers[std::size_t(event)];
+                return std::any_of(event_observers.begin(), event_observers.end(),
+                                   [](const Observer& observer) { return bool(observer.fn); });
+            };
+            record_lifecycle = is_observed(ComponentEvent::Added) || is_observed(ComponentEvent::Removed);
+            record_changes = is_observed(ComponentEvent::Changed);
+            if (!record_lifecycle) pending_events.clear();
+            if (!record_changes) {
+                for (auto index : pending_change_indices) {
+                    change_pending[index] = 0;
+                }
+                pending_change_indices.clear();
+            }
+        }
+
+        /**
+         * Internal function to erase the observers which have been removed by unobserve().
+         */
+        void erase_unobserved() {
+            for (auto& event_observers : observers) {
+                event_observers.erase(std::remove_if(event_observers.begin(), event_observers.end(),
+                                                     [](const Observer& observer) { return !observer.fn; }),
+                                      event_observers.end());
+            }
+        }
+
+        /**
+         * Internal function to call a function on each component whose slot was stamped in the given ticks at or after
+         * since. Components are read straight from their slot, without looking their entity up.
+         */
+        template <typename Fn>
+        void for_each_ticked_since(const ecs_impl::SlotTicks& ticks, EcsTickT since, Fn& fn) {
+            ticks.for_each_since(since, [&](EcsIndexT index) {
+                if (component_entities[index] == ECS_NULL_INDEX) return;
+                fn(Entity{component_entities[index]}, std::as_const(*components.get_in_slot(index)));
+            });
+        }
+
+    private:
+        // Entity -> component ID mapping. This is a sparse set indexed by the entity index, so lookups don't need to
+        // hash, and it's dense arrays hold every entity with a component of this type (with no gaps).
+        ecs_impl::SparseSet<EcsIdT> entity_components;
+        // Component -> entity ID mapping, indexed by the component index (which is dense, being a position within
+        // the ObjectRegistry).
+        std::vector<EcsIdT> component_entities;
+        // The tick at which each component was added and last changed, indexed by component index (as above), with
+        // logs of the slots stamped in each tick.
+        ecs_impl::SlotTicks added_ticks;
+        ecs_impl::SlotTicks changed_ticks;
+        // Guards changed_ticks' log and pending_change_indices while ranges are modified concurrently (see
+        // modify_each_in_range()).
+        std::mutex change_log_mutex;
+        EcsTickT current_tick = 0;
+        /// A component being added to or removed from an entity, recorded for flush_events().
+        struct PendingEvent {
+            Entity entity;
+            bool added;
+        };
+        std::vector<PendingEvent> pending_events;
+        // Whether each component has changed since the last flush_events(), indexed by component index. Only kept
+        // up to date while there are observers of changes.
+        std::vector<std::uint8_t> change_pending;
+        // The component indices set in change_pending, so flush_events() doesn't have to scan every component.
+        std::vector<EcsIndexT> pending_change_indices;
+        /// An observer added by observe(). It's fn is null once it's been removed.
+        struct Observer {
+            std::uint64_t id;
+            ComponentObserverFn fn;
+        };
+        std::array<std::vector<Observer>, 3> observers;
+        std::uint64_t next_observer_id = 1;
+        // The number of dispatch() calls in progress (observers can flush events too).
+        int dispatch_depth = 0;
+        bool record_lifecycle = false;
+        bool record_changes = false;
+        StorageT components;
         // We store the name of the component type here.
         // This is redundant, because it's also stored in ComponentMap. However, it's very useful to have it accessible
         // from within SingleComponentRegistry (so the assigned component name can be quoted on error logs) and also in
-        // ComponentMap for use in a debugger (because ComponentMap uses void* to store these Registries, it's not easy
-        // to debug.
-        // TODO: We can likely clean up this system when we move to making SingleComponentRegistry<T> inherit from a
-        //       non-templated abstract class.
+        // ComponentMap for use in a debugger (because ComponentMap stores these registries as IComponentRegistry, it's
+        // not easy to debug).
         std::string component_type_name;
+        // Whether the registry has changed since it was last published, and the last published copy (see publish()).
+        std::atomic<bool> unpublished_changes{true};
+        std::shared_ptr<const SingleComponentRegistry<T>> published;
+        bool published_unsupported_warned = false;
+#if CYAN_ECS_STATS
+        ecs_impl::ComponentRegistryCounters counters;
+#endif
     };
 }
\ No newline at end of file
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "cyan/src/engine/ecs/ecs_common.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace cyan::ecs_impl {
+    /** SlotTicks
+     * Records the tick at which each slot of a registry was last stamped (e.g. when it's component last changed), along
+     * with a log of the slots stamped in each tick, so the slots stamped at or after a tick can be visited without
+     * scanning every slot.
+     * A slot is only logged when it's stamped with a tick it doesn't already have, and a log entry only counts while
+     * the slot's tick still matches it, so a slot stamped again in a later tick is visited once, for it's latest tick.
+     * Superseded entries are dropped once they outnumber the slots (see compact()), so the log stays proportional to
+     * the number of slots however many changes are made.
+     * Ticks are expected to only go forwards. If they go back (e.g. when loading a snapshot), slots stamped after the
+     * new tick are treated as stamped at it, and the log is rebuilt.
+     */
+    struct SlotTicks {
+        /// The tick of a slot which has never been stamped.
+        static constexpr EcsTickT NO_TICK = std::numeric_limits<EcsTickT>::max();
+
+        /**
+         * Get the number of slots.
+         */
+        [[nodiscard]]
+        std::size_t size() const {
+            return ticks.size();
+        }
+
+        /**
+         * Make room for slots up to the given size. New slots have no tick.
+         */
+        void resize(std::size_t n) {
+            ticks.resize(n, NO_TICK);
+        }
+
+        /**
+         * Get the tick a slot was last stamped with, or NO_TICK.
+         */
+        [[nodiscard]]
+        EcsTickT get(EcsIndexT index) const {
+            return ticks[index];
+        }
+
+        /**
+         * Stamp a slot with a tick, logging it if it hasn't been stamped with that tick already.
+         * @param index The slot's index, which must be less than size().
+         * @param tick The tick, which should be at least the tick of every stamp so far.
+         */
+        void stamp(EcsIndexT index, EcsTickT tick) {
+            if (ticks[index] == tick) return;
+            ticks[index] = tick;
+            log.push_back({tick, index});
+        }
+
+        /**
+         * Stamp a slot with a tick without logging it, which is safe to do concurrently for different slots. Each slot
+         * for which this returns true has to be logged with append_log() before the log is next used.
+         * @return Whether the slot needs to be logged.
+         */
+        bool stamp_unlogged(EcsIndexT index, EcsTickT tick) {
+            if (ticks[index] == tick) return false;
+            ticks[index] = tick;
+            return true;
+        }
+
+        /**
+         * Forget a slot's tick, e.g. once it's component has been removed, so it's log entry can be dropped. A slot
+         * stamped in the current tick keeps it's tick (and so it's entry), as it may be stamped again in this tick,
+         * which mustn't log it twice. Callers skip such slots themselves until they're reused.
+         * @param index The slot's index.
+         * @param tick The current tick.
+         */
+        void forget(EcsIndexT index, EcsTickT tick) {
+            if (ticks[index] != tick) ticks[index] = NO_TICK;
+        }
+
+        /**
+         * Forget the tick of every slot, keeping the slots.
+         */
+        void forget_all() {
+            std::fill(ticks.begin(), ticks.end(), NO_TICK);
+            log.clear();
+        }
+
+        /**
+         * Log slots which were stamped with stamp_unlogged().
+         * @param indices The indices of the slots.
+         * @param tick The tick they were stamped with.
+         */
+        void append_log(const std::vector<EcsIndexT>& indices, EcsTickT tick) {
+            for (auto index : indices) {
+                log.push_back({tick, index});
+            }
+        }
+
+        /**
+         * Call a function on the index of each slot whose tick is at or after a given tick, in the order they were
+         * stamped. Only the log entries from that tick on are visited. Slots stamped by fn itself aren't visited.
+         * @param since The earliest tick of interest.
+         * @param fn A function taking (EcsIndexT).
+         */
+        template <typename Fn>
+        void for_each_since(EcsTickT since, Fn&& fn) const {
+            auto first = std::lower_bound(log.begin(), log.end(), since, [](const LogEntry& entry, EcsTickT tick) {
+                return entry.tick < tick;
+            }) - log.begin();
+            // Positions rather than iterators, as fn may stamp slots (which appends to the log).
+            auto last = log.size();
+            for (auto position = std::size_t(first); position < last; position += 1) {
+                auto entry = log[position];
+                if (ticks[entry.index] == entry.tick) fn(entry.index);
+            }
+        }
+
+        /**
+         * Prepare for stamps with a new tick. If the tick is earlier than the last stamp, slots stamped after it are
+         * moved back to it, and the log is rebuilt so it's in order again. Superseded log entries are dropped if there
+         * are many of them (see compact()).
+         */
+        void set_tick(EcsTickT tick) {
+            if (!log.empty() && tick < log.back().tick) {
+                rebuild_log(tick);
+            } else if (log.size() > 2 * ticks.size() + MIN_COMPACT_ENTRIES) {
+                compact();
+            }
+        }
+
+        /**
+         * Drop the log entries which have been superseded by a later stamp of the same slot, leaving at most one entry
+         * per slot.
+         */
+        void compact() {
+            log.erase(std::remove_if(log.begin(), log.end(), [&](const LogEntry& entry) {
+                return ticks[entry.index] != entry.tick;
+            }), log.end());
+        }
+
+        /**
+         * Remove every slot.
+         */
+        void clear() {
+            ticks.clear();
+            log.clear();
+        }
+
+        /**
+         * Reserve memory for n slots.
+         */
+        void reserve(std::size_t n) {
+            ticks.reserve(n);
+        }
+
+        /**
+         * Release spare capacity, after dropping superseded log entries.
+         */
+        void shrink_to_fit() {
+            compact();
+            ticks.shrink_to_fit();
+            log.shrink_to_fit();
+        }
+
+        /**
+         * Get the (approximate) number of bytes allocated, including unused capacity.
+         */
+        [[nodiscard]]
+        std::size_t memory_bytes() const {
+            return ticks.capacity() * sizeof(EcsTickT) + log.capacity() * sizeof(LogEntry);
+        }
+
+    private:
+        /// Compaction isn't worth it for fewer superseded entries than this.
+        static constexpr std::size_t MIN_COMPACT_ENTRIES = 64;
+
+        struct LogEntry {
+            EcsTickT tick;
+            EcsIndexT index;
+        };
+
+        std::vector<EcsTickT> ticks;
+        /// Stamps in order of tick (and within a tick, in the order they were made).
+        std::vector<LogEntry> log;
+
+        /**
+         * Internal function to rebuild the log from the slots' ticks, in order of tick, after moving ticks later than
+         * max_tick back to it.
+         */
+        void rebuild_log(EcsTickT max_tick) {
+            log.clear();
+            for (std::size_t index = 0; index < ticks.size(); index += 1) {
+                if (ticks[index] == NO_TICK) continue;
+                ticks[index] = std::min(ticks[index], max_tick);
+                log.push_back({ticks[index], EcsIndexT(index)});
+            }
+            std::stable_sort(log.begin(), log.end(), [](const LogEntry& a, const LogEntry& b) {
+                return a.tick < b.tick;
+            });
+        }
+    };
+}
@@ -0,0 +1,288 @@
+#include "snapshot.hpp"
+
+#include <cstdio>
+#include <new>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace cyan;
+
+namespace {
+    constexpr char SNAPSHOT_MAGIC[8] = {'C', 'Y', 'A', 'N', 'S', 'N', 'A', 'P'};
+
+    /// Round an offset up to the next page boundary.
+    std::uint64_t page_align(std::uint64_t offset) {
+        return (offset + SNAPSHOT_PAGE_BYTES - 1) / SNAPSHOT_PAGE_BYTES * SNAPSHOT_PAGE_BYTES;
+    }
+}
+
+
+const SnapshotBlock& SnapshotSection::get_block(std::size_t index, std::size_t min_bytes) const
+{
+    if (index >= blocks.size() || blocks[index].n_bytes < min_bytes) {
+        throw cyan::Error("Snapshot section \"{}\" is missing data: block {} should hold at least {} bytes",
+                          name, index, min_bytes);
+    }
+    return blocks[index];
+}
+
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path(path), temp_path(path + ".tmp"), file(temp_path, std::ios::binary | std::ios::trunc)
+{
+    if (!file) {
+        throw cyan::Error("Couldn't open \"{}\" to write a snapshot", temp_path);
+    }
+    // The header is filled in by finish(), once the directory's offset is known.
+    SnapshotFileHeader header{};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    offset = sizeof(header);
+    pad_to_page();
+}
+
+
+SnapshotWriter::~SnapshotWriter()
+{
+    if (finished) return;
+    file.close();
+    std::remove(temp_path.c_str());
+}
+
+
+void SnapshotWriter::begin_section(SnapshotSectionKind kind, const std::string& name, std::uint64_t element_bytes,
+                                   std::uint64_t n_elements, std::uint32_t flags)
+{
+    SnapshotSectionRecord record{};
+    record.kind = std::uint32_t(kind);
+    record.flags = flags;
+    record.element_bytes = element_bytes;
+    record.n_elements = n_elements;
+    records.push_back(record);
+    names.push_back(name);
+}
+
+
+void SnapshotWriter::begin_block()
+{
+    if (records.empty()) throw cyan::Error("Snapshot blocks must be in a section");
+    auto& record = records.back();
+    if (record.n_blocks == SNAPSHOT_MAX_BLOCKS) {
+        throw cyan::Error("Snapshot section \"{}\" has too many blocks (the limit is {})", names.back(),
+                          SNAPSHOT_MAX_BLOCKS);
+    }
+    pad_to_page();
+    record.block_offsets[record.n_blocks] = offset;
+    record.block_bytes[record.n_blocks] = 0;
+    record.n_blocks += 1;
+}
+
+
+void SnapshotWriter::write_bytes(const void* data, std::size_t n_bytes)
+{
+    if (records.empty() || records.back().n_blocks == 0) throw cyan::Error("Snapshot data must be in a block");
+    if (n_bytes == 0) return;
+    file.write(static_cast<const char*>(data), std::streamsize(n_bytes));
+    offset += n_bytes;
+    records.back().block_bytes[records.back().n_blocks - 1] += n_bytes;
+}
+
+
+void SnapshotWriter::finish(EcsTickT tick)
+{
+    if (finished) throw cyan::Error("Snapshot \"{}\" has already been finished", path);
+
+    // The directory, followed by the section names.
+    pad_to_page();
+    auto directory_offset = offset;
+    auto name_offset = directory_offset + records.size() * sizeof(SnapshotSectionRecord);
+    for (std::size_t i = 0; i < records.size(); i += 1) {
+        records[i].name_offset = name_offset;
+        records[i].name_bytes = names[i].size();
+        name_offset += names[i].size();
+    }
+    file.write(reinterpret_cast<const char*>(records.data()), std::streamsize(records.size() * sizeof(records[0])));
+    for (auto& name : names) {
+        file.write(name.data(), std::streamsize(name.size()));
+    }
+    offset = name_offset;
+
+    SnapshotFileHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.id_bits = CYAN_ECS_ID_BITS;
+    header.generation_bits = CYAN_ECS_GENERATION_BITS;
+    header.page_bytes = SNAPSHOT_PAGE_BYTES;
+    header.tick = tick;
+    header.n_sections = std::uint32_t(records.size());
+    header.directory_offset = directory_offset;
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    check_file();
+
+    // Replace the destination only once the snapshot is complete.
+    std::remove(path.c_str());
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        throw cyan::Error("Couldn't move the snapshot from \"{}\" to \"{}\"", temp_path, path);
+    }
+    finished = true;
+}
+
+
+void SnapshotWriter::pad_to_page()
+{
+    static const char zeroes[SNAPSHOT_PAGE_BYTES] = {};
+    auto padding = page_align(offset) - offset;
+    file.write(zeroes, std::streamsize(padding));
+    offset += padding;
+    check_file();
+}
+
+
+void SnapshotWriter::check_file()
+{
+    if (file.fail()) {
+        throw cyan::Error("Failed writing the snapshot to \"{}\"", temp_path);
+    }
+}
+
+
+SnapshotReader::SnapshotReader(const std::string& path)
+    : path(path)
+{
+#if defined(_WIN32)
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) throw cyan::Error("Couldn't open snapshot \"{}\"", path);
+    n_bytes = std::size_t(file.tellg());
+    // The buffer is page-aligned like a mapping, so blocks of components are suitably aligned.
+    auto buffer = static_cast<unsigned char*>(::operator new(n_bytes + 1, std::align_val_t(SNAPSHOT_PAGE_BYTES)));
+    data = buffer;
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(buffer), std::streamsize(n_bytes))) {
+        release();
+        throw cyan::Error("Couldn't read snapshot \"{}\"", path);
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw cyan::Error("Couldn't open snapshot \"{}\"", path);
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw cyan::Error("Couldn't read the size of snapshot \"{}\"", path);
+    }
+    n_bytes = std::size_t(file_stat.st_size);
+    if (n_bytes > 0) {
+        void* mapping = mmap(nullptr, n_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw cyan::Error("Couldn't memory-map snapshot \"{}\"", path);
+        }
+        data = static_cast<const unsigned char*>(mapping);
+        mapped = true;
+    }
+    close(fd);
+#endif
+
+    try {
+        read_directory();
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+
+SnapshotReader::~SnapshotReader()
+{
+    release();
+}
+
+
+void SnapshotReader::release()
+{
+    if (!data) return;
+#if defined(_WIN32)
+    ::operator delete(const_cast<unsigned char*>(data), std::align_val_t(SNAPSHOT_PAGE_BYTES));
+#else
+    if (mapped) munmap(const_cast<unsigned char*>(data), n_bytes);
+#endif
+    data = nullptr;
+}
+
+
+EcsTickT SnapshotReader::get_tick() const
+{
+    return tick;
+}
+
+
+const std::vector<SnapshotSection>& SnapshotReader::get_sections() const
+{
+    return sections;
+}
+
+
+void SnapshotReader::read_directory()
+{
+    SnapshotFileHeader header;
+    if (n_bytes < sizeof(header)) throw cyan::Error("\"{}\" is too small to be a snapshot", path);
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        throw cyan::Error("\"{}\" isn't a snapshot", path);
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw cyan::Error("Snapshot \"{}\" has format version {}, but only version {} can be loaded", path,
+                          header.version, SNAPSHOT_VERSION);
+    }
+    if (header.id_bits != CYAN_ECS_ID_BITS || header.generation_bits != CYAN_ECS_GENERATION_BITS) {
+        throw cyan::Error("Snapshot \"{}\" was saved with {} bit IDs ({} generation bits), but this build uses {} bit "
+                          "IDs ({} generation bits)", path, header.id_bits, header.generation_bits,
+                          CYAN_ECS_ID_BITS, CYAN_ECS_GENERATION_BITS);
+    }
+    if (header.page_bytes != SNAPSHOT_PAGE_BYTES) {
+        throw cyan::Error("Snapshot \"{}\" has {} byte pages, but {} byte pages are expected", path,
+                          header.page_bytes, SNAPSHOT_PAGE_BYTES);
+    }
+    tick = header.tick;
+
+    // Everything the directory refers to has to be inside the file.
+    auto in_file = [&](std::uint64_t offset, std::uint64_t size) {
+        return offset <= n_bytes && size <= n_bytes - offset;
+    };
+    if (!in_file(header.directory_offset, std::uint64_t(header.n_sections) * sizeof(SnapshotSectionRecord))) {
+        throw cyan::Error("Snapshot \"{}\" is truncated: it's directory is missing", path);
+    }
+    for (std::uint32_t i = 0; i < header.n_sections; i += 1) {
+        SnapshotSectionRecord record;
+        std::memcpy(&record, data + header.directory_offset + i * sizeof(record), sizeof(record));
+        if (!in_file(record.name_offset, record.name_bytes) || record.n_blocks > SNAPSHOT_MAX_BLOCKS) {
+            throw cyan::Error("Snapshot \"{}\" is corrupt: section {} is invalid", path, i);
+        }
+
+        SnapshotSection section;
+        section.kind = SnapshotSectionKind(record.kind);
+        section.flags = record.flags;
+        section.element_bytes = record.element_bytes;
+        section.n_elements = record.n_elements;
+        section.name.assign(reinterpret_cast<const char*>(data + record.name_offset), record.name_bytes);
+        for (std::uint64_t block = 0; block < record.n_blocks; block += 1) {
+            if (!in_file(record.block_offsets[block], record.block_bytes[block])) {
+                throw cyan::Error("Snapshot \"{}\" is truncated: section \"{}\" runs past the end of the file", path,
+                                  section.name);
+            }
+            // Blocks are read in place as arrays, so they have to be as aligned as when they were written.
+            if (record.block_offsets[block] % SNAPSHOT_PAGE_BYTES != 0) {
+                throw cyan::Error("Snapshot \"{}\" is corrupt: block {} of section \"{}\" isn't page aligned", path,
+                                  block, section.name);
+            }
+            section.blocks.push_back(SnapshotBlock{data + record.block_offsets[block],
+                                                   std::size_t(record.block_bytes[block])});
+        }
+        sections.push_back(std::move(section));
+    }
+}
@@ -0,0 +1,331 @@
+/**
+ * The binary snapshot format used by ECS::save_snapshot() and ECS::load_snapshot().
+ * A snapshot file is a header page, followed by a number of sections (the entity registry, then one per component
+ * registry), followed by a directory describing the sections. Each section has a few blocks of bytes, and every block
+ * starts on a SNAPSHOT_PAGE_BYTES boundary, so when the file is memory-mapped, an array of trivially copyable
+ * components is correctly aligned and can be copied straight out of the mapping.
+ * Values are written in the native byte order, and a snapshot can only be loaded by a build with the same ECS ID width
+ * and generation split (see CYAN_ECS_ID_BITS). Files with a different SNAPSHOT_VERSION are rejected.
+ */
+
+#pragma once
+
+#include "ecs_common.hpp"
+#include "cyan/src/logging/error.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cyan {
+    /// The version of the snapshot format, which must be increased whenever the layout changes.
+    constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+
+    /// The alignment of every block in a snapshot file. This is part of the format, rather than the system page size.
+    constexpr std::size_t SNAPSHOT_PAGE_BYTES = 4096;
+
+    /// The most blocks a section can have.
+    constexpr std::size_t SNAPSHOT_MAX_BLOCKS = 4;
+
+    /// What a section of a snapshot holds.
+    enum class SnapshotSectionKind : std::uint32_t {
+        /// The entity registry's slots. Blocks: the ID of each slot, whether each slot is live (one byte each), and the
+        /// indices of free slots in the order they'll be reused.
+        Entities = 1,
+        /// A component registry, named after it's component type. Blocks: the entity of each component, and the
+        /// components themselves (as an array if the section has SNAPSHOT_TRIVIALLY_COPIED, otherwise serialized one
+        /// after another).
+        Components = 2,
+    };
+
+    /// Section flag for components stored as a plain array of their bytes.
+    constexpr std::uint32_t SNAPSHOT_TRIVIALLY_COPIED = 1;
+
+    /// The header at the start of a snapshot file.
+    struct SnapshotFileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t id_bits;
+        std::uint32_t generation_bits;
+        std::uint32_t page_bytes;
+        std::uint32_t tick;
+        std::uint32_t n_sections;
+        /// The file offset of the directory: n_sections SnapshotSectionRecords, followed by the section names.
+        std::uint64_t directory_offset;
+    };
+
+    /// A directory entry describing one section of a snapshot file.
+    struct SnapshotSectionRecord {
+        std::uint32_t kind;
+        std::uint32_t flags;
+        /// The size of each element (e.g. sizeof the component type), used to check that the layout still matches.
+        std::uint64_t element_bytes;
+        std::uint64_t n_elements;
+        /// Where the section's name is in the file.
+        std::uint64_t name_offset;
+        std::uint64_t name_bytes;
+        std::uint64_t n_blocks;
+        std::uint64_t block_offsets[SNAPSHOT_MAX_BLOCKS];
+        std::uint64_t block_bytes[SNAPSHOT_MAX_BLOCKS];
+    };
+
+    /// A block of a section, pointing into a loaded snapshot.
+    struct SnapshotBlock {
+        const unsigned char* data = nullptr;
+        std::size_t n_bytes = 0;
+    };
+
+    /// A section of a loaded snapshot (see SnapshotReader).
+    struct SnapshotSection {
+        SnapshotSectionKind kind;
+        std::uint32_t flags = 0;
+        std::uint64_t element_bytes = 0;
+        std::uint64_t n_elements = 0;
+        std::string name;
+        std::vector<SnapshotBlock> blocks;
+
+        /**
+         * Get a block of the section, checking that it exists and holds at least a given number of bytes.
+         * @throws cyan::Error if it doesn't.
+         */
+        const SnapshotBlock& get_block(std::size_t index, std::size_t min_bytes = 0) const;
+    };
+
+    struct SnapshotWriter;
+
+    namespace ecs_impl {
+        template <typename T>
+        struct IsStdVector: std::false_type {};
+        template <typename T, typename Allocator>
+        struct IsStdVector<std::vector<T, Allocator>>: std::true_type {};
+
+        template <typename T, typename = void>
+        struct HasSnapshotSerializer: std::false_type {};
+        template <typename T>
+        struct HasSnapshotSerializer<T, std::void_t<decltype(std::declval<const T&>().serialize(
+                std::declval<SnapshotWriter&>()))>>: std::true_type {};
+
+        template <typename T>
+        struct IsSnapshotSerializable: std::bool_constant<std::is_trivially_copyable_v<T>
+                                                          || std::is_same_v<T, std::string>
+                                                          || HasSnapshotSerializer<T>::value> {};
+        template <typename T, typename Allocator>
+        struct IsSnapshotSerializable<std::vector<T, Allocator>>: IsSnapshotSerializable<T> {};
+    }
+
+    /**
+     * Whether a type can be written to a snapshot: trivially copyable types are written as their bytes, std::strings
+     * and std::vectors (of serializable types) are handled by SnapshotWriter, and other types need a serializer.
+     * Generated components which aren't trivially copyable are given one by codegen, and any other type can have one
+     * by providing a pair of members like
+     *      template <typename Out> void serialize(Out& out) const { out.write(name); out.write(scores); }
+     *      template <typename In> void deserialize(In& in) { in.read(name); in.read(scores); }
+     * std::string and std::vector members are handled by SnapshotWriter::write() and SnapshotBlockReader::read().
+     */
+    template <typename T>
+    constexpr bool is_snapshot_serializable = ecs_impl::IsSnapshotSerializable<T>::value;
+
+    /** SnapshotWriter
+     * Writes a snapshot file, a section and a block at a time.
+     * The snapshot is written to a temporary file alongside the destination, which replaces the destination when
+     * finish() is called, so a failed or abandoned save never leaves a partial snapshot behind.
+     * I/O failures throw cyan::Error.
+     */
+    struct SnapshotWriter {
+        /**
+         * Start writing a snapshot.
+         * @param path The file the snapshot will be saved to.
+         */
+        explicit SnapshotWriter(const std::string& path);
+        ~SnapshotWriter();
+
+        SnapshotWriter(const SnapshotWriter&) = delete;
+        SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+        /**
+         * Start a new section, which holds the blocks started after it.
+         * @param kind What the section holds.
+         * @param name The name of the section (e.g. a component type name).
+         * @param element_bytes The size of each element.
+         * @param n_elements The number of elements.
+         * @param flags Flags for the section, e.g. SNAPSHOT_TRIVIALLY_COPIED.
+         */
+        void begin_section(SnapshotSectionKind kind, const std::string& name, std::uint64_t element_bytes,
+                           std::uint64_t n_elements, std::uint32_t flags = 0);
+
+        /**
+         * Start a new block in the current section, at the next page boundary.
+         */
+        void begin_block();
+
+        /**
+         * Append raw bytes to the current block.
+         */
+        void write_bytes(const void* data, std::size_t n_bytes);
+
+        /**
+         * Append a value to the current block: trivially copyable values as their bytes, std::strings and std::vectors
+         * as a length followed by their contents, and other types with their serializer (see is_snapshot_serializable).
+         */
+        template <typename T>
+        void write(const T& value) {
+            if constexpr (std::is_same_v<T, std::string>) {
+                std::uint64_t length = value.size();
+                write_bytes(&length, sizeof(length));
+                write_bytes(value.data(), value.size());
+            } else if constexpr (ecs_impl::IsStdVector<T>::value) {
+                std::uint64_t length = value.size();
+                write_bytes(&length, sizeof(length));
+                for (auto& element : value) {
+                    write(element);
+                }
+            } else if constexpr (ecs_impl::HasSnapshotSerializer<T>::value) {
+                value.serialize(*this);
+            } else {
+                static_assert(std::is_trivially_copyable_v<T>, "Type can't be written to a snapshot. Give it a "
+                                                               "serializer (see is_snapshot_serializable).");
+                write_bytes(&value, sizeof(T));
+            }
+        }
+
+        /**
+         * Write the directory and move the snapshot into place. Nothing can be written afterwards.
+         * @param tick The ECS tick the snapshot was taken at.
+         */
+        void finish(EcsTickT tick);
+
+    private:
+        std::string path;
+        std::string temp_path;
+        std::ofstream file;
+        std::uint64_t offset = 0;
+        std::vector<SnapshotSectionRecord> records;
+        std::vector<std::string> names;
+        bool finished = false;
+
+        /**
+         * Internal function to write zeroes up to the next page boundary.
+         */
+        void pad_to_page();
+
+        /**
+         * Internal function to check the file is still good after writing.
+         */
+        void check_file();
+    };
+
+    /** SnapshotReader
+     * Opens a snapshot file, memory-mapping it where possible (or else reading it into a page-aligned buffer), and
+     * checks it's header and directory. The sections' blocks point into the mapping, so they're only valid for the
+     * lifetime of the reader.
+     * @throws cyan::Error if the file can't be read, or isn't a snapshot this build can load.
+     */
+    struct SnapshotReader {
+        explicit SnapshotReader(const std::string& path);
+        ~SnapshotReader();
+
+        SnapshotReader(const SnapshotReader&) = delete;
+        SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+        /**
+         * Get the ECS tick the snapshot was taken at.
+         */
+        [[nodiscard]]
+        EcsTickT get_tick() const;
+
+        /**
+         * Get the sections of the snapshot, in the order they were written.
+         */
+        [[nodiscard]]
+        const std::vector<SnapshotSection>& get_sections() const;
+
+    private:
+        std::string path;
+        const unsigned char* data = nullptr;
+        std::size_t n_bytes = 0;
+        /// Whether data is a memory mapping (rather than a buffer allocated by the reader).
+        bool mapped = false;
+        EcsTickT tick = 0;
+        std::vector<SnapshotSection> sections;
+
+        /**
+         * Internal function to check the header and read the directory.
+         */
+        void read_directory();
+
+        /**
+         * Internal function to unmap (or free) the snapshot's data.
+         */
+        void release();
+    };
+
+    /** SnapshotBlockReader
+     * Reads values back out of a block written with SnapshotWriter::write(), checking that they don't run past the end
+     * of the block.
+     */
+    struct SnapshotBlockReader {
+        explicit SnapshotBlockReader(const SnapshotBlock& block)
+            : cursor(block.data), end(block.data + block.n_bytes)
+        {}
+
+        /**
+         * Read raw bytes from the block.
+         * @throws cyan::Error if the block doesn't have that many bytes left.
+         */
+        void read_bytes(void* out, std::size_t n_bytes) {
+            if (std::size_t(end - cursor) < n_bytes) {
+                throw cyan::Error("Snapshot block ended early: {} bytes were needed but {} were left",
+                                  n_bytes, std::size_t(end - cursor));
+            }
+            std::memcpy(out, cursor, n_bytes);
+            cursor += n_bytes;
+        }
+
+        /**
+         * Read a value written by SnapshotWriter::write().
+         */
+        template <typename T>
+        void read(T& value) {
+            if constexpr (std::is_same_v<T, std::string>) {
+                auto length = read_length(1);
+                value.assign(reinterpret_cast<const char*>(cursor), length);
+                cursor += length;
+            } else if constexpr (ecs_impl::IsStdVector<T>::value) {
+                auto length = read_length(1);
+                value.clear();
+                value.resize(length);
+                for (auto& element : value) {
+                    read(element);
+                }
+            } else if constexpr (ecs_impl::HasSnapshotSerializer<T>::value) {
+                value.deserialize(*this);
+            } else {
+                static_assert(std::is_trivially_copyable_v<T>, "Type can't be read from a snapshot. Give it a "
+                                                               "serializer (see is_snapshot_serializable).");
+                read_bytes(&value, sizeof(T));
+            }
+        }
+
+    private:
+        const unsigned char* cursor;
+        const unsigned char* end;
+
+        /**
+         * Internal function to read the length of a string or vector, checking that at least that many of the given
+         * minimum element size are left (so a corrupt length can't cause a huge allocation).
+         */
+        std::size_t read_length(std::size_t min_element_bytes) {
+            std::uint64_t length;
+            read_bytes(&length, sizeof(length));
+            if (length > std::uint64_t(end - cursor) / min_element_bytes) {
+                throw cyan::Error("Snapshot block ended early: a length of {} runs past the end", length);
+            }
+            return std::size_t(length);
+        }
+    };
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "cyan/src/engine/ecs/ecs_common.hpp"
+#include "cyan/src/logging/assert.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace cyan::ecs_impl {
+    /** SparseSet
+     * Maps ECS ids (typically entity ids) to values without hashing.
+     * The index bits of a key select a slot in a paged sparse array, which holds a position into two packed dense
+     * arrays (one of keys, one of values). Lookups are two array reads plus a comparison of the stored key against the
+     * requested key, which rejects stale generations. Pages of the sparse array are only allocated once a key with an
+     * index inside that page is inserted, so a small number of entities with large indices don't cost much memory.
+     * The dense arrays are always packed (removal swaps the last element into the hole), so they can be iterated
+     * directly.
+     * A sparse set holds at most one key per index - keys with the same index but a different generation share a slot.
+     * @tparam ValueT The type of value to associate with each key.
+     */
+    template <typename ValueT>
+    struct SparseSet {
+        /// Number of bits of the key index used to select a position within a page.
+        static constexpr EcsIndexT PAGE_BITS = 12;
+        static constexpr EcsIndexT PAGE_SIZE = EcsIndexT(1) << PAGE_BITS;
+        static constexpr EcsIndexT PAGE_MASK = PAGE_SIZE - 1;
+
+        SparseSet() = default;
+
+        SparseSet(const SparseSet& other)
+            : pages(other.pages.size()), dense_keys(other.dense_keys), dense_values(other.dense_values)
+        {
+            // Only the pages which have been allocated are copied.
+            for (std::size_t page = 0; page < pages.size(); page += 1) {
+                if (!other.pages[page]) continue;
+                pages[page] = std::make_unique<EcsIndexT[]>(PAGE_SIZE);
+                std::copy(other.pages[page].get(), other.pages[page].get() + PAGE_SIZE, pages[page].get());
+            }
+        }
+
+        SparseSet(SparseSet&&) noexcept = default;
+        SparseSet& operator=(SparseSet&&) noexcept = default;
+
+        /**
+         * Find the value associated with a key.
+         * @param key The key to look up.
+         * @return A pointer to the value, or nullptr if the key is not in the set (including if the slot for the key's
+         *         index is held by a different generation).
+         */
+        ValueT* find(EcsIdT key) {
+            auto position = find_position(key);
+            if (position == ECS_NULL_INDEX) return nullptr;
+            return &dense_values[position];
+        }
+        const ValueT* find(EcsIdT key) const {
+            auto position = find_position(key);
+            if (position == ECS_NULL_INDEX) return nullptr;
+            return &dense_values[position];
+        }
+
+        /**
+         * Test if a key is in the set.
+         */
+        [[nodiscard]]
+        bool contains(EcsIdT key) const {
+            return find_position(key) != ECS_NULL_INDEX;
+        }
+
+        /**
+         * Prefetch the sparse slot for a key, ahead of looking it up.
+         * @param key The key which will be looked up.
+         */
+        void prefetch(EcsIdT key) const {
+            auto index = get_index(key);
+            auto page = index >> PAGE_BITS;
+            if (page < pages.size() && pages[page]) ecs_impl::prefetch(&pages[page][index & PAGE_MASK]);
+        }
+
+        /**
+         * Prefetch the key and value stored for a key, ahead of looking it up. This reads the key's sparse slot, so
+         * prefetch() it a little earlier.
+         * @param key The key which will be looked up.
+         */
+        void prefetch_value(EcsIdT key) const {
+            auto position = sparse_position(get_index(key));
+            if (position == ECS_NULL_INDEX) return;
+            ecs_impl::prefetch(&dense_keys[position]);
+            ecs_impl::prefetch(&dense_values[position]);
+        }
+
+        /**
+         * Find whatever key currently occupies the slot for the given key's index, regardless of generation.
+         * @param key A key whose index should be checked.
+         * @return The key in the slot, or ECS_NULL_INDEX if the slot is empty.
+         */
+        [[nodiscard]]
+        EcsIdT find_occupant(EcsIdT key) const {
+            auto position = sparse_position(get_index(key));
+            if (position == ECS_NULL_INDEX) return ECS_NULL_INDEX;
+            return dense_keys[position];
+        }
+
+        /**
+         * Insert a key with an associated value.
+         * The slot for the key's index must be empty (see find_occupant()).
+         * @param key The key to insert.
+         * @param value The value to associate with the key.
+         * @return A reference to the stored value.
+         */
+        ValueT& insert(EcsIdT key, const ValueT& value) {
+            auto index = get_index(key);
+            auto& slot = sparse_slot(index);
+            CYAN_ASSERT(slot == ECS_NULL_INDEX);
+
+            slot = dense_keys.size();
+            dense_keys.push_back(key);
+            dense_values.push_back(value);
+            return dense_values.back();
+        }
+
+        /**
+         * Remove a key (and it's value) from the set. Does nothing if the key is not in the set.
+         * The last element of the dense arrays is moved into the removed element's position.
+         * @param key The key to remove.
+         */
+        void erase(EcsIdT key) {
+            auto position = find_position(key);
+            if (position == ECS_NULL_INDEX) return;
+
+            auto last_position = dense_keys.size() - 1;
+            if (position != last_position) {
+                dense_keys[position] = dense_keys[last_position];
+                dense_values[position] = std::move(dense_values[last_position]);
+                sparse_slot(get_index(dense_keys[position])) = position;
+            }
+            dense_keys.pop_back();
+            dense_values.pop_back();
+            sparse_slot(get_index(key)) = ECS_NULL_INDEX;
+        }
+
+        /**
+         * Reserve room in the dense arrays for a number of elements.
+         */
+        void reserve(std::size_t n) {
+            dense_keys.reserve(n);
+            dense_values.reserve(n);
+        }
+
+        /**
+         * Remove all elements. Allocated pages are kept for reuse.
+         */
+        void clear() {
+            for (auto key : dense_keys) {
+                sparse_slot(get_index(key)) = ECS_NULL_INDEX;
+            }
+            dense_keys.clear();
+            dense_values.clear();
+        }
+
+        /**
+         * Release unused memory: spare capacity in the dense arrays, and sparse pages that hold no elements.
+         */
+        void shrink_to_fit() {
+            std::vector<bool> page_used(pages.size(), false);
+            for (auto key : dense_keys) {
+                page_used[get_index(key) >> PAGE_BITS] = true;
+            }
+            for (std::size_t page = 0; page < pages.size(); page += 1) {
+                if (!page_used[page]) pages[page].reset();
+            }
+            while (!pages.empty() && !pages.back()) {
+                pages.pop_back();
+            }
+            pages.shrink_to_fit();
+            dense_keys.shrink_to_fit();
+            dense_values.shrink_to_fit();
+        }
+
+        /**
+         * Get the number of bytes allocated by the set, including unused capacity.
+         */
+        [[nodiscard]]
+        std::size_t memory_bytes() const {
+            return allocated_page_count() * PAGE_SIZE * sizeof(EcsIndexT)
+                   + pages.capacity() * sizeof(std::unique_ptr<EcsIndexT[]>)
+                   + dense_keys.capacity() * sizeof(EcsIdT)
+                   + dense_values.capacity() * sizeof(ValueT);
+        }
+
+        /**
+         * Get the number of pages of the sparse array which have been allocated (each covering PAGE_SIZE indices).
+         */
+        [[nodiscard]]
+        std::size_t allocated_page_count() const {
+            std::size_t n_pages = 0;
+            for (auto& page : pages) {
+                if (page) n_pages += 1;
+            }
+            return n_pages;
+        }
+
+        /**
+         * Get the number of elements in the set.
+         */
+        [[nodiscard]]
+        std::size_t size() const {
+            return dense_keys.size();
+        }
+
+        /// Packed array of keys, in the same order as values().
+        [[nodiscard]]
+        const std::vector<EcsIdT>& keys() const { return dense_keys; }
+
+        /// Packed array of values, in the same order as keys().
+        std::vector<ValueT>& values() { return dense_values; }
+        [[nodiscard]]
+        const std::vector<ValueT>& values() const { return dense_values; }
+
+    private:
+        std::vector<std::unique_ptr<EcsIndexT[]>> pages;
+        std::vector<EcsIdT> dense_keys;
+        std::vector<ValueT> dense_values;
+
+        /**
+         * Internal function to get the dense position for a key, or ECS_NULL_INDEX if it isn't in the set.
+         */
+        [[nodiscard]]
+        EcsIndexT find_position(EcsIdT key) const {
+            auto position = sparse_position(get_index(key));
+            if (position == ECS_NULL_INDEX || dense_keys[position] != key) return ECS_NULL_INDEX;
+            return position;
+        }
+
+        /**
+         * Internal function to read a sparse slot without allocating.
+         */
+        [[nodiscard]]
+        EcsIndexT sparse_position(EcsIndexT index) const {
+            auto page = index >> PAGE_BITS;
+            if (page >= pages.size() || !pages[page]) return ECS_NULL_INDEX;
+            return pages[page][index & PAGE_MASK];
+        }
+
+        /**
+         * Internal function to get a writable sparse slot, allocating it's page if necessary.
+         */
+        EcsIndexT& sparse_slot(EcsIndexT index) {
+            auto page = index >> PAGE_BITS;
+            if (page >= pages.size()) {
+                pages.resize(page + 1);
+            }
+            if (!pages[page]) {
+                pages[page] = std::make_unique<EcsIndexT[]>(PAGE_SIZE);
+                std::fill(pages[page].get(), pages[page].get() + PAGE_SIZE, ECS_NULL_INDEX);
+            }
+            return pages[page][index & PAGE_MASK];
+        }
+    };
+}
@@ -0,0 +1,68 @@
+/**
+ * The set of component types known at build time - those generated by codegen and listed in the X_COMPONENTS X-macro.
+ * ComponentMap stores the registries for these types directly (rather than looking them up at runtime), so accessing
+ * them compiles down to a member access.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "cyan/generated/components/components.hpp"
+#include "cyan/generated/components/components_x_list.hpp"
+
+namespace cyan::ecs_impl {
+    /// A std::tuple of every generated component type, in X_COMPONENTS order.
+    #define X(ComponentT) , std::declval<std::tuple<cyan::component::ComponentT>>()
+    using StaticComponentTypes = decltype(std::tuple_cat(std::tuple<>{} X_COMPONENTS));
+    #undef X
+
+    /// The number of generated component types.
+    constexpr std::size_t N_STATIC_COMPONENT_TYPES = std::tuple_size_v<StaticComponentTypes>;
+
+    /**
+     * Find the position of a type within a std::tuple of types.
+     * @tparam T The type to find.
+     * @tparam Tuple The std::tuple of types to search.
+     * `found` is whether T is in the tuple, and `value` is it's position (or the size of the tuple, if it isn't).
+     */
+    template <typename T, typename Tuple>
+    struct TupleTypeIndex;
+
+    template <typename T>
+    struct TupleTypeIndex<T, std::tuple<>> {
+        static constexpr bool found = false;
+        static constexpr std::size_t value = 0;
+    };
+
+    template <typename T, typename Head, typename ...Tail>
+    struct TupleTypeIndex<T, std::tuple<Head, Tail...>> {
+        using Next = TupleTypeIndex<T, std::tuple<Tail...>>;
+        static constexpr bool found = std::is_same_v<T, Head> || Next::found;
+        static constexpr std::size_t value = std::is_same_v<T, Head> ? 0 : 1 + Next::value;
+    };
+
+    /// Whether T is a generated component type.
+    template <typename T>
+    constexpr bool is_static_component_type = TupleTypeIndex<T, StaticComponentTypes>::found;
+
+    /// The position of a generated component type within StaticComponentTypes.
+    template <typename T>
+    constexpr std::size_t static_component_index = TupleTypeIndex<T, StaticComponentTypes>::value;
+
+    /**
+     * Transform a std::tuple of types into a std::tuple of some template applied to each type.
+     * e.g. MapTupleTypes<std::vector, std::tuple<int, float>>::type is
+     *      std::tuple<std::vector<int>, std::vector<float>>.
+     */
+    template <template <typename> typename F, typename Tuple>
+    struct MapTupleTypes;
+
+    template <template <typename> typename F, typename ...Ts>
+    struct MapTupleTypes<F, std::tuple<Ts...>> {
+        using type = std::tuple<F<Ts>...>;
+    };
+}
@@ -0,0 +1,142 @@
+#include "system_scheduler.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+using namespace cyan;
+
+namespace {
+    /// Test if two sorted vectors share an element.
+    bool intersects(const std::vector<int>& a, const std::vector<int>& b)
+    {
+        auto it_a = a.begin();
+        auto it_b = b.begin();
+        while (it_a != a.end() && it_b != b.end()) {
+            if (*it_a == *it_b) return true;
+            if (*it_a < *it_b) {
+                ++it_a;
+            } else {
+                ++it_b;
+            }
+        }
+        return false;
+    }
+}
+
+
+SystemScheduler::SystemBuilder& SystemScheduler::SystemBuilder::exclusive()
+{
+    scheduler->systems[index].exclusive = true;
+    return *this;
+}
+
+
+SystemScheduler::SystemScheduler(ECS& ecs, std::size_t n_threads)
+    : ecs(ecs), pool(n_threads)
+{}
+
+
+SystemScheduler::SystemBuilder SystemScheduler::add_system(const std::string& name, SystemFn fn)
+{
+    systems.push_back(System{name, std::move(fn), {}, {}, false});
+    return SystemBuilder(this, systems.size() - 1);
+}
+
+
+void SystemScheduler::run_frame()
+{
+    auto frame_start = std::chrono::steady_clock::now();
+    auto n_systems = systems.size();
+    last_frame_timings.assign(n_systems, SystemTiming{});
+
+    // Build the dependency graph for this frame: each system depends on every earlier system it conflicts with.
+    std::vector<std::vector<std::size_t>> dependents(n_systems);
+    std::vector<std::size_t> n_dependencies(n_systems, 0);
+    for (std::size_t later = 0; later < n_systems; later += 1) {
+        for (std::size_t earlier = 0; earlier < later; earlier += 1) {
+            if (conflicts(systems[earlier], systems[later])) {
+                dependents[earlier].push_back(later);
+                n_dependencies[later] += 1;
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable frame_finished;
+    std::size_t n_finished = 0;
+    std::exception_ptr first_error;
+
+    // Each system, once finished, submits whichever of it's dependents are now free to run.
+    std::function<void(std::size_t)> run_system = [&](std::size_t index) {
+        auto start = std::chrono::steady_clock::now();
+        std::exception_ptr error;
+        try {
+            systems[index].fn(ecs);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        auto duration = std::chrono::steady_clock::now() - start;
+
+        std::lock_guard lock(mutex);
+        last_frame_timings[index] = SystemTiming{
+            systems[index].name, std::chrono::duration_cast<std::chrono::nanoseconds>(duration)};
+        if (error && !first_error) first_error = error;
+        for (auto dependent : dependents[index]) {
+            n_dependencies[dependent] -= 1;
+            if (n_dependencies[dependent] == 0) {
+                pool.submit([&run_system, dependent]() { run_system(dependent); });
+            }
+        }
+        n_finished += 1;
+        if (n_finished == n_systems) frame_finished.notify_all();
+    };
+
+    {
+        std::unique_lock lock(mutex);
+        for (std::size_t index = 0; index < n_systems; index += 1) {
+            if (n_dependencies[index] == 0) {
+                pool.submit([&run_system, index]() { run_system(index); });
+            }
+        }
+        frame_finished.wait(lock, [&]() { return n_finished == n_systems; });
+    }
+    // The last system to finish may still be inside run_system() after notifying - wait for it to return before the
+    // frame's state goes out of scope.
+    pool.wait_idle();
+    ecs.flush_events();
+
+    last_frame_duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - frame_start);
+
+    if (first_error) std::rethrow_exception(first_error);
+}
+
+
+void SystemScheduler::log_timings() const
+{
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    LOG(INFO, "Frame took {:.3f} ms across {} systems on {} threads:",
+        Milliseconds(last_frame_duration).count(), systems.size(), pool.size());
+    for (auto& timing : last_frame_timings) {
+        LOG(INFO, "    {}: {:.3f} ms", timing.name, Milliseconds(timing.duration).count());
+    }
+}
+
+
+void SystemScheduler::add_access(System& system, int type_id, bool write)
+{
+    auto& access = write ? system.writes : system.reads;
+    auto position = std::lower_bound(access.begin(), access.end(), type_id);
+    if (position == access.end() || *position != type_id) {
+        access.insert(position, type_id);
+    }
+}
+
+
+bool SystemScheduler::conflicts(const System& a, const System& b)
+{
+    if (a.exclusive || b.exclusive) return true;
+    return intersects(a.writes, b.writes) || intersects(a.writes, b.reads) || intersects(a.reads, b.writes);
+}
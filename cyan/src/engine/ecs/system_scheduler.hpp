@@ -0,0 +1,166 @@
+/** system_scheduler.hpp
+ * Systems are functions that run over the ECS once per frame. Each system declares which component types it reads and
+ * which it writes, and the scheduler uses those declarations to run systems that don't conflict at the same time on a
+ * pool of worker threads.
+ *
+ * Two systems conflict if either writes a component type the other reads or writes. Conflicting systems always run in
+ * the order they were added to the scheduler. Systems that create or delete entities, or add or remove components,
+ * change the ECS's structure and must be declared exclusive, so that they never run alongside another system.
+ *
+ * Mutable access to a component marks it as changed, which writes to it's registry (see ECS::changed_since()), so a
+ * system which only declares that it reads a type must only access it immutably: through ecs.view<const T>(),
+ * par_each_const(), Entry::read() or a const Entry. Otherwise two readers of the type running at the same time race on
+ * the change tracking, even if neither modifies a component.
+ */
+
+#pragma once
+
+#include "ecs.hpp"
+#include "cyan/src/util/thread_pool.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace cyan {
+    /// A system, run once per frame by a SystemScheduler.
+    using SystemFn = std::function<void(ECS&)>;
+
+    /**
+     * How long a system took to run in the most recent frame.
+     */
+    struct SystemTiming {
+        std::string name;
+        std::chrono::nanoseconds duration;
+    };
+
+    /** SystemScheduler
+     * Runs registered systems over an ECS each frame, in parallel where their declared component access allows.
+     * Example usage:
+     *      SystemScheduler scheduler(ecs);
+     *      scheduler.add_system("movement", move_entities).reads<Velocity>().writes<Position>();
+     *      scheduler.add_system("spawner", spawn_entities).exclusive();
+     *      scheduler.run_frame();
+     *      scheduler.log_timings();
+     */
+    struct SystemScheduler {
+        /**
+         * Returned by add_system() to declare a system's component access via a fluent interface.
+         */
+        struct SystemBuilder {
+            /**
+             * Declare that the system reads components of the given types. It must only access them immutably (e.g.
+             * with ecs.view<const T>(), see the top of system_scheduler.hpp).
+             */
+            template <typename ...Ts>
+            SystemBuilder& reads() {
+                (scheduler->declare_access<Ts>(index, false), ...);
+                return *this;
+            }
+
+            /**
+             * Declare that the system writes (or reads and writes) components of the given types.
+             */
+            template <typename ...Ts>
+            SystemBuilder& writes() {
+                (scheduler->declare_access<Ts>(index, true), ...);
+                return *this;
+            }
+
+            /**
+             * Declare that the system changes the structure of the ECS (creates or deletes entities, or adds or removes
+             * components), so it can't run alongside any other system.
+             */
+            SystemBuilder& exclusive();
+
+        private:
+            SystemScheduler* scheduler;
+            std::size_t index;
+
+            SystemBuilder(SystemScheduler* scheduler, std::size_t index) : scheduler(scheduler), index(index) {}
+            friend SystemScheduler;
+        };
+
+        /**
+         * Create a scheduler.
+         * @param ecs The ECS that systems are run over.
+         * @param n_threads The number of worker threads. If 0, one thread per hardware thread is used.
+         */
+        explicit SystemScheduler(ECS& ecs, std::size_t n_threads = 0);
+
+        /**
+         * Add a system. Systems are run in the order they're added, except that systems which don't conflict may run
+         * at the same time.
+         * @param name The name of the system, used for timing output.
+         * @param fn The system itself.
+         * @return A SystemBuilder with which to declare the system's component access.
+         */
+        SystemBuilder add_system(const std::string& name, SystemFn fn);
+
+        /**
+         * Run every system once, returning when they've all finished. Component events recorded during the frame are
+         * then dispatched to their observers (see ECS::flush_events()).
+         * If any systems throw, the rest of the frame still runs, and the first exception is rethrown afterwards.
+         */
+        void run_frame();
+
+        /**
+         * Get how long each system took to run in the most recent frame, in the order the systems were added.
+         */
+        [[nodiscard]]
+        const std::vector<SystemTiming>& get_last_frame_timings() const { return last_frame_timings; }
+
+        /**
+         * Get the wall-clock time the most recent frame took to run.
+         */
+        [[nodiscard]]
+        std::chrono::nanoseconds get_last_frame_duration() const { return last_frame_duration; }
+
+        /**
+         * Log the time each system took in the most recent frame.
+         */
+        void log_timings() const;
+
+        /**
+         * Get the number of systems.
+         */
+        [[nodiscard]]
+        std::size_t size() const { return systems.size(); }
+
+    private:
+        struct System {
+            std::string name;
+            SystemFn fn;
+            /// Component type IDs, sorted and unique.
+            std::vector<int> reads;
+            std::vector<int> writes;
+            bool exclusive = false;
+        };
+
+        ECS& ecs;
+        ThreadPool pool;
+        std::vector<System> systems;
+        std::vector<SystemTiming> last_frame_timings;
+        std::chrono::nanoseconds last_frame_duration{0};
+
+        /**
+         * Internal function to record that a system accesses a component type.
+         * The type's component registry is created here if it doesn't exist yet, so systems running in parallel never
+         * have to create one.
+         */
+        template <typename T>
+        void declare_access(std::size_t index, bool write) {
+            ecs.get_component_registry<T>();
+            add_access(systems[index], ecs.get_component_type_id<T>().id, write);
+        }
+
+        static void add_access(System& system, int type_id, bool write);
+
+        /**
+         * Internal function to test if two systems can't run at the same time.
+         */
+        static bool conflicts(const System& a, const System& b);
+    };
+}
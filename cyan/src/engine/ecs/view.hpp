@@ -0,0 +1,256 @@
+#pragma once
+
+#include "archetype_storage.hpp"
+#include "entity.hpp"
+#include "single_component_registry.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cyan {
+    /** View
+     * Iterates over every (existing) entity that has a component of each of the types Ts, without building any
+     * intermediate containers.
+     * With per-type component registries (the default ECS storage), iteration walks the packed entity list of the
+     * smallest of the participating registries (chosen when the iteration begins) and probes the other registries for
+     * each entity. With archetype storage, iteration is a linear scan over the chunks of every archetype containing all
+     * of the types.
+     * Each step yields a std::tuple<Entity, Ts&...>, so views are best used with structured bindings:
+     *      for (auto [e, position, velocity] : ecs.view<Position, Velocity>()) {
+     *          position.x += velocity.x;
+     *      }
+     * Components can be modified freely during iteration, but adding or removing components of the participating types
+     * (or deleting entities) while iterating is not safe.
+     * Each component visited is marked as changed (see SingleComponentRegistry::changed_since()), unless it's type is
+     * given as const, e.g. ecs.view<Position, const Velocity>() only marks the Position components. Marking writes to
+     * the registry, so views which only read should always use const types (and must, for systems which only declare
+     * read access, see SystemScheduler).
+     * Obtain a View via ECS::view<Ts...>().
+     * @tparam Ts The component types an entity must have to be visited.
+     */
+    template <typename ...Ts>
+    struct View {
+        static_assert(sizeof...(Ts) > 0, "A View needs at least one component type");
+
+        /// The registry type for each component type (which is the same for const and non-const types).
+        template <typename T>
+        using RegistryT = SingleComponentRegistry<std::remove_const_t<T>>;
+
+        /// The value yielded for each matching entity.
+        using value_type = std::tuple<Entity, Ts&...>;
+
+        struct Iterator {
+            value_type operator*() const {
+                return std::apply(
+                        [this](Ts*... components) { return value_type{current_entity, *components...}; },
+                        current_components);
+            }
+
+            Iterator& operator++() {
+                position += 1;
+                seek();
+                return *this;
+            }
+
+            bool operator==(const Iterator& other) const {
+                if (at_end || other.at_end) return at_end == other.at_end;
+                return position == other.position && archetype == other.archetype && chunk == other.chunk;
+            }
+            bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+        private:
+            View* view;
+            bool at_end = false;
+            // Position within the driving registry's entity list, or the row within the current archetype chunk.
+            std::size_t position = 0;
+            // Archetype storage only: the current chunk.
+            std::size_t archetype = 0;
+            std::size_t chunk = 0;
+            bool has_chunk = false;
+            ecs_impl::ArchetypeChunkView chunk_view;
+            std::array<void*, sizeof...(Ts)> chunk_columns{};
+
+            Entity current_entity;
+            std::tuple<Ts*...> current_components;
+            std::array<EcsIndexT, sizeof...(Ts)> current_slots{};
+
+            Iterator(View* view, bool at_end) : view(view), at_end(at_end) {
+                if (!at_end) seek();
+            }
+
+            /**
+             * Advance until the iterator refers to an entity that exists and has all of the view's components (or the
+             * end is reached).
+             */
+            void seek() {
+                if (view->archetypes) {
+                    seek_archetype_chunks();
+                    return;
+                }
+                const auto& entity_ids = *view->driving_entity_ids;
+                for (; position < entity_ids.size(); position += 1) {
+                    current_entity = Entity{entity_ids[position]};
+                    if (view->probe(current_entity, current_components, current_slots)) return;
+                }
+                at_end = true;
+            }
+
+            void seek_archetype_chunks() {
+                while (!has_chunk || position >= chunk_view.count) {
+                    if (has_chunk) chunk += 1;
+                    has_chunk = view->archetypes->next_matching_chunk(
+                            view->type_ids.data(), sizeof...(Ts), archetype, chunk, chunk_view, chunk_columns.data());
+                    position = 0;
+                    if (!has_chunk) {
+                        at_end = true;
+                        return;
+                    }
+                }
+                current_entity = Entity{chunk_view.entity_ids[position]};
+                current_components = chunk_row(std::index_sequence_for<Ts...>{});
+            }
+
+            template <std::size_t ...Is>
+            std::tuple<Ts*...> chunk_row(std::index_sequence<Is...>) const {
+                return std::tuple<Ts*...>{static_cast<Ts*>(chunk_columns[Is]) + position...};
+            }
+
+            friend View;
+        };
+
+        /**
+         * Begin iteration. With per-type registries, the smallest participating registry is selected here.
+         */
+        Iterator begin() {
+            select_driving_registry();
+            return Iterator(this, false);
+        }
+
+        Iterator end() {
+            return Iterator(this, true);
+        }
+
+        /**
+         * Call a function for each matching entity.
+         * @param fn A function taking (Entity, Ts&...).
+         */
+        template <typename Fn>
+        void each(Fn&& fn) {
+            if (archetypes) {
+                each_archetype_chunk(fn, std::index_sequence_for<Ts...>{});
+                return;
+            }
+
+            select_driving_registry();
+            std::tuple<Ts*...> components;
+            std::array<EcsIndexT, sizeof...(Ts)> slots{};
+            const auto& entity_ids = *driving_entity_ids;
+            for (std::size_t position = 0; position < entity_ids.size(); position += 1) {
+                Entity e{entity_ids[position]};
+                if (!probe(e, components, slots)) continue;
+                std::apply([&](Ts*... component_ptrs) { fn(e, *component_ptrs...); }, components);
+            }
+        }
+
+        /**
+         * Get an upper bound on the number of entities this view will visit.
+         */
+        [[nodiscard]]
+        std::size_t size_hint() const {
+            if (archetypes) {
+                std::size_t smallest = archetypes->count(ecs_impl::ComponentTypeId{type_ids[0]});
+                for (auto type_id : type_ids) {
+                    smallest = std::min(smallest, archetypes->count(ecs_impl::ComponentTypeId{type_id}));
+                }
+                return smallest;
+            }
+            std::size_t smallest = std::get<0>(registries)->size();
+            std::apply([&](auto*... registry) {
+                ((smallest = std::min(smallest, registry->size())), ...);
+            }, registries);
+            return smallest;
+        }
+
+    private:
+        EntityRegistry* entities = nullptr;
+        std::tuple<RegistryT<Ts>*...> registries;
+        const std::vector<EcsIdT>* driving_entity_ids = nullptr;
+        // Archetype storage only.
+        ecs_impl::ArchetypeStorage* archetypes = nullptr;
+        std::array<int, sizeof...(Ts)> type_ids{};
+
+        /// Construct a view over per-type component registries.
+        View(EntityRegistry* entities, RegistryT<Ts>*... registries)
+            : entities(entities), registries(registries...) {}
+
+        /// Construct a view over archetype storage.
+        View(ecs_impl::ArchetypeStorage* archetypes, std::array<int, sizeof...(Ts)> type_ids)
+            : archetypes(archetypes), type_ids(type_ids) {}
+
+        /**
+         * Internal function to pick the registry with the fewest entities to drive iteration.
+         */
+        void select_driving_registry() {
+            if (archetypes || driving_entity_ids) return;
+            std::size_t smallest_size = 0;
+            auto consider = [&](auto* registry) {
+                if (!driving_entity_ids || registry->size() < smallest_size) {
+                    driving_entity_ids = &registry->entity_ids();
+                    smallest_size = registry->size();
+                }
+            };
+            std::apply([&](auto*... registry) { (consider(registry), ...); }, registries);
+        }
+
+        /**
+         * Internal function to look up all of an entity's components.
+         * Probing stops at the first registry which doesn't have a component for the entity. The non-const components
+         * are only marked as changed once all of them have been found, through the slots found by the probe.
+         * @return Whether the entity exists and has all of the components (in which case components and slots are
+         *         filled in).
+         */
+        bool probe(Entity e, std::tuple<Ts*...>& components, std::array<EcsIndexT, sizeof...(Ts)>& slots) {
+            if (!entities->get(e.id)) return false;
+            if (!probe_registries(e, components, slots, std::index_sequence_for<Ts...>{})) return false;
+            mark_changed(slots, std::index_sequence_for<Ts...>{});
+            return true;
+        }
+
+        template <std::size_t ...Is>
+        bool probe_registries(Entity e, std::tuple<Ts*...>& components, std::array<EcsIndexT, sizeof...(Ts)>& slots,
+                              std::index_sequence<Is...>) {
+            return ((std::get<Is>(components) = std::get<Is>(registries)->find(e, slots[Is])) && ...);
+        }
+
+        template <std::size_t ...Is>
+        void mark_changed(const std::array<EcsIndexT, sizeof...(Ts)>& slots, std::index_sequence<Is...>) {
+            ((std::is_const_v<Ts> ? void() : std::get<Is>(registries)->mark_changed_in_slot(slots[Is])), ...);
+        }
+
+        /**
+         * Internal function to run each() over archetype storage: a tight loop over the rows of each matching chunk.
+         */
+        template <typename Fn, std::size_t ...Is>
+        void each_archetype_chunk(Fn& fn, std::index_sequence<Is...>) {
+            std::size_t archetype = 0;
+            std::size_t chunk = 0;
+            ecs_impl::ArchetypeChunkView chunk_view;
+            std::array<void*, sizeof...(Ts)> columns{};
+            while (archetypes->next_matching_chunk(
+                    type_ids.data(), sizeof...(Ts), archetype, chunk, chunk_view, columns.data())) {
+                std::tuple<Ts*...> column_ptrs{static_cast<Ts*>(columns[Is])...};
+                for (std::size_t row = 0; row < chunk_view.count; row += 1) {
+                    fn(Entity{chunk_view.entity_ids[row]}, std::get<Is>(column_ptrs)[row]...);
+                }
+                chunk += 1;
+            }
+        }
+
+        friend struct ECS;
+    };
+}
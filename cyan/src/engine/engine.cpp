@@ -8,8 +8,7 @@ using namespace cyan;
 
 Engine EngineBuilder::create()
 {
-    // TODO
-    return Engine();
+    return Engine(*this);
 }
 
 
@@ -21,6 +20,13 @@ EngineBuilder& EngineBuilder::with_logger(cyan::LogVerbosity log_verbosity, std:
 }
 
 
+EngineBuilder& EngineBuilder::with_worker_threads(std::size_t n_threads)
+{
+    worker_threads = n_threads;
+    return *this;
+}
+
+
 EngineBuilder Engine::build_engine()
 {
     return EngineBuilder();
@@ -33,11 +39,19 @@ Engine::~Engine()
 }
 
 
-Engine::Engine()
+EcsTickT Engine::tick()
 {
+    return _ecs.advance_tick();
+}
+
+
+Engine::Engine(const EngineBuilder& builder)
+{
+    _ecs.set_worker_threads(builder.worker_threads);
+
     // Initialize the chai/cyan standard library contents.
     chai_add_cyan_stdlib(chai_engine);
-    chai_add_ecs_library(chai_engine);
+    chai_add_ecs_library(chai_engine, _ecs);
     chai_add_codegen_generated_library(chai_engine);
 
     LOG(INFO, "cyanengine initialized.");
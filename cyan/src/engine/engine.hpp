@@ -44,9 +44,20 @@ namespace cyan {
          */
         EngineBuilder& with_logger(cyan::LogVerbosity log_verbosity, std::ostream* output);
 
+        /**
+         * Set the number of worker threads the engine's ECS uses for parallel iteration (see
+         * ECS::set_worker_threads()). When running many engines in one process, each on it's own thread, a small
+         * number (e.g. 1) avoids every engine starting a thread per core.
+         * @param n_threads The number of worker threads, or 0 for one per hardware thread (the default).
+         * @return A reference to the EngineBuilder itself to allow fluent chaining of function calls.
+         */
+        EngineBuilder& with_worker_threads(std::size_t n_threads);
+
     private:
         EngineBuilder() = default;
         friend Engine;
+
+        std::size_t worker_threads = 0;
     };
 
     /** Engine
@@ -56,6 +67,9 @@ namespace cyan {
      *  - The chaiscript engine
      * Optional components:
      *  - A logger
+     * Engines share no state besides the logger (which is thread-safe), so a process can host any number of them, and
+     * each can be ticked on a thread of it's own. An engine itself must only be used from one thread at a time.
+     * Engines can't be copied or moved, as the script engine refers to the engine's ECS.
      */
     struct Engine: public GarbageCollectedContainer {
         /**
@@ -74,12 +88,21 @@ namespace cyan {
         /**
          * Get the underlying Entity-Component system.
          */
-//        ECS& ecs() {
-//            return ecs; // TODO: convert this from a global to use engine.ecs.<...>
-//        }
+        ECS& ecs() {
+            return _ecs;
+        }
 
         ~Engine();
 
+        Engine(const Engine&) = delete;
+        Engine& operator=(const Engine&) = delete;
+
+        /**
+         * Advance the engine by one tick.
+         * @return The ECS's new current tick (see ECS::advance_tick()).
+         */
+        EcsTickT tick();
+
         /**
          * Run a garbage collection cycle.
          * @param generator A random_device to select random elements
@@ -87,15 +110,17 @@ namespace cyan {
          *              and that many elements will be checked in each array).
          */
         void gc(std::random_device& generator, int iters) override {
-            //ecs.gc(generator, iters)
+            _ecs.gc(generator, iters);
             resource_manager.gc(generator, iters);
         }
 
     private:
-        Engine();
+        explicit Engine(const EngineBuilder& builder);
 
         friend EngineBuilder;
 
+        // The ECS is declared before the script engine, so it outlives the script functions bound to it.
+        ECS _ecs;
         ResourceManager resource_manager;
         ChaiEngine chai_engine;
     };
@@ -1,16 +1,33 @@
 #include "ecs_script.hpp"
 
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "cyan/generated/components/components.hpp"
 #include "cyan/generated/components/components_x_list.hpp"
 #include "cyan/generated/chai_bindings.hpp"
+#include "cyan/src/engine/systems/spatial_index_2d.hpp"
 #include "cyan/src/util/string.hpp"
 
 using namespace std::string_literals;
 using namespace cyan;
 using namespace cyan::component;
 
+namespace {
+    /**
+     * Wrap a script function taking a single entity as a component observer, which is called with batches of entities.
+     */
+    ComponentObserverFn make_script_observer(const std::function<void(Entity)>& fn)
+    {
+        return [fn](const std::vector<Entity>& batch) {
+            for (auto e : batch) {
+                fn(e);
+            }
+        };
+    }
+}
+
 
 void cyan::chai_add_ecs_library(cyan::ChaiEngine& chai_engine, cyan::ECS& ecs_object)
 {
@@ -28,6 +45,16 @@ void cyan::chai_add_ecs_library(cyan::ChaiEngine& chai_engine, cyan::ECS& ecs_ob
     m->add(chaiscript::fun(&ECS::new_entity, &ecs_object), "new_entity");
     m->add(chaiscript::fun(&ECS::delete_entity, &ecs_object), "delete_entity");
     m->add(chaiscript::fun(&ECS::exists, &ecs_object), "entity_exists");
+    m->add(chaiscript::fun(&ECS::flush_events, &ecs_object), "flush_component_events");
+
+    // Observers are removed with the ID their on_add_/on_remove_/on_change_ function returned.
+    chaiscript::utility::add_class<ObserverId>(
+            *m,
+            "ObserverId",
+            {chaiscript::constructor<ObserverId()>(), chaiscript::constructor<ObserverId(const ObserverId &)>() },
+            {{chaiscript::fun(&ObserverId::operator bool), "is_valid"}}
+    );
+    m->add(chaiscript::fun(&ECS::unobserve, &ecs_object), "remove_component_observer");
 
     // TODO: We can't easily add each component member to chai without writing them all out here.
     //       Consider moving chai initialization into an autogenerated function.
@@ -50,6 +77,22 @@ void cyan::chai_add_ecs_library(cyan::ChaiEngine& chai_engine, cyan::ECS& ecs_ob
                 chaiscript::fun( \
                         static_cast<RemoveComponentFnPtrT>(&ECS::remove_component<ComponentT>), &ecs_object), \
                 "remove_" + string_util::to_snake_case(#ComponentT) + "_component"); \
+        /* Observers are called with each entity of a batch in turn (see ECS::on_add()) */\
+        m->add( \
+                chaiscript::fun([&ecs_object](const std::function<void(Entity)>& fn) { \
+                    return ecs_object.on_add<ComponentT>(make_script_observer(fn)); \
+                }), \
+                "on_add_" + string_util::to_snake_case(#ComponentT) + "_component"); \
+        m->add( \
+                chaiscript::fun([&ecs_object](const std::function<void(Entity)>& fn) { \
+                    return ecs_object.on_remove<ComponentT>(make_script_observer(fn)); \
+                }), \
+                "on_remove_" + string_util::to_snake_case(#ComponentT) + "_component"); \
+        m->add( \
+                chaiscript::fun([&ecs_object](const std::function<void(Entity)>& fn) { \
+                    return ecs_object.on_change<ComponentT>(make_script_observer(fn)); \
+                }), \
+                "on_change_" + string_util::to_snake_case(#ComponentT) + "_component"); \
         /* Add entry class information */\
         chaiscript::utility::add_class<ComponentEntry<ComponentT>>(*m, \
             std::string(#ComponentT) + "ComponentEntry", \
@@ -60,6 +103,7 @@ void cyan::chai_add_ecs_library(cyan::ChaiEngine& chai_engine, cyan::ECS& ecs_ob
                     {chaiscript::fun(&ComponentEntry<ComponentT>::value), "value" }, \
                     {chaiscript::fun(&ComponentEntry<ComponentT>::operator bool), "is_valid" }, \
                     {chaiscript::fun(&ComponentEntry<ComponentT>::get), "get" }, \
+                    {chaiscript::fun(&ComponentEntry<ComponentT>::read), "read" }, \
                 } \
             ); \
     }
@@ -68,3 +112,32 @@ void cyan::chai_add_ecs_library(cyan::ChaiEngine& chai_engine, cyan::ECS& ecs_ob
 
     chai.add(m);
 }
+
+
+void cyan::chai_add_spatial_index_library(cyan::ChaiEngine& chai_engine, cyan::SpatialIndex2D& spatial_index)
+{
+    auto& chai = chai_engine.get_chai_object();
+    chaiscript::ModulePtr m = chaiscript::ModulePtr(new chaiscript::Module());
+
+    // Queries return a new vector of entities, rather than appending to one, which is more natural in script.
+    chaiscript::bootstrap::standard_library::vector_type<std::vector<Entity>>("EntityVector", *m);
+    m->add(chaiscript::fun([&spatial_index](float min_x, float min_y, float max_x, float max_y) {
+        std::vector<Entity> found;
+        spatial_index.query_rect(min_x, min_y, max_x, max_y, found);
+        return found;
+    }), "entities_in_rect");
+    m->add(chaiscript::fun([&spatial_index](float x, float y, float radius) {
+        std::vector<Entity> found;
+        spatial_index.query_radius(x, y, radius, found);
+        return found;
+    }), "entities_in_radius");
+    m->add(chaiscript::fun([&spatial_index](float x, float y, int k) {
+        std::vector<Entity> found;
+        if (k > 0) spatial_index.query_nearest(x, y, std::size_t(k), found);
+        return found;
+    }), "nearest_entities");
+    m->add(chaiscript::fun(&SpatialIndex2D::update, &spatial_index), "update_spatial_index");
+    m->add(chaiscript::fun(&SpatialIndex2D::rebuild, &spatial_index), "rebuild_spatial_index");
+
+    chai.add(m);
+}
@@ -1,16 +1,25 @@
 #pragma once
 
 #include "cyan/src/engine/ecs/ecs.hpp"
-#include "cyan/src/engine/ecs/ecs_global.hpp"
 #include "chai_engine.hpp"
 
 namespace cyan {
+    struct SpatialIndex2D;
+
     /**
      * Register core ECS functions into the chai script engine.
      * @param chai_engine The ChaiEngine script engine object to add ECS functions to
-     * @param ecs_object The ECS object for the functions to operate on. Defaults to the global ECS object.
+     * @param ecs_object The ECS object for the functions to operate on (e.g. Engine::ecs(), or cyan::ecs::global_ecs),
+     *                   which must outlive the chai engine.
+     */
+    extern void chai_add_ecs_library(cyan::ChaiEngine& chai_engine, ECS& ecs_object);
+
+    /**
+     * Register spatial queries into the chai script engine: entities_in_rect(min_x, min_y, max_x, max_y),
+     * entities_in_radius(x, y, radius) and nearest_entities(x, y, k), each returning an EntityVector, along with
+     * update_spatial_index() and rebuild_spatial_index().
+     * @param chai_engine The ChaiEngine script engine object to add the functions to
+     * @param spatial_index The spatial index for the functions to query, which must outlive the chai engine.
      */
-    extern void chai_add_ecs_library(
-            cyan::ChaiEngine& chai_engine,
-            ECS& ecs_object = cyan::ecs::global_ecs);
+    extern void chai_add_spatial_index_library(cyan::ChaiEngine& chai_engine, SpatialIndex2D& spatial_index);
 }
\ No newline at end of file
@@ -0,0 +1,371 @@
+#include "spatial_index_2d.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+using namespace cyan;
+using namespace cyan::component;
+
+namespace {
+    /// Cell coordinates are clamped to this range, so ranges and rings of cells can't overflow.
+    constexpr std::int32_t MAX_CELL_COORDINATE = std::int32_t(1) << 30;
+}
+
+
+SpatialHashGrid2D::SpatialHashGrid2D(float cell_size)
+    : cell_size(cell_size), inverse_cell_size(1.0f / cell_size)
+{
+    if (!(cell_size > 0.0f)) {
+        throw cyan::Error("Spatial hash grid cell size must be positive, got {}", cell_size);
+    }
+}
+
+
+void SpatialHashGrid2D::insert(Entity e, float x, float y)
+{
+    auto index = ecs_impl::get_index(e.id);
+    if (index >= records.size()) records.resize(index + 1);
+    auto key = cell_key(cell_coordinate(x), cell_coordinate(y));
+
+    auto& record = records[index];
+    if (record.id == e.id && record.cell == key) {
+        // Moving within a cell is just a new position.
+        auto& point = cells[key][record.slot];
+        point.x = x;
+        point.y = y;
+        return;
+    }
+    if (record.id != ECS_NULL_INDEX) {
+        // Either the entity is changing cell, or an older generation of it's slot was never removed.
+        remove_from_cell(record.cell, record.slot);
+        if (record.id != e.id) n_points -= 1;
+    }
+    if (record.id != e.id) n_points += 1;
+
+    auto& cell = cells[key];
+    record = Record{e.id, key, std::uint32_t(cell.size())};
+    cell.push_back(CellPoint{e, x, y});
+}
+
+
+bool SpatialHashGrid2D::remove(Entity e)
+{
+    if (!find_record(e)) return false;
+    auto& record = records[ecs_impl::get_index(e.id)];
+    remove_from_cell(record.cell, record.slot);
+    record = Record{};
+    n_points -= 1;
+    return true;
+}
+
+
+bool SpatialHashGrid2D::contains(Entity e) const
+{
+    return find_record(e) != nullptr;
+}
+
+
+std::size_t SpatialHashGrid2D::size() const
+{
+    return n_points;
+}
+
+
+float SpatialHashGrid2D::get_cell_size() const
+{
+    return cell_size;
+}
+
+
+void SpatialHashGrid2D::clear()
+{
+    cells.clear();
+    records.clear();
+    n_points = 0;
+}
+
+
+void SpatialHashGrid2D::rebuild(const std::vector<SpatialPoint2D>& points)
+{
+    clear();
+
+    // Give each entity a record pointing at it's last point, temporarily using the slot as the point's position in the
+    // batch, and sort the surviving points by cell so each cell can be filled in one go.
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> by_cell;
+    by_cell.reserve(points.size());
+    for (std::size_t i = 0; i < points.size(); i += 1) {
+        auto index = ecs_impl::get_index(points[i].entity.id);
+        if (index >= records.size()) records.resize(index + 1);
+        auto key = cell_key(cell_coordinate(points[i].x), cell_coordinate(points[i].y));
+        records[index] = Record{points[i].entity.id, key, std::uint32_t(i)};
+    }
+    for (std::size_t i = 0; i < points.size(); i += 1) {
+        auto& record = records[ecs_impl::get_index(points[i].entity.id)];
+        if (record.slot == i) by_cell.emplace_back(record.cell, std::uint32_t(i));
+    }
+    std::sort(by_cell.begin(), by_cell.end());
+
+    cells.reserve(by_cell.size() / 4 + 1);
+    for (std::size_t first = 0; first < by_cell.size();) {
+        auto key = by_cell[first].first;
+        auto last = first;
+        while (last < by_cell.size() && by_cell[last].first == key) last += 1;
+
+        auto& cell = cells[key];
+        cell.reserve(last - first);
+        for (auto i = first; i < last; i += 1) {
+            auto& point = points[by_cell[i].second];
+            records[ecs_impl::get_index(point.entity.id)].slot = std::uint32_t(cell.size());
+            cell.push_back(CellPoint{point.entity, point.x, point.y});
+        }
+        first = last;
+    }
+    n_points = by_cell.size();
+}
+
+
+template <typename Fn>
+void SpatialHashGrid2D::for_each_point_in_cells(std::int32_t min_x, std::int32_t min_y,
+                                                std::int32_t max_x, std::int32_t max_y, Fn&& fn) const
+{
+    if (max_x < min_x || max_y < min_y) return;
+    auto n_range_cells = std::uint64_t(std::int64_t(max_x) - min_x + 1)
+            * std::uint64_t(std::int64_t(max_y) - min_y + 1);
+    if (n_range_cells > cells.size()) {
+        for (auto& [key, cell] : cells) {
+            auto cell_x = std::int32_t(std::uint32_t(key >> 32));
+            auto cell_y = std::int32_t(std::uint32_t(key));
+            if (cell_x < min_x || cell_x > max_x || cell_y < min_y || cell_y > max_y) continue;
+            for (auto& point : cell) {
+                fn(point);
+            }
+        }
+        return;
+    }
+    for (auto cell_y = min_y; cell_y <= max_y; cell_y += 1) {
+        for (auto cell_x = min_x; cell_x <= max_x; cell_x += 1) {
+            auto cell = cells.find(cell_key(cell_x, cell_y));
+            if (cell == cells.end()) continue;
+            for (auto& point : cell->second) {
+                fn(point);
+            }
+        }
+    }
+}
+
+
+void SpatialHashGrid2D::query_rect(float min_x, float min_y, float max_x, float max_y, std::vector<Entity>& out) const
+{
+    for_each_point_in_cells(cell_coordinate(min_x), cell_coordinate(min_y),
+                            cell_coordinate(max_x), cell_coordinate(max_y),
+                            [&](const CellPoint& point) {
+        if (point.x >= min_x && point.x <= max_x && point.y >= min_y && point.y <= max_y) {
+            out.push_back(point.entity);
+        }
+    });
+}
+
+
+void SpatialHashGrid2D::query_radius(float x, float y, float radius, std::vector<Entity>& out) const
+{
+    if (!(radius >= 0.0f)) return;
+    auto radius_squared = radius * radius;
+    for_each_point_in_cells(cell_coordinate(x - radius), cell_coordinate(y - radius),
+                            cell_coordinate(x + radius), cell_coordinate(y + radius),
+                            [&](const CellPoint& point) {
+        auto dx = point.x - x;
+        auto dy = point.y - y;
+        if (dx * dx + dy * dy <= radius_squared) out.push_back(point.entity);
+    });
+}
+
+
+void SpatialHashGrid2D::query_nearest(float x, float y, std::size_t k, std::vector<Entity>& out) const
+{
+    if (k == 0 || n_points == 0) return;
+
+    // The best points found so far, as a max-heap on squared distance, so the worst of them is at the front.
+    using Candidate = std::pair<float, Entity>;
+    auto nearer = [](const Candidate& a, const Candidate& b) { return a.first < b.first; };
+    std::vector<Candidate> best;
+    best.reserve(std::min(k, n_points) + 1);
+    auto consider = [&](const CellPoint& point) {
+        auto dx = point.x - x;
+        auto dy = point.y - y;
+        auto distance_squared = dx * dx + dy * dy;
+        if (best.size() == k && !(distance_squared < best.front().first)) return;
+        best.emplace_back(distance_squared, point.entity);
+        std::push_heap(best.begin(), best.end(), nearer);
+        if (best.size() > k) {
+            std::pop_heap(best.begin(), best.end(), nearer);
+            best.pop_back();
+        }
+    };
+    auto consider_cell = [&](std::int64_t cell_x, std::int64_t cell_y) {
+        auto cell = cells.find(cell_key(std::int32_t(cell_x), std::int32_t(cell_y)));
+        if (cell == cells.end()) return;
+        for (auto& point : cell->second) {
+            consider(point);
+        }
+    };
+
+    std::int64_t center_x = cell_coordinate(x);
+    std::int64_t center_y = cell_coordinate(y);
+    for (std::int64_t ring = 0;; ring += 1) {
+        // Every point in this ring or beyond is at least (ring - 1) cells away, so once that's further than the worst
+        // of a full set of candidates, nothing closer is left.
+        if (best.size() == k && ring > 0) {
+            auto reach = double(ring - 1) * cell_size;
+            if (reach * reach > best.front().first) break;
+        }
+        // Once the rings are larger than the set of occupied cells, it's quicker to check the rest of them directly.
+        if (std::uint64_t(8 * ring) > cells.size()) {
+            for (auto& [key, cell] : cells) {
+                std::int64_t cell_x = std::int32_t(std::uint32_t(key >> 32));
+                std::int64_t cell_y = std::int32_t(std::uint32_t(key));
+                if (std::max(std::abs(cell_x - center_x), std::abs(cell_y - center_y)) < ring) continue;
+                for (auto& point : cell) {
+                    consider(point);
+                }
+            }
+            break;
+        }
+        if (ring == 0) {
+            consider_cell(center_x, center_y);
+            continue;
+        }
+        for (auto cell_x = center_x - ring; cell_x <= center_x + ring; cell_x += 1) {
+            consider_cell(cell_x, center_y - ring);
+            consider_cell(cell_x, center_y + ring);
+        }
+        for (auto cell_y = center_y - ring + 1; cell_y < center_y + ring; cell_y += 1) {
+            consider_cell(center_x - ring, cell_y);
+            consider_cell(center_x + ring, cell_y);
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), nearer);
+    for (auto& candidate : best) {
+        out.push_back(candidate.second);
+    }
+}
+
+
+std::int32_t SpatialHashGrid2D::cell_coordinate(float position) const
+{
+    auto cell = std::floor(position * inverse_cell_size);
+    // Written so NaN positions end up at the lower bound.
+    if (!(cell > float(-MAX_CELL_COORDINATE))) return -MAX_CELL_COORDINATE;
+    if (cell > float(MAX_CELL_COORDINATE)) return MAX_CELL_COORDINATE;
+    return std::int32_t(cell);
+}
+
+
+std::uint64_t SpatialHashGrid2D::cell_key(std::int32_t cell_x, std::int32_t cell_y)
+{
+    return (std::uint64_t(std::uint32_t(cell_x)) << 32) | std::uint32_t(cell_y);
+}
+
+
+const SpatialHashGrid2D::Record* SpatialHashGrid2D::find_record(Entity e) const
+{
+    auto index = ecs_impl::get_index(e.id);
+    if (index >= records.size() || records[index].id != e.id) return nullptr;
+    return &records[index];
+}
+
+
+void SpatialHashGrid2D::remove_from_cell(std::uint64_t key, std::uint32_t slot)
+{
+    auto cell = cells.find(key);
+    auto& points = cell->second;
+    if (slot + 1 != points.size()) {
+        points[slot] = points.back();
+        records[ecs_impl::get_index(points[slot].entity.id)].slot = slot;
+    }
+    points.pop_back();
+    if (points.empty()) cells.erase(cell);
+}
+
+
+SpatialIndex2D::SpatialIndex2D(ECS& ecs, float cell_size)
+    : ecs(ecs), grid(cell_size)
+{
+    auto on_touched = [this](const std::vector<Entity>& batch) {
+        touched.insert(touched.end(), batch.begin(), batch.end());
+    };
+    observers.push_back(ecs.on_add<WorldTransform2D>(on_touched));
+    observers.push_back(ecs.on_remove<WorldTransform2D>(on_touched));
+    observers.push_back(ecs.on_change<WorldTransform2D>(on_touched));
+}
+
+
+SpatialIndex2D::~SpatialIndex2D()
+{
+    for (auto observer : observers) {
+        ecs.unobserve(observer);
+    }
+}
+
+
+std::size_t SpatialIndex2D::update()
+{
+    if (needs_rebuild) return rebuild();
+
+    ecs.flush_events();
+    auto registry = ecs.get_component_registry<WorldTransform2D>();
+    for (auto e : touched) {
+        auto world = ecs.exists(e) ? registry->find(e) : nullptr;
+        if (world) {
+            grid.insert(e, world->tx, world->ty);
+        } else {
+            grid.remove(e);
+        }
+    }
+    auto n_updated = touched.size();
+    touched.clear();
+    return n_updated;
+}
+
+
+std::size_t SpatialIndex2D::rebuild()
+{
+    ecs.flush_events();
+    touched.clear();
+    needs_rebuild = false;
+
+    auto registry = ecs.get_component_registry<WorldTransform2D>();
+    std::vector<SpatialPoint2D> points;
+    points.reserve(registry->size());
+    registry->for_each_in_range(0, registry->slot_count(), [&](Entity e, const WorldTransform2D& world) {
+        if (ecs.exists(e)) points.push_back(SpatialPoint2D{e, world.tx, world.ty});
+    });
+    grid.rebuild(points);
+    return grid.size();
+}
+
+
+void SpatialIndex2D::query_rect(float min_x, float min_y, float max_x, float max_y, std::vector<Entity>& out) const
+{
+    grid.query_rect(min_x, min_y, max_x, max_y, out);
+}
+
+
+void SpatialIndex2D::query_radius(float x, float y, float radius, std::vector<Entity>& out) const
+{
+    grid.query_radius(x, y, radius, out);
+}
+
+
+void SpatialIndex2D::query_nearest(float x, float y, std::size_t k, std::vector<Entity>& out) const
+{
+    grid.query_nearest(x, y, k, out);
+}
+
+
+const SpatialHashGrid2D& SpatialIndex2D::get_grid() const
+{
+    return grid;
+}
@@ -0,0 +1,216 @@
+/**
+ * Spatial queries over entity positions.
+ * SpatialHashGrid2D is a standalone index of points keyed by entity, and SpatialIndex2D keeps one in sync with the
+ * positions (WorldTransform2D translations) of the entities in an ECS.
+ */
+
+#pragma once
+
+#include "cyan/src/engine/ecs/ecs.hpp"
+#include "cyan/generated/components/components.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace cyan {
+    /// An entity's position, as given to SpatialHashGrid2D::rebuild().
+    struct SpatialPoint2D {
+        Entity entity;
+        float x = 0.0f;
+        float y = 0.0f;
+    };
+
+    /// The default width and height of a SpatialHashGrid2D cell, in world units.
+    constexpr float DEFAULT_SPATIAL_CELL_SIZE = 64.0f;
+
+    /** SpatialHashGrid2D
+     * A uniform grid of square cells over the plane, holding a point for each entity. Only occupied cells are stored
+     * (in a hash map keyed by cell coordinates), so the world can be unbounded and sparse.
+     * Each cell holds it's points contiguously, so queries read positions without touching the ECS. Moving an entity
+     * within it's cell just overwrites it's position, and moving it between cells is a swap-remove and an append, so
+     * incremental updates are O(1).
+     * Queries append matching entities to an output vector, and aren't in any particular order (except for
+     * query_nearest(), which is sorted by distance). A cell size of around the typical query radius works best.
+     */
+    struct SpatialHashGrid2D {
+        /**
+         * Create an empty grid.
+         * @param cell_size The width and height of each cell, which must be positive.
+         */
+        explicit SpatialHashGrid2D(float cell_size = DEFAULT_SPATIAL_CELL_SIZE);
+
+        /**
+         * Set the position of an entity, adding it if it isn't in the grid.
+         */
+        void insert(Entity e, float x, float y);
+
+        /**
+         * Remove an entity from the grid.
+         * @return Whether the entity was in the grid.
+         */
+        bool remove(Entity e);
+
+        /**
+         * Check whether an entity is in the grid.
+         */
+        [[nodiscard]]
+        bool contains(Entity e) const;
+
+        /**
+         * Get the number of entities in the grid.
+         */
+        [[nodiscard]]
+        std::size_t size() const;
+
+        /**
+         * Get the width and height of each cell.
+         */
+        [[nodiscard]]
+        float get_cell_size() const;
+
+        /**
+         * Remove every entity from the grid.
+         */
+        void clear();
+
+        /**
+         * Replace the contents of the grid with a batch of points. This is much faster than inserting them one at a
+         * time, as each cell is allocated once at it's final size.
+         * @param points The new contents. If an entity appears more than once, it's last position is used.
+         */
+        void rebuild(const std::vector<SpatialPoint2D>& points);
+
+        /**
+         * Find the entities inside an axis-aligned rectangle (including it's edges).
+         * @param out The vector to append the entities to.
+         */
+        void query_rect(float min_x, float min_y, float max_x, float max_y, std::vector<Entity>& out) const;
+
+        /**
+         * Find the entities within a distance of a point (including those exactly at that distance).
+         * @param out The vector to append the entities to.
+         */
+        void query_radius(float x, float y, float radius, std::vector<Entity>& out) const;
+
+        /**
+         * Find the k entities closest to a point, searching outwards from it's cell ring by ring.
+         * @param k The number of entities to find. Fewer are found if the grid holds fewer than k.
+         * @param out The vector to append the entities to, nearest first.
+         */
+        void query_nearest(float x, float y, std::size_t k, std::vector<Entity>& out) const;
+
+    private:
+        /// A point stored in a cell.
+        struct CellPoint {
+            Entity entity;
+            float x;
+            float y;
+        };
+        /// Where an entity is in the grid, indexed by entity index.
+        struct Record {
+            EcsIdT id = ECS_NULL_INDEX;
+            std::uint64_t cell = 0;
+            std::uint32_t slot = 0;
+        };
+
+        float cell_size;
+        float inverse_cell_size;
+        std::unordered_map<std::uint64_t, std::vector<CellPoint>> cells;
+        std::vector<Record> records;
+        std::size_t n_points = 0;
+
+        /**
+         * Internal function to get the cell coordinate of a position along one axis, clamped to the grid's range.
+         */
+        std::int32_t cell_coordinate(float position) const;
+
+        /**
+         * Internal function to get the hash map key of a cell.
+         */
+        static std::uint64_t cell_key(std::int32_t cell_x, std::int32_t cell_y);
+
+        /**
+         * Internal function to get the record of an entity, or nullptr if it isn't in the grid.
+         */
+        const Record* find_record(Entity e) const;
+
+        /**
+         * Internal function to swap-remove the point at a slot of a cell, fixing the record of the point moved into it.
+         */
+        void remove_from_cell(std::uint64_t key, std::uint32_t slot);
+
+        /**
+         * Internal function to call fn with every stored point in a range of cells. When the range covers more cells
+         * than are occupied, the occupied cells are filtered instead of looking up every cell in the range.
+         */
+        template <typename Fn>
+        void for_each_point_in_cells(std::int32_t min_x, std::int32_t min_y, std::int32_t max_x, std::int32_t max_y,
+                                     Fn&& fn) const;
+    };
+
+    /** SpatialIndex2D
+     * Keeps a SpatialHashGrid2D of the position of every entity with a WorldTransform2D (it's tx and ty), so the
+     * entities in an area can be found without scanning every component.
+     * The index follows additions, removals and changes to WorldTransform2D through the ECS's batched component
+     * observers (see ECS::on_change()), and applies them incrementally in update(). When most entities have moved
+     * (e.g. on the first update, or after loading a level) rebuild() is faster. Queries see the positions as of the
+     * last update() or rebuild().
+     * The index observes components of the ECS (and stops when it's destroyed), so it can't be copied or moved, and
+     * must not outlive the ECS. It's usually updated straight after TransformPropagation2D, e.g.
+     *      scheduler.add_system("transforms", [&](ECS&) { transforms.update(); spatial_index.update(); }).exclusive();
+     */
+    struct SpatialIndex2D {
+        /**
+         * Start indexing the entities of an ECS. The index starts empty, with every existing entity waiting for the
+         * next update().
+         * @param ecs The ECS, which must use the default (per-type registry) storage.
+         * @param cell_size The width and height of each grid cell.
+         */
+        explicit SpatialIndex2D(ECS& ecs, float cell_size = DEFAULT_SPATIAL_CELL_SIZE);
+
+        ~SpatialIndex2D();
+
+        SpatialIndex2D(const SpatialIndex2D&) = delete;
+        SpatialIndex2D& operator=(const SpatialIndex2D&) = delete;
+
+        /**
+         * Apply the moves, additions and removals since the last update. This is a flush point for the ECS's component
+         * events (see ECS::flush_events()).
+         * @return The number of additions, removals and moves applied.
+         */
+        std::size_t update();
+
+        /**
+         * Rebuild the whole index from the current WorldTransform2D components, in one batch.
+         * @return The number of entities in the index.
+         */
+        std::size_t rebuild();
+
+        /// See SpatialHashGrid2D::query_rect().
+        void query_rect(float min_x, float min_y, float max_x, float max_y, std::vector<Entity>& out) const;
+
+        /// See SpatialHashGrid2D::query_radius().
+        void query_radius(float x, float y, float radius, std::vector<Entity>& out) const;
+
+        /// See SpatialHashGrid2D::query_nearest().
+        void query_nearest(float x, float y, std::size_t k, std::vector<Entity>& out) const;
+
+        /**
+         * Get the underlying grid.
+         */
+        [[nodiscard]]
+        const SpatialHashGrid2D& get_grid() const;
+
+    private:
+        ECS& ecs;
+        SpatialHashGrid2D grid;
+        /// The observers added to the ECS, removed again on destruction.
+        std::vector<ObserverId> observers;
+        /// Whether every entity needs re-indexing, as none have been indexed yet.
+        bool needs_rebuild = true;
+        /// Entities whose WorldTransform2D was added, removed or changed since the last update().
+        std::vector<Entity> touched;
+    };
+}
@@ -0,0 +1,241 @@
+#include "transform_2d.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cyan;
+using namespace cyan::component;
+
+
+WorldTransform2D cyan::to_matrix(const LocalTransform2D& local)
+{
+    auto cos = std::cos(local.rotation);
+    auto sin = std::sin(local.rotation);
+    return WorldTransform2D(cos * local.scale_x, sin * local.scale_x,
+                            -sin * local.scale_y, cos * local.scale_y,
+                            local.x, local.y);
+}
+
+
+WorldTransform2D cyan::compose(const WorldTransform2D& outer, const WorldTransform2D& inner)
+{
+    return WorldTransform2D(outer.a * inner.a + outer.c * inner.b,
+                            outer.b * inner.a + outer.d * inner.b,
+                            outer.a * inner.c + outer.c * inner.d,
+                            outer.b * inner.c + outer.d * inner.d,
+                            outer.a * inner.tx + outer.c * inner.ty + outer.tx,
+                            outer.b * inner.tx + outer.d * inner.ty + outer.ty);
+}
+
+
+TransformPropagation2D::TransformPropagation2D(ECS& ecs)
+    : ecs(ecs)
+{
+    auto on_hierarchy_changed = [this](const std::vector<Entity>&) { hierarchy_changed = true; };
+    observers.push_back(ecs.on_add<LocalTransform2D>(on_hierarchy_changed));
+    observers.push_back(ecs.on_remove<LocalTransform2D>(on_hierarchy_changed));
+    observers.push_back(ecs.on_add<Parent>(on_hierarchy_changed));
+    observers.push_back(ecs.on_remove<Parent>(on_hierarchy_changed));
+    // Parents are often written without being changed, so they're checked against the order in update().
+    observers.push_back(ecs.on_change<Parent>([this](const std::vector<Entity>& batch) {
+        changed_parents.insert(changed_parents.end(), batch.begin(), batch.end());
+    }));
+    observers.push_back(ecs.on_change<LocalTransform2D>([this](const std::vector<Entity>& batch) {
+        changed_locals.insert(changed_locals.end(), batch.begin(), batch.end());
+    }));
+}
+
+
+TransformPropagation2D::~TransformPropagation2D()
+{
+    for (auto observer : observers) {
+        ecs.unobserve(observer);
+    }
+}
+
+
+std::size_t TransformPropagation2D::update()
+{
+    ecs.flush_events();
+    for (std::size_t i = 0; i < changed_parents.size() && !hierarchy_changed; i += 1) {
+        hierarchy_changed = parent_changed(changed_parents[i]);
+    }
+    changed_parents.clear();
+    if (hierarchy_changed) {
+        rebuild_order();
+        hierarchy_changed = false;
+        changed_locals.clear();
+        return update_range(0, std::uint32_t(order.size()));
+    }
+
+    // Each changed entity's subtree is the range of positions up to it's subtree end. Visiting the changed entities
+    // in order of position means a subtree containing other changed entities is only recomputed once.
+    std::vector<std::uint32_t> changed_positions;
+    changed_positions.reserve(changed_locals.size());
+    for (auto e : changed_locals) {
+        auto position = position_of(e);
+        if (position != NO_POSITION) changed_positions.push_back(position);
+    }
+    changed_locals.clear();
+    std::sort(changed_positions.begin(), changed_positions.end());
+    std::size_t n_updated = 0;
+    std::uint32_t updated_end = 0;
+    for (auto position : changed_positions) {
+        if (position < updated_end) continue;
+        updated_end = subtree_ends[position];
+        n_updated += update_range(position, updated_end);
+    }
+    return n_updated;
+}
+
+
+std::size_t TransformPropagation2D::size() const
+{
+    return order.size();
+}
+
+
+void TransformPropagation2D::rebuild_order()
+{
+    auto local_registry = ecs.get_component_registry<LocalTransform2D>();
+    auto parent_registry = ecs.get_component_registry<Parent>();
+
+    // Collect every entity in the hierarchy, temporarily using positions to map entities to their place in this list.
+    std::vector<Entity> nodes;
+    auto node_of = [&](Entity e) {
+        auto index = ecs_impl::get_index(e.id);
+        if (index >= positions.size() || positions[index] == NO_POSITION) return NO_POSITION;
+        return nodes[positions[index]].id == e.id ? positions[index] : NO_POSITION;
+    };
+    nodes.reserve(local_registry->size());
+    std::fill(positions.begin(), positions.end(), NO_POSITION);
+    for (auto id : local_registry->entity_ids()) {
+        Entity e{id};
+        if (!ecs.exists(e)) continue;
+        auto index = ecs_impl::get_index(id);
+        if (positions.size() <= index) positions.resize(index + 1, NO_POSITION);
+        positions[index] = std::uint32_t(nodes.size());
+        nodes.push_back(e);
+    }
+
+    // Group the nodes by parent (as a counting sort), so each node's children are contiguous.
+    std::vector<std::uint32_t> node_parents(nodes.size(), NO_POSITION);
+    std::vector<std::uint32_t> first_child(nodes.size() + 1, 0);
+    for (std::size_t node = 0; node < nodes.size(); node += 1) {
+        auto parent = parent_registry->find(nodes[node]);
+        if (!parent) continue;
+        auto parent_node = node_of(parent->parent);
+        if (parent_node == NO_POSITION || parent_node == node) continue;
+        node_parents[node] = parent_node;
+        first_child[parent_node + 1] += 1;
+    }
+    for (std::size_t node = 0; node < nodes.size(); node += 1) {
+        first_child[node + 1] += first_child[node];
+    }
+    std::vector<std::uint32_t> children(first_child.back());
+    std::vector<std::uint32_t> n_placed(nodes.size(), 0);
+    for (std::size_t node = 0; node < nodes.size(); node += 1) {
+        auto parent = node_parents[node];
+        if (parent == NO_POSITION) continue;
+        children[first_child[parent] + n_placed[parent]] = std::uint32_t(node);
+        n_placed[parent] += 1;
+    }
+
+    // A depth-first walk from the roots visits each node followed by it's whole subtree. Nodes in a cycle are never
+    // reached. The walk uses an explicit stack, so deep hierarchies can't overflow the call stack.
+    std::vector<std::uint32_t> walk;
+    std::vector<std::uint32_t> stack;
+    walk.reserve(nodes.size());
+    for (std::size_t root = nodes.size(); root > 0; root -= 1) {
+        if (node_parents[root - 1] == NO_POSITION) stack.push_back(std::uint32_t(root - 1));
+    }
+    while (!stack.empty()) {
+        auto node = stack.back();
+        stack.pop_back();
+        walk.push_back(node);
+        for (auto child = first_child[node + 1]; child > first_child[node]; child -= 1) {
+            stack.push_back(children[child - 1]);
+        }
+    }
+    if (walk.size() < nodes.size()) {
+        LOG(WARN, "{} entities have a parent cycle, so their world transforms won't be updated",
+            nodes.size() - walk.size());
+    }
+
+    // Lay out the order, and make sure each entity has somewhere to put it's world transform.
+    std::vector<std::uint32_t> node_positions(nodes.size(), NO_POSITION);
+    order.clear();
+    parent_positions.clear();
+    for (auto node : walk) {
+        node_positions[node] = std::uint32_t(order.size());
+        order.push_back(nodes[node]);
+        auto parent = node_parents[node];
+        parent_positions.push_back(parent == NO_POSITION ? NO_POSITION : node_positions[parent]);
+    }
+    std::fill(positions.begin(), positions.end(), NO_POSITION);
+    for (std::size_t position = 0; position < order.size(); position += 1) {
+        positions[ecs_impl::get_index(order[position].id)] = std::uint32_t(position);
+        if (!ecs.has_component<WorldTransform2D>(order[position])) {
+            ecs.add_component<WorldTransform2D>(order[position], WorldTransform2D());
+        }
+    }
+    world_transforms.assign(order.size(), WorldTransform2D());
+
+    // A subtree ends where the last of it's children's subtrees ends, and children come after their parents.
+    subtree_ends.resize(order.size());
+    for (std::size_t position = 0; position < order.size(); position += 1) {
+        subtree_ends[position] = std::uint32_t(position + 1);
+    }
+    for (std::size_t position = order.size(); position > 0; position -= 1) {
+        auto parent = parent_positions[position - 1];
+        if (parent != NO_POSITION) subtree_ends[parent] = std::max(subtree_ends[parent], subtree_ends[position - 1]);
+    }
+}
+
+
+std::size_t TransformPropagation2D::update_range(std::uint32_t first, std::uint32_t last)
+{
+    // Parents come before their children, so by the time an entity is reached it's parent is up to date (either it's
+    // in the range, or it's outside the changed subtree and hasn't changed).
+    auto local_registry = ecs.get_component_registry<LocalTransform2D>();
+    auto world_registry = ecs.get_component_registry<WorldTransform2D>();
+    std::size_t n_updated = 0;
+    for (auto position = first; position < last; position += 1) {
+        auto local = local_registry->find(order[position]);
+        if (!local) continue;
+        auto parent = parent_positions[position];
+        world_transforms[position] = parent == NO_POSITION
+                ? to_matrix(*local)
+                : compose(world_transforms[parent], to_matrix(*local));
+        if (auto world = world_registry->find_for_write(order[position])) {
+            *world = world_transforms[position];
+        }
+        n_updated += 1;
+    }
+    return n_updated;
+}
+
+
+bool TransformPropagation2D::parent_changed(Entity e)
+{
+    auto position = position_of(e);
+    // An entity in the hierarchy but not in the order is in a cycle, which changing it's parent may have broken.
+    if (position == NO_POSITION) return ecs.has_component<LocalTransform2D>(e);
+    auto parent = ecs.get_component_registry<Parent>()->find(e);
+    if (!parent) return true;
+    // Parents which are the entity itself, or aren't in the hierarchy, are ignored, as in rebuild_order().
+    if (parent->parent.id == e.id) return parent_positions[position] != NO_POSITION;
+    auto parent_position = position_of(parent->parent);
+    if (parent_position == NO_POSITION && ecs.has_component<LocalTransform2D>(parent->parent)) return true;
+    return parent_position != parent_positions[position];
+}
+
+
+std::uint32_t TransformPropagation2D::position_of(Entity e) const
+{
+    auto index = ecs_impl::get_index(e.id);
+    if (index >= positions.size()) return NO_POSITION;
+    auto position = positions[index];
+    if (position == NO_POSITION || order[position].id != e.id) return NO_POSITION;
+    return position;
+}
@@ -0,0 +1,120 @@
+/**
+ * Hierarchical 2D transforms.
+ * Entities are positioned by a LocalTransform2D (relative to their parent, given by a Parent component, or to the
+ * world if they have none), and TransformPropagation2D computes the resulting WorldTransform2D of each entity.
+ */
+
+#pragma once
+
+#include "cyan/src/engine/ecs/ecs.hpp"
+#include "cyan/generated/components/components.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cyan {
+    /**
+     * Get the world transform matrix of a local transform, i.e. it's scale, then rotation, then translation.
+     */
+    component::WorldTransform2D to_matrix(const component::LocalTransform2D& local);
+
+    /**
+     * Combine two transforms, so that applying the result is the same as applying inner and then outer.
+     * @param outer The outer transform, e.g. a parent's world transform.
+     * @param inner The inner transform, e.g. a child's local transform as a matrix.
+     */
+    component::WorldTransform2D compose(const component::WorldTransform2D& outer,
+                                        const component::WorldTransform2D& inner);
+
+    /** TransformPropagation2D
+     * Computes the WorldTransform2D of every entity with a LocalTransform2D, following Parent links.
+     * Entities are kept in an array in depth-first order (each entity is followed by it's whole subtree), so a parent's
+     * world transform has always been computed by the time it's children are reached, and transforms are computed in
+     * linear passes over the array with no recursion or walking up parent chains.
+     * Only entities whose LocalTransform2D changed (see ECS::on_change()), and their descendants, are recomputed, and
+     * as each subtree is a contiguous range of the array, an update costs time proportional to the number of entities
+     * recomputed rather than the size of the hierarchy. The order is rebuilt (and everything recomputed) when the
+     * hierarchy changes: when a LocalTransform2D or Parent is added or removed, or a Parent is changed to refer to a
+     * different entity.
+     * Entities are given a WorldTransform2D if they don't have one. A Parent which refers to an entity without a
+     * LocalTransform2D is ignored (the entity is treated as a root), and entities in a parent cycle aren't updated.
+     * The propagation observes components of the ECS (and stops when it's destroyed), so it can't be copied or moved,
+     * and must not outlive the ECS.
+     * update() adds components, so should be run as an exclusive system, e.g.
+     *      TransformPropagation2D transforms(ecs);
+     *      scheduler.add_system("transforms", [&](ECS&) { transforms.update(); }).exclusive();
+     */
+    struct TransformPropagation2D {
+        /**
+         * Start propagating transforms in an ECS.
+         * @param ecs The ECS, which must use the default (per-type registry) storage.
+         */
+        explicit TransformPropagation2D(ECS& ecs);
+
+        ~TransformPropagation2D();
+
+        TransformPropagation2D(const TransformPropagation2D&) = delete;
+        TransformPropagation2D& operator=(const TransformPropagation2D&) = delete;
+
+        /**
+         * Bring every world transform up to date. This is a flush point for the ECS's component events (see
+         * ECS::flush_events()), so changes made up to this point are always included.
+         * @return The number of world transforms recomputed.
+         */
+        std::size_t update();
+
+        /**
+         * Get the number of entities in the hierarchy (those with a LocalTransform2D, as of the last update()).
+         */
+        [[nodiscard]]
+        std::size_t size() const;
+
+    private:
+        static constexpr std::uint32_t NO_POSITION = ~std::uint32_t(0);
+
+        ECS& ecs;
+        /// The observers added to the ECS, removed again on destruction.
+        std::vector<ObserverId> observers;
+        /// Whether the hierarchy has changed since the order was built.
+        bool hierarchy_changed = true;
+        /// Entities whose LocalTransform2D changed since the last update().
+        std::vector<Entity> changed_locals;
+        /// Entities whose Parent was written since the last update(), which may or may not have a new parent.
+        std::vector<Entity> changed_parents;
+
+        // The hierarchy, in depth-first order. Each of these is indexed by position in the order.
+        std::vector<Entity> order;
+        /// The position of each entity's parent, or NO_POSITION for roots.
+        std::vector<std::uint32_t> parent_positions;
+        /// The world transform of each entity, kept here so children can read their parent's without a lookup.
+        std::vector<component::WorldTransform2D> world_transforms;
+        /// The position just past the end of each entity's subtree.
+        std::vector<std::uint32_t> subtree_ends;
+        /// The position of each entity in the order, indexed by entity index (NO_POSITION if it isn't in the order).
+        std::vector<std::uint32_t> positions;
+
+        /**
+         * Internal function to rebuild the order from the current LocalTransform2D and Parent components.
+         */
+        void rebuild_order();
+
+        /**
+         * Internal function to recompute the world transforms of a range of positions in the order. The parent of the
+         * first entity must be up to date.
+         * @return The number of world transforms recomputed.
+         */
+        std::size_t update_range(std::uint32_t first, std::uint32_t last);
+
+        /**
+         * Internal function to check whether an entity's Parent refers to a different entity than it did when the order
+         * was built (treating ignored parents as no parent).
+         */
+        bool parent_changed(Entity e);
+
+        /**
+         * Internal function to get the position of an entity in the order, or NO_POSITION.
+         */
+        std::uint32_t position_of(Entity e) const;
+    };
+}
@@ -34,7 +34,14 @@ const char* Logger::verbosity_to_str(LogVerbosity verbosity)
 void Logger::print_time(std::ostream* out)
 {
     auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-    (*out) << "[" << std::put_time(std::localtime(&now), "%T") << "] ";
+    // std::localtime() returns a shared buffer, so use the thread-safe equivalents.
+    std::tm local_time{};
+#if defined(_WIN32)
+    localtime_s(&local_time, &now);
+#else
+    localtime_r(&now, &local_time);
+#endif
+    (*out) << "[" << std::put_time(&local_time, "%T") << "] ";
 }
 
 
@@ -4,6 +4,7 @@
 #include <ctime>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <array>
 #include <fmt/format.h>
@@ -29,6 +30,7 @@ namespace cyan {
 
     /**
      * Logger provides an io for logging information for debugging.
+     * Logging is thread-safe (each log line is written whole), but outputs should be set up before logging starts.
      */
     struct Logger {
         /// Construct a logger.
@@ -62,9 +64,11 @@ namespace cyan {
         void log(LogVerbosity verbosity, const std::string& fmt, Params... args) const
         {
             if (int(verbosity) < int(verbosity_threshold)) return;
+            auto message = fmt::format(fmt, args...);
+            std::lock_guard lock(output_mutex);
             for (int i = 0; i < num_outputs; i += 1) {
                 this->print_time(outputs[i]);
-                (*outputs[i]) << this->verbosity_to_str(verbosity) << fmt::format(fmt, args...) << '\n';
+                (*outputs[i]) << this->verbosity_to_str(verbosity) << message << '\n';
             }
         }
 
@@ -79,6 +83,8 @@ namespace cyan {
         static const std::uint8_t max_outputs = 4;
         std::uint8_t num_outputs;
         std::array<std::ostream*, max_outputs> outputs;
+        /// Held while writing a log line, so lines logged from different threads don't interleave.
+        mutable std::mutex output_mutex;
 
         /// Convert a LogVerbosity enum value to string for display.
         static const char* verbosity_to_str(LogVerbosity verbosity);
@@ -0,0 +1,124 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+using namespace cyan;
+
+
+ThreadPool::ThreadPool(std::size_t n_threads)
+{
+    if (n_threads == 0) {
+        // hardware_concurrency() is allowed to return 0 if it can't tell.
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers.reserve(n_threads);
+    for (std::size_t i = 0; i < n_threads; i += 1) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    wait_idle();
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    task_available.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(mutex);
+        tasks.push(std::move(task));
+        n_unfinished_tasks += 1;
+    }
+    task_available.notify_one();
+}
+
+
+void ThreadPool::wait_idle()
+{
+    std::unique_lock lock(mutex);
+    idle.wait(lock, [this]() { return n_unfinished_tasks == 0; });
+}
+
+
+void ThreadPool::parallel_for(std::size_t n, const std::function<void(std::size_t)>& fn)
+{
+    if (n == 0) return;
+
+    // Shared between the caller and the helper tasks. Helper tasks that only start after all of the work has been
+    // claimed return without touching fn, so it's safe for them to outlive this call.
+    struct State {
+        std::size_t n;
+        const std::function<void(std::size_t)>* fn;
+        std::atomic_size_t next_index{0};
+        std::mutex mutex;
+        std::condition_variable all_done;
+        std::size_t n_done = 0;
+        std::exception_ptr first_error;
+    };
+    auto state = std::make_shared<State>();
+    state->n = n;
+    state->fn = &fn;
+
+    auto work = [state]() {
+        while (true) {
+            auto index = state->next_index++;
+            if (index >= state->n) return;
+            std::exception_ptr error;
+            try {
+                (*state->fn)(index);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard lock(state->mutex);
+            if (error && !state->first_error) state->first_error = error;
+            state->n_done += 1;
+            if (state->n_done == state->n) state->all_done.notify_all();
+        }
+    };
+
+    auto n_helpers = std::min(workers.size(), n - 1);
+    for (std::size_t i = 0; i < n_helpers; i += 1) {
+        submit(work);
+    }
+    work();
+
+    std::unique_lock lock(state->mutex);
+    state->all_done.wait(lock, [&]() { return state->n_done == state->n; });
+    if (state->first_error) std::rethrow_exception(state->first_error);
+}
+
+
+void ThreadPool::worker_loop()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex);
+            task_available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        task();
+
+        {
+            std::lock_guard lock(mutex);
+            n_unfinished_tasks -= 1;
+            if (n_unfinished_tasks == 0) idle.notify_all();
+        }
+    }
+}
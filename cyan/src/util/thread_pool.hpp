@@ -0,0 +1,76 @@
+/**
+ * A simple fixed-size pool of worker threads.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace cyan {
+    /** ThreadPool
+     * Runs submitted tasks on a fixed number of worker threads. Tasks are started in submission order.
+     * Tasks must not throw - catch exceptions inside the task and pass them back to the submitter if needed.
+     */
+    struct ThreadPool {
+        /**
+         * Start a thread pool.
+         * @param n_threads The number of worker threads. If 0, one thread per hardware thread is used.
+         */
+        explicit ThreadPool(std::size_t n_threads = 0);
+
+        /// Waits for all submitted tasks to finish, then stops the worker threads.
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * Queue a task to be run on a worker thread.
+         * @param task The function to run.
+         */
+        void submit(std::function<void()> task);
+
+        /**
+         * Block until every submitted task (including tasks submitted by other tasks while waiting) has finished.
+         * Must not be called from a task running on this pool.
+         */
+        void wait_idle();
+
+        /**
+         * Call a function once for each index in [0, n), spread across the worker threads and the calling thread, and
+         * block until every call has finished.
+         * The calling thread takes part in the work, so this may be called from a task running on this pool (if all
+         * other workers are busy, the caller simply does all of the work itself).
+         * If any calls throw, the remaining calls still run, and the first exception is rethrown afterwards.
+         * @param n The number of indices.
+         * @param fn A function taking the index (std::size_t).
+         */
+        void parallel_for(std::size_t n, const std::function<void(std::size_t)>& fn);
+
+        /**
+         * Get the number of worker threads.
+         */
+        [[nodiscard]]
+        std::size_t size() const { return workers.size(); }
+
+    private:
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable task_available;
+        std::condition_variable idle;
+        std::size_t n_unfinished_tasks = 0;
+        bool stopping = false;
+
+        /**
+         * Internal function run by each worker thread.
+         */
+        void worker_loop();
+    };
+}
@@ -0,0 +1,283 @@
+/// Tests for ArchetypeStorage, and for the ECS when using archetype storage.
+
+#include <catch2/catch.hpp>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+#include "cyan/src/engine/ecs/archetype_storage.hpp"
+#include "cyan/src/engine/ecs/ecs.hpp"
+
+using namespace cyan;
+using namespace cyan::ecs_impl;
+
+namespace {
+    struct ArchetypeTestPosition {
+        float x, y;
+    };
+
+    struct ArchetypeTestVelocity {
+        float dx, dy;
+    };
+
+    struct ArchetypeTestAggregate {
+        int a, b;
+    };
+
+    /// A component large enough that only a handful fit in each chunk.
+    struct ArchetypeTestLarge {
+        char data[4000];
+    };
+
+    /// A component whose constructor throws when given a negative value.
+    struct ArchetypeTestThrowing {
+        int value;
+        explicit ArchetypeTestThrowing(int value) : value(value) {
+            if (value < 0) throw std::runtime_error("ArchetypeTestThrowing");
+        }
+    };
+}
+
+TEST_CASE("ArchetypeStorage: components move between archetypes", "[engine][ecs]") {
+    ArchetypeStorage storage;
+    ComponentTypeId int_type{0};
+    ComponentTypeId string_type{1};
+
+    Entity e0{make_ecs_id(0, 0)};
+    Entity e1{make_ecs_id(0, 1)};
+    Entity e2{make_ecs_id(0, 2)};
+
+    storage.emplace<int>(e0, int_type, 0);
+    storage.emplace<int>(e1, int_type, 1);
+    storage.emplace<int>(e2, int_type, 2);
+    CHECK(storage.count(int_type) == 3);
+    CHECK(storage.count(string_type) == 0);
+
+    // Adding a string to e1 moves it (and it's int) to the {int, string} archetype.
+    storage.emplace<std::string>(e1, string_type, "a string long enough to need a heap allocation");
+    CHECK(storage.count(int_type) == 3);
+    CHECK(storage.count(string_type) == 1);
+    REQUIRE(storage.get(e1, int_type));
+    CHECK(*static_cast<int*>(storage.get(e1, int_type)) == 1);
+    CHECK(*static_cast<std::string*>(storage.get(e1, string_type))
+          == "a string long enough to need a heap allocation");
+    CHECK_FALSE(storage.has(e0, string_type));
+    CHECK(*static_cast<int*>(storage.get(e0, int_type)) == 0);
+    CHECK(*static_cast<int*>(storage.get(e2, int_type)) == 2);
+
+    // Adding a type the entity already has keeps the existing component.
+    CHECK(*storage.emplace<int>(e1, int_type, 100) == 1);
+
+    // Removing the int leaves the string.
+    storage.remove(e1, int_type);
+    CHECK_FALSE(storage.has(e1, int_type));
+    CHECK(*static_cast<std::string*>(storage.get(e1, string_type))
+          == "a string long enough to need a heap allocation");
+    CHECK(storage.count(int_type) == 2);
+
+    // Removing the last component leaves the entity with nothing.
+    storage.remove(e1, string_type);
+    CHECK(storage.count(string_type) == 0);
+    CHECK_FALSE(storage.get(e1, string_type));
+
+    // Entities of a newer generation replace older ones in the same slot.
+    storage.emplace<std::string>(e2, string_type, "e2");
+    Entity e2_1{make_ecs_id(1, 2)};
+    storage.emplace<int>(e2_1, int_type, 21);
+    CHECK_FALSE(storage.has(e2, int_type));
+    CHECK(*static_cast<int*>(storage.get(e2_1, int_type)) == 21);
+    CHECK(storage.count(string_type) == 0);
+    CHECK(storage.emplace<int>(e2, int_type, 20) == nullptr);
+    CHECK(*static_cast<int*>(storage.get(e2_1, int_type)) == 21);
+
+    storage.remove_entity(e0);
+    CHECK_FALSE(storage.has(e0, int_type));
+    CHECK(storage.count(int_type) == 1);
+}
+
+TEST_CASE("ArchetypeStorage: entities span multiple chunks", "[engine][ecs]") {
+    ArchetypeStorage storage;
+    ComponentTypeId large_type{0};
+    ComponentTypeId int_type{1};
+    const int n_entities = 50;
+
+    for (int i = 0; i < n_entities; i += 1) {
+        Entity e{make_ecs_id(0, i)};
+        storage.emplace<ArchetypeTestLarge>(e, large_type)->data[0] = char(i);
+        storage.emplace<int>(e, int_type, i);
+    }
+    CHECK(storage.count(large_type) == n_entities);
+
+    // Iterate over every chunk, checking each row refers to the correct entity.
+    int query[] = {int_type.id, large_type.id};
+    std::size_t archetype = 0;
+    std::size_t chunk = 0;
+    ArchetypeChunkView chunk_view;
+    void* columns[2];
+    std::size_t n_chunks = 0;
+    std::size_t n_visited = 0;
+    while (storage.next_matching_chunk(query, 2, archetype, chunk, chunk_view, columns)) {
+        for (std::size_t row = 0; row < chunk_view.count; row += 1) {
+            auto index = int(get_index(chunk_view.entity_ids[row]));
+            CHECK(static_cast<int*>(columns[0])[row] == index);
+            CHECK(static_cast<ArchetypeTestLarge*>(columns[1])[row].data[0] == char(index));
+            n_visited += 1;
+        }
+        n_chunks += 1;
+        chunk += 1;
+    }
+    CHECK(n_visited == n_entities);
+    CHECK(n_chunks > 1);
+
+    // Removing entities from the middle keeps the rows packed.
+    for (int i = 0; i < n_entities; i += 2) {
+        storage.remove_entity(Entity{make_ecs_id(0, i)});
+    }
+    CHECK(storage.count(large_type) == n_entities / 2);
+    for (int i = 1; i < n_entities; i += 2) {
+        Entity e{make_ecs_id(0, i)};
+        REQUIRE(storage.get(e, int_type));
+        CHECK(*static_cast<int*>(storage.get(e, int_type)) == i);
+        CHECK(static_cast<ArchetypeTestLarge*>(storage.get(e, large_type))->data[0] == char(i));
+    }
+}
+
+TEST_CASE("ArchetypeStorage: a throwing constructor leaves the entity where it was", "[engine][ecs]") {
+    ArchetypeStorage storage;
+    ComponentTypeId int_type{0};
+    ComponentTypeId throwing_type{1};
+
+    Entity e0{make_ecs_id(0, 0)};
+    Entity e1{make_ecs_id(0, 1)};
+    storage.emplace<int>(e0, int_type, 0);
+    storage.emplace<int>(e1, int_type, 1);
+
+    CHECK_THROWS(storage.emplace<ArchetypeTestThrowing>(e0, throwing_type, -1));
+    CHECK(storage.count(throwing_type) == 0);
+    CHECK_FALSE(storage.has(e0, throwing_type));
+    REQUIRE(storage.get(e0, int_type));
+    CHECK(*static_cast<int*>(storage.get(e0, int_type)) == 0);
+    CHECK(*static_cast<int*>(storage.get(e1, int_type)) == 1);
+
+    // The entity can still be given the component, and removed.
+    REQUIRE(storage.emplace<ArchetypeTestThrowing>(e0, throwing_type, 2));
+    CHECK(static_cast<ArchetypeTestThrowing*>(storage.get(e0, throwing_type))->value == 2);
+    CHECK(*static_cast<int*>(storage.get(e0, int_type)) == 0);
+    storage.remove_entity(e0);
+    CHECK(storage.count(int_type) == 1);
+    CHECK(storage.count(throwing_type) == 0);
+}
+
+TEST_CASE("ECS: Archetype storage", "[engine][ecs]") {
+    ECS ecs(EcsStorage::Archetypes);
+    CHECK(ecs.get_storage() == EcsStorage::Archetypes);
+
+    const int n_entities = 1000;
+    std::vector<Entity> entities;
+    for (int i = 0; i < n_entities; i += 1) {
+        Entity e = ecs.new_entity();
+        entities.push_back(e);
+        ecs.add_component<ArchetypeTestPosition>(e, {float(i), 0.0f});
+        if (i % 2 == 0) ecs.add_component<ArchetypeTestVelocity>(e, {1.0f, 2.0f});
+        if (i % 3 == 0) ecs.add_component<std::string>(e, std::to_string(i));
+    }
+
+    CHECK(ecs.has_component<ArchetypeTestPosition>(entities[1]));
+    CHECK_FALSE(ecs.has_component<ArchetypeTestVelocity>(entities[1]));
+    REQUIRE(bool(ecs.get_component<std::string>(entities[3])));
+    CHECK(*ecs.get_component<std::string>(entities[3]) == "3");
+    CHECK_FALSE(ecs.component_exists<std::string>(ecs.get_component<std::string>(entities[3]).id));
+
+    // Views visit exactly the matching entities, across archetypes.
+    std::size_t n_visited = 0;
+    for (auto [e, position, velocity] : ecs.view<ArchetypeTestPosition, ArchetypeTestVelocity>()) {
+        CHECK(int(position.x) % 2 == 0);
+        CHECK(e.id == entities[int(position.x)].id);
+        position.y += velocity.dy;
+        n_visited += 1;
+    }
+    CHECK(n_visited == n_entities / 2);
+    CHECK(ecs.get_component<ArchetypeTestPosition>(entities[4]).get().y == 2.0f);
+    CHECK(ecs.get_component<ArchetypeTestPosition>(entities[5]).get().y == 0.0f);
+
+    n_visited = 0;
+    ecs.view<std::string, ArchetypeTestVelocity>().each(
+            [&](Entity e, std::string& name, ArchetypeTestVelocity&) {
+                CHECK(name == std::to_string(get_index(e.id)));
+                n_visited += 1;
+            });
+    CHECK(n_visited == (n_entities + 5) / 6);
+
+    // Removing components and deleting entities is reflected in later iteration.
+    for (int i = 0; i < n_entities; i += 4) {
+        ecs.remove_component<ArchetypeTestVelocity>(entities[i]);
+    }
+    for (int i = 2; i < n_entities; i += 8) {
+        ecs.delete_entity(entities[i]);
+    }
+    CHECK_FALSE(ecs.has_component<ArchetypeTestPosition>(entities[2]));
+    CHECK(ecs.has_component<ArchetypeTestPosition>(entities[4]));
+    n_visited = 0;
+    auto velocity_view = ecs.view<ArchetypeTestVelocity, ArchetypeTestPosition>();
+    for (auto [e, velocity, position] : velocity_view) {
+        CHECK(int(position.x) % 8 == 6);
+        n_visited += 1;
+    }
+    CHECK(n_visited == n_entities / 8);
+    CHECK(velocity_view.size_hint() == n_entities / 8);
+}
+
+TEST_CASE("ECS: Both storages construct aggregates and refuse replaced entities", "[engine][ecs]") {
+    for (auto storage : {EcsStorage::ComponentRegistries, EcsStorage::Archetypes}) {
+        ECS ecs(storage);
+        Entity e = ecs.new_entity();
+        auto aggregate = ecs.emplace_component<ArchetypeTestAggregate>(e, 1, 2);
+        REQUIRE(bool(aggregate));
+        CHECK(aggregate.read().a == 1);
+        CHECK(aggregate.read().b == 2);
+
+        ecs.delete_entity(e);
+        Entity replacement = ecs.new_entity();
+        REQUIRE(get_index(replacement.id) == get_index(e.id));
+        CHECK(bool(ecs.add_component<int>(replacement, 1)));
+        CHECK_FALSE(bool(ecs.add_component<int>(e, 2)));
+        CHECK(*ecs.get_component<int>(replacement) == 1);
+    }
+
+    // The storages themselves refuse a component for an entity whose slot a newer generation holds, rather than one
+    // throwing and the other not.
+    Entity old_entity{make_ecs_id(0, 0)};
+    Entity new_entity{make_ecs_id(1, 0)};
+    SingleComponentRegistry<int> registry;
+    CHECK(bool(registry.add(new_entity, 1)));
+    CHECK_FALSE(bool(registry.add(old_entity, 2)));
+    CHECK(*registry.find(new_entity) == 1);
+    ArchetypeStorage archetypes;
+    ComponentTypeId int_type{0};
+    CHECK(archetypes.emplace<int>(new_entity, int_type, 1) != nullptr);
+    CHECK(archetypes.emplace<int>(old_entity, int_type, 2) == nullptr);
+    CHECK(*static_cast<int*>(archetypes.get(new_entity, int_type)) == 1);
+}
+
+TEST_CASE("ECS: Parallel iteration with archetype storage", "[engine][ecs]") {
+    ECS ecs(EcsStorage::Archetypes);
+    const int n_entities = 5000;
+    for (int i = 0; i < n_entities; i += 1) {
+        Entity e = ecs.new_entity();
+        ecs.add_component<ArchetypeTestPosition>(e, {float(i), 0.0f});
+        if (i % 2 == 0) ecs.add_component<ArchetypeTestVelocity>(e, {1.0f, 2.0f});
+    }
+
+    std::atomic_int n_visited = 0;
+    ecs.par_each<ArchetypeTestPosition>([&](Entity, ArchetypeTestPosition& position) {
+        position.y = position.x * 2.0f;
+        n_visited += 1;
+    }, 100);
+    CHECK(n_visited == n_entities);
+
+    n_visited = 0;
+    ecs.par_each_const<ArchetypeTestPosition>([&](Entity, const ArchetypeTestPosition& position) {
+        if (position.y == position.x * 2.0f) n_visited += 1;
+    });
+    CHECK(n_visited == n_entities);
+}
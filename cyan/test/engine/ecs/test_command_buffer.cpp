@@ -0,0 +1,157 @@
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cyan/src/engine/ecs/command_buffer.hpp"
+#include "cyan/src/util/thread_pool.hpp"
+
+using namespace cyan;
+
+TEST_CASE("EcsCommandBuffer: deferred structural changes", "[engine][ecs]") {
+    ECS ecs;
+    Entity e0 = ecs.new_entity();
+    Entity e1 = ecs.new_entity();
+    ecs.add_component<int>(e0, 0);
+    ecs.add_component<int>(e1, 1);
+
+    EcsCommandBuffer buffer;
+    buffer.reserve(16);
+
+    // Record changes while iterating over the ECS - nothing is applied yet.
+    for (auto [e, value] : ecs.view<int>()) {
+        if (value == 0) {
+            buffer.delete_entity(e);
+        } else {
+            buffer.remove_component<int>(e);
+            buffer.add_component<std::string>(e, "one");
+        }
+    }
+    Entity placeholder = buffer.new_entity();
+    CHECK(EcsCommandBuffer::is_placeholder(placeholder));
+    CHECK_FALSE(EcsCommandBuffer::is_placeholder(e0));
+    buffer.add_component<int>(placeholder, 2);
+    buffer.add_component<std::string>(placeholder, "two");
+    Entity short_lived = buffer.new_entity();
+    buffer.add_component<int>(short_lived, 3);
+    buffer.delete_entity(short_lived);
+
+    CHECK(buffer.size() == 9);
+    CHECK(ecs.exists(e0));
+    CHECK(ecs.has_component<int>(e1));
+    CHECK_FALSE(ecs.exists(placeholder));
+
+    auto created = buffer.apply(ecs);
+    CHECK(buffer.size() == 0);
+    REQUIRE(created.size() == 2);
+    CHECK_FALSE(EcsCommandBuffer::is_placeholder(created[0]));
+
+    CHECK_FALSE(ecs.exists(e0));
+    CHECK_FALSE(ecs.has_component<int>(e1));
+    CHECK(*ecs.get_component<std::string>(e1) == "one");
+    CHECK(ecs.exists(created[0]));
+    CHECK(*ecs.get_component<int>(created[0]) == 2);
+    CHECK(*ecs.get_component<std::string>(created[0]) == "two");
+    CHECK_FALSE(ecs.exists(created[1]));
+
+    // Placeholders from another buffer can't be resolved.
+    EcsCommandBuffer other_buffer;
+    other_buffer.add_component<int>(placeholder, 4);
+    other_buffer.add_component<int>(e1, 5);
+    CHECK_THROWS(other_buffer.apply(ecs));
+    // A failed apply still clears the buffer, so the commands after the failing one are discarded.
+    CHECK(other_buffer.size() == 0);
+    CHECK_FALSE(ecs.has_component<int>(e1));
+}
+
+TEST_CASE("EcsCommandBufferSet: per-thread recording", "[engine][ecs]") {
+    ECS ecs;
+    EcsCommandBufferSet buffers;
+    ThreadPool pool(4);
+    const int n_spawns = 1000;
+
+    pool.parallel_for(n_spawns, [&](std::size_t i) {
+        auto& buffer = buffers.local();
+        auto e = buffer.new_entity();
+        buffer.add_component<int>(e, int(i));
+    });
+    CHECK(buffers.size() == 2 * n_spawns);
+    CHECK(&buffers.local() == &buffers.local());
+
+    buffers.apply(ecs);
+    CHECK(buffers.size() == 0);
+
+    // Every spawned entity exists with it's component, each value exactly once.
+    std::vector<int> seen(n_spawns, 0);
+    for (auto [e, value] : ecs.view<int>()) {
+        REQUIRE(value >= 0);
+        REQUIRE(value < n_spawns);
+        seen[value] += 1;
+    }
+    CHECK(std::count(seen.begin(), seen.end(), 1) == n_spawns);
+
+    // A thread alternating between sets keeps one buffer in each, and a new set never reuses an old set's buffers.
+    auto& first = buffers.local();
+    {
+        EcsCommandBufferSet other_buffers;
+        auto& other = other_buffers.local();
+        CHECK(&other != &first);
+        CHECK(&buffers.local() == &first);
+        CHECK(&other_buffers.local() == &other);
+        other.new_entity();
+        CHECK(other_buffers.size() == 1);
+    }
+    EcsCommandBufferSet new_buffers;
+    CHECK(new_buffers.local().size() == 0);
+    CHECK(&buffers.local() == &first);
+}
+
+TEST_CASE("EcsCommandBuffer: in-place component construction", "[engine][ecs]") {
+    ECS ecs;
+    Entity e = ecs.new_entity();
+
+    EcsCommandBuffer buffer;
+    buffer.emplace_component<std::string>(e, std::size_t(3), 'x');
+    Entity placeholder = buffer.new_entity();
+    buffer.emplace_component<std::string>(placeholder, "created");
+    CHECK_FALSE(ecs.has_component<std::string>(e));
+
+    auto created = buffer.apply(ecs);
+    REQUIRE(created.size() == 1);
+    CHECK(*ecs.get_component<std::string>(e) == "xxx");
+    CHECK(*ecs.get_component<std::string>(created[0]) == "created");
+}
+
+TEST_CASE("EcsCommandBuffer: move-only components", "[engine][ecs]") {
+    ECS ecs;
+    Entity e = ecs.new_entity();
+
+    EcsCommandBuffer buffer;
+    buffer.add_component<std::unique_ptr<int>>(e, std::make_unique<int>(1));
+    Entity placeholder = buffer.new_entity();
+    buffer.emplace_component<std::unique_ptr<int>>(placeholder, std::make_unique<int>(2));
+    auto created = buffer.apply(ecs);
+    REQUIRE(created.size() == 1);
+    CHECK(**ecs.get_component<std::unique_ptr<int>>(e) == 1);
+    CHECK(**ecs.get_component<std::unique_ptr<int>>(created[0]) == 2);
+}
+
+TEST_CASE("EcsCommandBufferSet: placeholders from another thread's buffer", "[engine][ecs]") {
+    ECS ecs;
+    EcsCommandBufferSet buffers;
+    Entity other_placeholder;
+    std::thread other([&]() {
+        other_placeholder = buffers.local().new_entity();
+    });
+    other.join();
+
+    // Each buffer's first placeholder is the first entity it creates, but they can't be mixed up.
+    auto& local = buffers.local();
+    Entity placeholder = local.new_entity();
+    CHECK(placeholder.id != other_placeholder.id);
+    local.add_component<int>(other_placeholder, 1);
+    CHECK_THROWS(buffers.apply(ecs));
+    ecs.view<int>().each([](Entity, int&) { FAIL("The component was added to the wrong entity"); });
+}
@@ -78,3 +78,60 @@ TEST_CASE("ComponentMap: access to underlying registries", "[engine][ecs]") {
     CHECK(*component_map.get_component_registry<std::string>()->get(Entity{1}) == "1");
     CHECK(*component_map.get_component_registry<std::string>()->get(Entity{2}) == "2");
 }
+
+
+TEST_CASE("ComponentMap: generated component types", "[engine][ecs]") {
+    using cyan::component::DebugName;
+    static_assert(is_static_component_type<DebugName>);
+    static_assert(!is_static_component_type<int>);
+
+    ComponentMap component_map;
+    ComponentMap other_component_map;
+
+    // Generated types have fixed IDs at the top of the ID range, and are named after their type by default.
+    auto type_id = component_map.get_component_type_id<DebugName>().id;
+    CHECK(type_id >= FIRST_STATIC_COMPONENT_TYPE_ID);
+    CHECK(type_id < int(ECS_MAX_COMPONENT_TYPES));
+    CHECK(component_map.get_component_name<DebugName>() == "DebugName");
+    component_map.register_component_type<DebugName>("debug_name");
+    CHECK(component_map.get_component_name<DebugName>() == "debug_name");
+    CHECK(component_map.get_component_registry<DebugName>()->get_component_type_name() == "debug_name");
+
+    // Each map has it's own registry, which is the same on every access.
+    auto registry = component_map.get_component_registry<DebugName>();
+    CHECK(registry == component_map.get_component_registry<DebugName>());
+    CHECK(registry != other_component_map.get_component_registry<DebugName>());
+    registry->add(Entity{0}, DebugName("zero"));
+    registry->add(Entity{1}, DebugName("one"));
+    CHECK(registry->find(Entity{0})->name == "zero");
+    CHECK(other_component_map.get_component_registry<DebugName>()->size() == 0);
+
+    // Type-erased removal works the same way as for other types.
+    component_map.remove_component(ComponentTypeId{type_id}, Entity{0});
+    CHECK_FALSE(registry->find(Entity{0}));
+    CHECK(registry->find(Entity{1})->name == "one");
+}
+
+
+TEST_CASE("ComponentMap: type-erased registry access", "[engine][ecs]") {
+    ComponentMap component_map;
+    component_map.get_component_registry<int>()->add(Entity{0}, 0);
+    component_map.get_component_registry<std::string>()->add(Entity{0}, "0");
+    component_map.get_component_registry<std::string>()->add(Entity{1}, "1");
+
+    auto int_type = component_map.get_component_type_id<int>();
+    REQUIRE(component_map.get_registry(int_type) != nullptr);
+    CHECK(component_map.get_registry(int_type)->size() == 1);
+
+    // Every registry is visited, including the (empty) registries of generated component types.
+    std::size_t n_registries = 0;
+    std::size_t n_components = 0;
+    component_map.for_each_registry([&](ComponentTypeId, IComponentRegistry& registry) {
+        n_registries += 1;
+        n_components += registry.size();
+        registry.clear();
+    });
+    CHECK(n_registries == 2 + N_STATIC_COMPONENT_TYPES);
+    CHECK(n_components == 3);
+    CHECK(component_map.get_component_registry<std::string>()->size() == 0);
+}
@@ -1,10 +1,14 @@
 #include <catch2/catch.hpp>
 
+#include <vector>
+
 #include "cyan/src/engine/ecs/ecs_common.hpp"
 
 using namespace cyan;
 using namespace cyan::ecs_impl;
 
+// These check the exact bit layout of the default ID configuration (64 bit IDs, split evenly).
+#if CYAN_ECS_ID_BITS == 64 && CYAN_ECS_GENERATION_BITS == 32
 TEST_CASE("get_generation", "[engine][ecs]") {
     CHECK(get_generation(0) == 0);
     CHECK(get_generation(1) == 0);
@@ -29,4 +33,21 @@ TEST_CASE("make_ecs_id", "[engine][ecs]") {
     CHECK(make_ecs_id(0, 0xFFFFFFFF) == 0xFFFFFFFF);
     CHECK(make_ecs_id(0xFFFFFFFF, 0x0) == 0xFFFFFFFF00000000);
     CHECK(make_ecs_id(0xFFFFFFFF, 0xFFFFFFFF) == 0xFFFFFFFFFFFFFFFF);
-}
\ No newline at end of file
+}
+#endif
+
+TEST_CASE("ECS ids round trip in any ID configuration", "[engine][ecs]") {
+    CHECK(ENTITY_GENERATION_BITS == CYAN_ECS_GENERATION_BITS);
+    CHECK(std::numeric_limits<EcsIdT>::digits == CYAN_ECS_ID_BITS);
+
+    std::vector<EcsGenerationT> generations = {0, 1, ECS_MAX_GENERATION, ECS_RESERVED_GENERATION};
+    for (auto generation : generations) {
+        for (EcsIndexT index : {EcsIndexT(0), EcsIndexT(1), EcsIndexT(ECS_MAX_SLOTS - 1), EcsIndexT(ECS_NULL_INDEX)}) {
+            auto id = make_ecs_id(generation, index);
+            CHECK(get_generation(id) == generation);
+            CHECK(get_index(id) == index);
+        }
+    }
+    CHECK(ECS_MAX_GENERATION < ECS_RESERVED_GENERATION);
+    CHECK(make_ecs_id(ECS_RESERVED_GENERATION, ECS_NULL_INDEX) == std::numeric_limits<EcsIdT>::max());
+}
@@ -5,7 +5,9 @@
 
 #include <catch2/catch.hpp>
 #include <iostream>
+#include <memory>
 #include <random>
+#include <string>
 
 #include "cyan/src/engine/ecs/object_registry.hpp"
 
@@ -210,3 +212,134 @@ TEST_CASE("ObjectRegistry: fuzzy mass use testing for consistency", "[engine][ec
         CHECK(entry.id == *entry);
     }
 }
+
+TEST_CASE("ObjectRegistry: object lifetimes and in-place construction", "[engine][ecs]") {
+    SECTION("Objects are destroyed on removal, not when their slot is reused") {
+        auto tracker = std::make_shared<int>(0);
+        ObjectRegistry<std::shared_ptr<int>> registry;
+        auto id = registry.add(tracker).id;
+        registry.add(tracker);
+        CHECK(tracker.use_count() == 3);
+        registry.remove(id);
+        CHECK(tracker.use_count() == 2);
+        {
+            auto copy = registry;
+            CHECK(copy.size() == 1);
+            CHECK(tracker.use_count() == 3);
+        }
+        CHECK(tracker.use_count() == 2);
+    }
+
+    SECTION("Move-only and non-default-constructible types") {
+        struct NoDefault {
+            explicit NoDefault(std::string name) : name(std::move(name)) {}
+            std::string name;
+        };
+        ObjectRegistry<NoDefault> registry;
+        std::vector<EcsIdT> ids;
+        for (int i = 0; i < 100; i += 1) {
+            ids.push_back(registry.emplace("object " + std::to_string(i)).id);
+        }
+        registry.remove(ids[3]);
+        ids[3] = registry.add(NoDefault("replacement")).id;
+        CHECK(get_index(ids[3]) == 3);
+        CHECK(registry.get(ids[3])->name == "replacement");
+        // Growing the registry moves the objects into new slots, which mustn't affect their values.
+        for (int i = 0; i < 100; i += 1) {
+            if (i != 3) CHECK(registry.get(ids[i])->name == "object " + std::to_string(i));
+        }
+
+        ObjectRegistry<std::unique_ptr<int>> unique_registry;
+        auto entry = unique_registry.add(std::make_unique<int>(5));
+        CHECK(**entry == 5);
+        unique_registry.reserve(1000);
+        CHECK(**unique_registry.get(entry.id) == 5);
+    }
+
+    SECTION("Aggregates can be constructed in-place") {
+        struct Point { int x, y; };
+        ObjectRegistry<Point> registry;
+        auto entry = registry.emplace(1, 2);
+        CHECK(entry->x == 1);
+        CHECK(entry->y == 2);
+    }
+}
+
+TEST_CASE("ObjectRegistry: objects don't move as the registry grows", "[engine][ecs]") {
+    ObjectRegistry<std::string> registry;
+    auto first = registry.add("first");
+    std::string* first_value = first.value;
+
+    std::vector<std::pair<EcsIdT, std::string*>> entries;
+    for (int i = 0; i < 10000; i += 1) {
+        auto entry = registry.emplace(std::to_string(i));
+        entries.emplace_back(entry.id, entry.value);
+        if (i % 3 == 0) registry.remove(entry.id);
+    }
+
+    CHECK(registry.get(first.id).value == first_value);
+    CHECK(*first_value == "first");
+    for (int i = 0; i < 10000; i += 1) {
+        if (i % 3 == 0) continue;
+        REQUIRE(registry.get(entries[i].first).value == entries[i].second);
+        CHECK(*entries[i].second == std::to_string(i));
+    }
+}
+
+// Running a slot through every generation is only practical with a narrow generation field, as in cyan_test_small_ids
+// (built with CYAN_ECS_ID_BITS=32 and CYAN_ECS_GENERATION_BITS=12).
+#if CYAN_ECS_GENERATION_BITS <= 16
+TEST_CASE("ObjectRegistry: slots are retired when they run out of generations", "[engine][ecs]") {
+    ObjectRegistry<int> registry;
+    auto first = registry.add(0).id;
+    auto other = registry.add(1).id;
+
+    // Reuse the first slot until it reaches the last generation.
+    auto id = first;
+    for (EcsGenerationT generation = 0; generation < ECS_MAX_GENERATION; generation += 1) {
+        registry.remove(id);
+        id = registry.add(2).id;
+        REQUIRE(get_index(id) == get_index(first));
+    }
+    CHECK(get_generation(id) == ECS_MAX_GENERATION);
+
+    // Once removed, the slot is never handed out again, so none of it's old IDs can match a new object.
+    registry.remove(id);
+    CHECK(registry.size() == 1);
+    auto replacement = registry.add(3).id;
+    CHECK(get_index(replacement) == 2);
+    CHECK(registry.size() == 2);
+    CHECK(!registry.get(first));
+    CHECK(!registry.get(id));
+    CHECK(*registry.get(other) == 1);
+
+    registry.clear();
+    CHECK(registry.size() == 0);
+}
+#endif
+
+TEST_CASE("ObjectRegistry: restoring slots checks the free list", "[engine][ecs]") {
+    const EcsIdT ids[] = {make_ecs_id(0, 0), make_ecs_id(1, 1), make_ecs_id(0, 2), make_ecs_id(2, 3)};
+    const std::uint8_t live[] = {1, 0, 1, 0};
+    ObjectRegistry<int> registry;
+    auto kept = registry.add(7).id;
+
+    // Free slots listed twice, live, or out of range are rejected, leaving the registry as it was.
+    const EcsIndexT duplicated[] = {1, 3, 1};
+    CHECK_THROWS(registry.restore_slots(ids, live, 4, duplicated, 3));
+    const EcsIndexT live_slot[] = {1, 2};
+    CHECK_THROWS(registry.restore_slots(ids, live, 4, live_slot, 2));
+    const EcsIndexT out_of_range[] = {1, 4};
+    CHECK_THROWS(registry.restore_slots(ids, live, 4, out_of_range, 2));
+    CHECK(*registry.get(kept) == 7);
+
+    // With a valid free list, each free slot is reused once.
+    const EcsIndexT free[] = {3, 1};
+    registry.restore_slots(ids, live, 4, free, 2);
+    CHECK(registry.size() == 2);
+    auto first = registry.add(1).id;
+    auto second = registry.add(2).id;
+    CHECK(get_index(first) == 3);
+    CHECK(get_index(second) == 1);
+    CHECK(get_index(registry.add(3).id) == 4);
+}
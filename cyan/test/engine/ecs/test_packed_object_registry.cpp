@@ -0,0 +1,236 @@
+/// Tests for PackedObjectRegistry<T>
+/// These mirror the ObjectRegistry tests, with additional checks that the live objects stay packed.
+
+#include <catch2/catch.hpp>
+#include <random>
+#include <stdexcept>
+
+#include "cyan/src/engine/ecs/object_registry.hpp"
+#include "cyan/src/engine/ecs/packed_object_registry.hpp"
+
+using namespace cyan;
+using namespace cyan::ecs_impl;
+
+TEST_CASE("PackedObjectRegistry: object creation, retrieval, and removal", "[engine][ecs]") {
+    PackedObjectRegistry<int> registry;
+
+    for (EcsIndexT i = 0; i < 8; i += 1) {
+        auto entry = registry.add(int(i));
+        CHECK(entry.id == i);
+        REQUIRE(entry.value != nullptr);
+        CHECK(*entry == int(i));
+    }
+    CHECK(registry.size() == 8);
+
+    // Removing an object moves the last object into it's place, but IDs are unaffected.
+    registry.remove(2);
+    CHECK(registry.size() == 7);
+    CHECK_FALSE(bool(registry.get(2)));
+    CHECK(*registry.get(7) == 7);
+    CHECK(*registry.begin() == 0);
+    CHECK(*(registry.begin() + 2) == 7);
+    CHECK(registry.id_at(2) == 7);
+
+    // Stale IDs are rejected, and removing them does nothing.
+    registry.remove(2);
+    CHECK(registry.size() == 7);
+
+    // The freed slot is reused with a new generation.
+    auto entry_replaced_2 = registry.emplace(1002);
+    CHECK(entry_replaced_2.id == make_ecs_id(1, 2));
+    CHECK_FALSE(bool(registry.get(2)));
+    CHECK(*registry.get(make_ecs_id(1, 2)) == 1002);
+    CHECK(registry.size() == 8);
+
+    // Removing the last object doesn't need to move anything.
+    registry.remove(entry_replaced_2.id);
+    CHECK(registry.size() == 7);
+    for (EcsIndexT i = 0; i < 8; i += 1) {
+        if (i == 2) {
+            CHECK_FALSE(bool(registry.get(i)));
+        } else {
+            CHECK(*registry.get(i) == int(i));
+        }
+    }
+}
+
+namespace {
+    /// A type whose copy constructor throws when copying a negative value.
+    struct ThrowingCopy {
+        int value;
+        explicit ThrowingCopy(int value) : value(value) {}
+        ThrowingCopy(const ThrowingCopy& other) : value(other.value) {
+            if (value < 0) throw std::runtime_error("ThrowingCopy");
+        }
+        ThrowingCopy(ThrowingCopy&&) noexcept = default;
+        ThrowingCopy& operator=(const ThrowingCopy&) = default;
+        ThrowingCopy& operator=(ThrowingCopy&&) noexcept = default;
+    };
+}
+
+TEST_CASE("PackedObjectRegistry: a throwing add leaves the registry unchanged", "[engine][ecs]") {
+    PackedObjectRegistry<ThrowingCopy> registry;
+    auto first = registry.emplace(0).id;
+    auto second = registry.emplace(1).id;
+    registry.remove(first);
+
+    // The add would reuse the freed slot, and (with no spare capacity) reallocate the array.
+    registry.shrink_to_fit();
+    ThrowingCopy bad(-1);
+    CHECK_THROWS(registry.add(bad));
+    CHECK(registry.size() == 1);
+    CHECK(registry.id_at(0) == second);
+    CHECK(registry.get(second)->value == 1);
+
+    // The freed slot is still available, at the generation after the removed object's.
+    auto replacement = registry.add(ThrowingCopy(2));
+    CHECK(replacement.id == make_ecs_id(1, get_index(first)));
+    CHECK(registry.size() == 2);
+    std::size_t n_visited = 0;
+    registry.for_each([&](EcsIdT id, ThrowingCopy& object) {
+        CHECK(registry.get(id)->value == object.value);
+        n_visited += 1;
+    });
+    CHECK(n_visited == 2);
+}
+
+TEST_CASE("PackedObjectRegistry: fuzzy mass use testing for consistency", "[engine][ecs]") {
+    // For the purposes of this test, all objects will have a value equal to their id.
+    PackedObjectRegistry<EcsIdT> registry;
+    int n_cycles = 32;
+    std::size_t n_elements = 10000;
+    std::size_t min_remove = 50;
+    std::size_t max_remove = 5000;
+    std::vector<EcsIdT> ids;
+
+    for (std::size_t i = 0; i < n_elements; i += 1) {
+        auto entry = registry.add(0);
+        *entry = entry.id;
+        ids.push_back(entry.id);
+    }
+
+    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::default_random_engine generator(seed);
+    std::uniform_int_distribution remove_count_rng(min_remove, max_remove);
+
+    for (int cycle = 0; cycle < n_cycles; cycle += 1) {
+        std::size_t n_remove = remove_count_rng(generator);
+
+        for (std::size_t i = 0; i < n_remove; i += 1) {
+            std::uniform_int_distribution<std::size_t> remove_index_rng(0, ids.size() - 1);
+            std::size_t index_to_remove = remove_index_rng(generator);
+            registry.remove(ids[index_to_remove]);
+            ids.erase(ids.begin() + index_to_remove);
+        }
+
+        CHECK(registry.size() == n_elements - n_remove);
+
+        for (std::size_t i = 0; i < n_remove; i += 1) {
+            auto entry = registry.add(0);
+            *entry = entry.id;
+            ids.push_back(entry.id);
+        }
+
+        CHECK(registry.size() == n_elements);
+    }
+
+    // Every ID should still resolve to it's own object, and the packed array should hold exactly the live objects.
+    for (std::size_t i = 0; i < n_elements; i += 1) {
+        auto entry = registry.get(ids[i]);
+        REQUIRE(bool(entry));
+        CHECK(entry.id == *entry);
+    }
+    std::size_t n_visited = 0;
+    registry.for_each([&](EcsIdT id, EcsIdT& value) {
+        CHECK(id == value);
+        n_visited += 1;
+    });
+    CHECK(n_visited == registry.size());
+}
+
+TEST_CASE("PackedObjectRegistry: iteration after churn compared to ObjectRegistry", "[.][benchmark][engine][ecs]") {
+    // Fill both registries, then remove and re-add a large fraction of objects many times, as happens with short-lived
+    // entities. The holes this leaves in ObjectRegistry are only partially refilled, so it's iteration has to skip dead
+    // slots, whereas PackedObjectRegistry iterates a contiguous array.
+    const int n_elements = 100000;
+    const int n_churn_cycles = 50;
+    const int n_churn = n_elements / 2;
+    const std::size_t n_live_after_churn = n_elements / 4;
+
+    ObjectRegistry<float> sparse_registry;
+    PackedObjectRegistry<float> packed_registry;
+    std::vector<EcsIdT> sparse_ids;
+    std::vector<EcsIdT> packed_ids;
+
+    for (int i = 0; i < n_elements; i += 1) {
+        sparse_ids.push_back(sparse_registry.add(float(i)).id);
+        packed_ids.push_back(packed_registry.add(float(i)).id);
+    }
+
+    std::default_random_engine generator(1234);
+    for (int cycle = 0; cycle < n_churn_cycles; cycle += 1) {
+        for (int i = 0; i < n_churn; i += 1) {
+            std::uniform_int_distribution<std::size_t> index_rng(0, sparse_ids.size() - 1);
+            auto index = index_rng(generator);
+            sparse_registry.remove(sparse_ids[index]);
+            packed_registry.remove(packed_ids[index]);
+            sparse_ids[index] = sparse_ids.back();
+            sparse_ids.pop_back();
+            packed_ids[index] = packed_ids.back();
+            packed_ids.pop_back();
+        }
+        for (int i = 0; i < n_churn; i += 1) {
+            sparse_ids.push_back(sparse_registry.add(float(i)).id);
+            packed_ids.push_back(packed_registry.add(float(i)).id);
+        }
+    }
+
+    // Leave only a quarter of the objects alive.
+    while (sparse_ids.size() > n_live_after_churn) {
+        sparse_registry.remove(sparse_ids.back());
+        sparse_ids.pop_back();
+        packed_registry.remove(packed_ids.back());
+        packed_ids.pop_back();
+    }
+    REQUIRE(sparse_registry.size() == packed_registry.size());
+
+    BENCHMARK("ObjectRegistry for_each after churn") {
+        float sum = 0.0f;
+        sparse_registry.for_each([&](EcsIdT, float& value) { sum += value; });
+        return sum;
+    };
+
+    BENCHMARK("PackedObjectRegistry for_each after churn") {
+        float sum = 0.0f;
+        packed_registry.for_each([&](EcsIdT, float& value) { sum += value; });
+        return sum;
+    };
+
+    BENCHMARK("PackedObjectRegistry contiguous iteration after churn") {
+        float sum = 0.0f;
+        for (float value : packed_registry) sum += value;
+        return sum;
+    };
+}
+
+#if CYAN_ECS_GENERATION_BITS <= 16
+TEST_CASE("PackedObjectRegistry: slots are retired when they run out of generations", "[engine][ecs]") {
+    PackedObjectRegistry<int> registry;
+    auto first = registry.add(0).id;
+
+    auto id = first;
+    for (EcsGenerationT generation = 0; generation < ECS_MAX_GENERATION; generation += 1) {
+        registry.remove(id);
+        id = registry.add(1).id;
+        REQUIRE(get_index(id) == get_index(first));
+    }
+    CHECK(get_generation(id) == ECS_MAX_GENERATION);
+
+    registry.remove(id);
+    auto replacement = registry.add(2).id;
+    CHECK(get_index(replacement) == 1);
+    CHECK(registry.size() == 1);
+    CHECK(!registry.get(first));
+    CHECK(!registry.get(id));
+}
+#endif
@@ -3,6 +3,8 @@
 /// TODO
 
 #include <catch2/catch.hpp>
+#include <algorithm>
+#include <vector>
 
 #include "cyan/src/engine/ecs/single_component_registry.hpp"
 
@@ -39,6 +41,147 @@ TEST_CASE("SingleComponentRegistry<T>", "[engine][ecs]") {
         CHECK_FALSE(bool(registry.get(entry.id)));
     }
 
+    SECTION("Test lookup via entity across entity generations") {
+        Entity e0{ecs_impl::make_ecs_id(0, 4)};
+        Entity e0_reused{ecs_impl::make_ecs_id(1, 4)};
+
+        registry.add(e0, 5);
+        CHECK(*registry.get(e0) == 5);
+        CHECK_FALSE(bool(registry.get(e0_reused)));
+
+        // Adding to a newer generation of the same entity index replaces the (orphaned) component of the old one.
+        auto entry = registry.add(e0_reused, 6);
+        CHECK(registry.size() == 1);
+        CHECK(*entry == 6);
+        CHECK(*registry.get(e0_reused) == 6);
+        CHECK_FALSE(bool(registry.get(e0)));
+
+        // Adding to an older generation than the current one is refused.
+        CHECK_FALSE(bool(registry.add(e0, 7)));
+        CHECK(registry.size() == 1);
+        CHECK(*registry.get(e0_reused) == 6);
+        CHECK(registry.get(entry.id).entity.id == e0_reused.id);
+    }
+
     /// TODO: more is needed.
 }
 
+
+namespace {
+    struct PackedTestComponent {
+        int value;
+    };
+}
+
+template <>
+struct cyan::ComponentStorage<PackedTestComponent> {
+    using type = ecs_impl::PackedObjectRegistry<PackedTestComponent>;
+};
+
+TEST_CASE("SingleComponentRegistry<T> with packed storage", "[engine][ecs]") {
+    SingleComponentRegistry<PackedTestComponent> registry;
+
+    for (int i = 0; i < 4; i += 1) {
+        registry.add(Entity{EcsIdT(i)}, PackedTestComponent{i});
+    }
+    CHECK(registry.size() == 4);
+
+    // Removal moves components within the packed storage, which shouldn't affect lookups.
+    registry.remove(Entity{1});
+    CHECK(registry.size() == 3);
+    CHECK_FALSE(bool(registry.get(Entity{1})));
+    for (int i : {0, 2, 3}) {
+        auto entry = registry.get(Entity{EcsIdT(i)});
+        REQUIRE(bool(entry));
+        CHECK((*entry).value == i);
+        CHECK(registry.get(entry.id).entity.id == EcsIdT(i));
+    }
+
+    // Aggregates can be emplaced from their members.
+    auto entry = registry.emplace(Entity{4}, 4);
+    REQUIRE(bool(entry));
+    CHECK((*entry).value == 4);
+    CHECK(registry.size() == 4);
+}
+
+TEMPLATE_TEST_CASE("SingleComponentRegistry<T> through IComponentRegistry", "[engine][ecs]", int, PackedTestComponent) {
+    SingleComponentRegistry<TestType> typed_registry;
+    IComponentRegistry& registry = typed_registry;
+    const int n_components = 10000;
+
+    registry.reserve(n_components);
+    auto reserved_bytes = registry.memory_bytes();
+    CHECK(reserved_bytes >= n_components * sizeof(TestType));
+    std::vector<typename SingleComponentRegistry<TestType>::Id> ids;
+    for (int i = 0; i < n_components; i += 1) {
+        ids.push_back(typed_registry.add(Entity{EcsIdT(i)}, TestType{i}).id);
+    }
+    CHECK(registry.size() == n_components);
+
+    registry.remove(Entity{0});
+    CHECK(registry.size() == n_components - 1);
+    CHECK_FALSE(bool(typed_registry.get(Entity{0})));
+
+    // Clearing removes everything but keeps the memory, and the old IDs stay invalid.
+    registry.clear();
+    CHECK(registry.size() == 0);
+    CHECK_FALSE(bool(typed_registry.get(Entity{1})));
+    CHECK(registry.memory_bytes() >= reserved_bytes);
+    auto entry = typed_registry.add(Entity{1}, TestType{1});
+    CHECK(bool(typed_registry.get(Entity{1})));
+    CHECK(typed_registry.get(entry.id).entity.id == 1);
+    for (auto& id : ids) {
+        if (id.id != entry.id.id) REQUIRE_FALSE(bool(typed_registry.get(id)));
+    }
+
+    // Shrinking returns the memory that isn't needed to keep old IDs invalid.
+    registry.shrink_to_fit();
+    CHECK(registry.memory_bytes() < reserved_bytes);
+    CHECK(bool(typed_registry.get(Entity{1})));
+}
+
+TEMPLATE_TEST_CASE("SingleComponentRegistry<T> change ticks", "[engine][ecs]", int, PackedTestComponent) {
+    SingleComponentRegistry<TestType> registry;
+    for (int i = 0; i < 8; i += 1) {
+        registry.add(Entity{EcsIdT(i)}, TestType{i});
+    }
+    auto collect = [&](EcsTickT since, bool added) {
+        std::vector<EcsIdT> visited;
+        auto record = [&](Entity e, const TestType&) { visited.push_back(e.id); };
+        if (added) {
+            registry.added_since(since, record);
+        } else {
+            registry.changed_since(since, record);
+        }
+        std::sort(visited.begin(), visited.end());
+        return visited;
+    };
+
+    registry.set_tick(1);
+    CHECK(collect(1, false).empty());
+    registry.find_for_write(Entity{2});
+    registry.mark_changed(Entity{5});
+    registry.modify_each_in_range(0, registry.slot_count(), [](Entity e, TestType&) {
+        CHECK(e.id < 8);
+    });
+    CHECK(collect(1, false).size() == 8);
+
+    // Removal moves components in packed storage, which mustn't move their ticks to other components.
+    registry.set_tick(2);
+    registry.remove(Entity{0});
+    registry.find_for_write(Entity{7});
+    registry.add(Entity{8}, TestType{8});
+    CHECK(collect(2, false) == std::vector<EcsIdT>{7, 8});
+    CHECK(collect(2, true) == std::vector<EcsIdT>{8});
+    CHECK(collect(0, true).size() == 8);
+
+    // A slot reused within a tick is reported once, for it's new component.
+    registry.remove(Entity{8});
+    registry.add(Entity{9}, TestType{9});
+    CHECK(collect(2, false) == std::vector<EcsIdT>{7, 9});
+    CHECK(collect(2, true) == std::vector<EcsIdT>{9});
+    registry.set_tick(3);
+    registry.find_for_write(Entity{9});
+    CHECK(collect(3, false) == std::vector<EcsIdT>{9});
+    CHECK(collect(2, true) == std::vector<EcsIdT>{9});
+}
@@ -0,0 +1,73 @@
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "cyan/src/engine/ecs/slot_ticks.hpp"
+
+using namespace cyan;
+using namespace cyan::ecs_impl;
+
+namespace {
+    std::vector<EcsIndexT> collect_since(const SlotTicks& ticks, EcsTickT since) {
+        std::vector<EcsIndexT> visited;
+        ticks.for_each_since(since, [&](EcsIndexT index) { visited.push_back(index); });
+        return visited;
+    }
+}
+
+TEST_CASE("SlotTicks: slots stamped since a tick", "[engine][ecs]") {
+    SlotTicks ticks;
+    ticks.resize(8);
+    CHECK(ticks.get(0) == SlotTicks::NO_TICK);
+    CHECK(collect_since(ticks, 0).empty());
+
+    for (EcsIndexT index = 0; index < 8; index += 1) {
+        ticks.stamp(index, 0);
+    }
+    ticks.set_tick(1);
+    ticks.stamp(3, 1);
+    ticks.stamp(3, 1);
+    ticks.stamp(5, 1);
+    ticks.set_tick(2);
+    ticks.stamp(6, 2);
+    ticks.stamp(3, 2);
+
+    // Each slot is visited once, in the order of it's latest stamp.
+    CHECK(collect_since(ticks, 2) == std::vector<EcsIndexT>{6, 3});
+    CHECK(collect_since(ticks, 1) == std::vector<EcsIndexT>{5, 6, 3});
+    CHECK(collect_since(ticks, 0).size() == 8);
+    CHECK(collect_since(ticks, 3).empty());
+    CHECK(ticks.get(3) == 2);
+
+    // Slots stamped concurrently are visited once they're logged.
+    std::vector<EcsIndexT> stamped;
+    for (EcsIndexT index : {EcsIndexT(1), EcsIndexT(6), EcsIndexT(7)}) {
+        if (ticks.stamp_unlogged(index, 2)) stamped.push_back(index);
+    }
+    CHECK(stamped == std::vector<EcsIndexT>{1, 7});
+    ticks.append_log(stamped, 2);
+    CHECK(collect_since(ticks, 2) == std::vector<EcsIndexT>{6, 3, 1, 7});
+
+    // Going back to an earlier tick moves later stamps back to it, and rebuilds the log in tick order.
+    ticks.set_tick(1);
+    CHECK(ticks.get(3) == 1);
+    ticks.stamp(0, 1);
+    CHECK(collect_since(ticks, 2).empty());
+    CHECK(collect_since(ticks, 1) == std::vector<EcsIndexT>{1, 3, 5, 6, 7, 0});
+}
+
+TEST_CASE("SlotTicks: the log stays proportional to the number of slots", "[engine][ecs]") {
+    SlotTicks ticks;
+    const EcsIndexT n_slots = 100;
+    ticks.resize(n_slots);
+    for (EcsTickT tick = 0; tick < 1000; tick += 1) {
+        ticks.set_tick(tick);
+        for (EcsIndexT index = 0; index < n_slots; index += 1) {
+            ticks.stamp(index, tick);
+        }
+        CHECK(collect_since(ticks, tick).size() == n_slots);
+    }
+    CHECK(ticks.memory_bytes() < 8 * n_slots * (sizeof(EcsTickT) + sizeof(EcsIndexT)) + 1024);
+    CHECK(collect_since(ticks, 0).size() == n_slots);
+    CHECK(collect_since(ticks, 999).size() == n_slots);
+}
@@ -0,0 +1,101 @@
+#include <catch2/catch.hpp>
+
+#include "cyan/src/engine/ecs/sparse_set.hpp"
+
+using namespace cyan;
+using namespace cyan::ecs_impl;
+
+TEST_CASE("SparseSet: insertion, lookup and removal", "[engine][ecs]") {
+    SparseSet<int> set;
+
+    CHECK(set.size() == 0);
+    CHECK(set.find(0) == nullptr);
+    CHECK_FALSE(set.contains(0));
+
+    set.insert(make_ecs_id(0, 3), 30);
+    set.insert(make_ecs_id(0, 1), 10);
+    set.insert(make_ecs_id(2, 7), 70);
+    CHECK(set.size() == 3);
+
+    REQUIRE(set.find(make_ecs_id(0, 3)) != nullptr);
+    CHECK(*set.find(make_ecs_id(0, 3)) == 30);
+    CHECK(*set.find(make_ecs_id(0, 1)) == 10);
+    CHECK(*set.find(make_ecs_id(2, 7)) == 70);
+
+    // Keys with the right index but the wrong generation shouldn't be found.
+    CHECK(set.find(make_ecs_id(1, 3)) == nullptr);
+    CHECK(set.find(make_ecs_id(0, 7)) == nullptr);
+    CHECK(set.find_occupant(make_ecs_id(0, 7)) == make_ecs_id(2, 7));
+    CHECK(set.find_occupant(make_ecs_id(0, 4)) == ECS_NULL_INDEX);
+
+    // Remove the first inserted key - the last element should be moved into it's place.
+    set.erase(make_ecs_id(0, 3));
+    CHECK(set.size() == 2);
+    CHECK_FALSE(set.contains(make_ecs_id(0, 3)));
+    CHECK(*set.find(make_ecs_id(0, 1)) == 10);
+    CHECK(*set.find(make_ecs_id(2, 7)) == 70);
+    CHECK(set.keys()[0] == make_ecs_id(2, 7));
+    CHECK(set.values()[0] == 70);
+
+    // Removing a missing key (or a stale generation) does nothing.
+    set.erase(make_ecs_id(0, 3));
+    set.erase(make_ecs_id(0, 7));
+    CHECK(set.size() == 2);
+
+    set.insert(make_ecs_id(1, 3), 31);
+    CHECK(*set.find(make_ecs_id(1, 3)) == 31);
+
+    set.clear();
+    CHECK(set.size() == 0);
+    CHECK_FALSE(set.contains(make_ecs_id(0, 1)));
+    CHECK_FALSE(set.contains(make_ecs_id(1, 3)));
+}
+
+TEST_CASE("SparseSet: keys spanning multiple pages", "[engine][ecs]") {
+    SparseSet<EcsIdT> set;
+    const EcsIndexT stride = SparseSet<EcsIdT>::PAGE_SIZE / 4 + 1;
+    const int n = 64;
+
+    for (int i = 0; i < n; i += 1) {
+        set.insert(make_ecs_id(0, i * stride), i);
+    }
+    CHECK(set.size() == n);
+
+    // Remove every second key and make sure the others are unaffected.
+    for (int i = 0; i < n; i += 2) {
+        set.erase(make_ecs_id(0, i * stride));
+    }
+    CHECK(set.size() == n / 2);
+
+    for (int i = 0; i < n; i += 1) {
+        auto value = set.find(make_ecs_id(0, i * stride));
+        if (i % 2 == 0) {
+            CHECK(value == nullptr);
+        } else {
+            REQUIRE(value != nullptr);
+            CHECK(*value == EcsIdT(i));
+        }
+    }
+
+    // The dense arrays stay packed and consistent with each other.
+    for (std::size_t i = 0; i < set.size(); i += 1) {
+        CHECK(*set.find(set.keys()[i]) == set.values()[i]);
+    }
+}
+
+TEST_CASE("SparseSet: copies are independent", "[engine][ecs]") {
+    SparseSet<int> set;
+    set.insert(make_ecs_id(0, 2), 20);
+    set.insert(make_ecs_id(0, SparseSet<int>::PAGE_SIZE * 3), 30);
+
+    const SparseSet<int> copy(set);
+    set.erase(make_ecs_id(0, 2));
+    set.insert(make_ecs_id(1, 2), 21);
+    *set.find(make_ecs_id(0, SparseSet<int>::PAGE_SIZE * 3)) = 31;
+
+    CHECK(copy.size() == 2);
+    REQUIRE(copy.find(make_ecs_id(0, 2)) != nullptr);
+    CHECK(*copy.find(make_ecs_id(0, 2)) == 20);
+    CHECK_FALSE(copy.contains(make_ecs_id(1, 2)));
+    CHECK(*copy.find(make_ecs_id(0, SparseSet<int>::PAGE_SIZE * 3)) == 30);
+}
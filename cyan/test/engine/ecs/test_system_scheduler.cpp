@@ -0,0 +1,124 @@
+#include <catch2/catch.hpp>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "cyan/src/engine/ecs/system_scheduler.hpp"
+
+using namespace cyan;
+
+namespace {
+    struct SchedulerTestPosition {
+        int x;
+    };
+
+    struct SchedulerTestVelocity {
+        int dx;
+    };
+
+    struct SchedulerTestHealth {
+        int hp;
+    };
+
+    /// Spin until a counter reaches a value, giving up after a while so a broken scheduler fails rather than hangs.
+    bool wait_for_count(const std::atomic_int& counter, int value) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (counter < value) {
+            if (std::chrono::steady_clock::now() > deadline) return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+}
+
+TEST_CASE("SystemScheduler: conflicting systems run in order", "[engine][ecs][systems]") {
+    ECS ecs;
+    for (int i = 0; i < 100; i += 1) {
+        auto e = ecs.new_entity();
+        ecs.add_component<SchedulerTestPosition>(e, {0});
+        ecs.add_component<SchedulerTestVelocity>(e, {1});
+    }
+
+    int frame = 0;
+    bool positions_consistent = true;
+    SystemScheduler scheduler(ecs, 4);
+    scheduler.add_system("integrate", [](ECS& ecs) {
+        for (auto [e, position, velocity] : ecs.view<SchedulerTestPosition, SchedulerTestVelocity>()) {
+            position.x += velocity.dx;
+        }
+    }).reads<SchedulerTestVelocity>().writes<SchedulerTestPosition>();
+    scheduler.add_system("check", [&](ECS& ecs) {
+        ecs.view<SchedulerTestPosition>().each([&](Entity, SchedulerTestPosition& position) {
+            if (position.x != frame + 1) positions_consistent = false;
+        });
+    }).reads<SchedulerTestPosition>();
+    CHECK(scheduler.size() == 2);
+
+    for (; frame < 20; frame += 1) {
+        scheduler.run_frame();
+    }
+    CHECK(positions_consistent);
+
+    auto& timings = scheduler.get_last_frame_timings();
+    REQUIRE(timings.size() == 2);
+    CHECK(timings[0].name == "integrate");
+    CHECK(timings[1].name == "check");
+    CHECK(scheduler.get_last_frame_duration() >= timings[0].duration);
+}
+
+TEST_CASE("SystemScheduler: independent systems run concurrently", "[engine][ecs][systems]") {
+    ECS ecs;
+    SystemScheduler scheduler(ecs, 2);
+    std::atomic_int n_started = 0;
+    std::atomic_int n_saw_other = 0;
+
+    // Each system waits for the other to start, which only happens if they run at the same time.
+    auto rendezvous = [&](ECS&) {
+        n_started += 1;
+        if (wait_for_count(n_started, 2)) n_saw_other += 1;
+    };
+    scheduler.add_system("position reader", rendezvous).reads<SchedulerTestPosition>();
+    scheduler.add_system("health writer", rendezvous).reads<SchedulerTestPosition>().writes<SchedulerTestHealth>();
+    scheduler.run_frame();
+    CHECK(n_saw_other == 2);
+}
+
+TEST_CASE("SystemScheduler: exclusive systems run alone", "[engine][ecs][systems]") {
+    ECS ecs;
+    SystemScheduler scheduler(ecs, 4);
+    std::atomic_int n_running = 0;
+    std::atomic_int max_running = 0;
+
+    auto track = [&](ECS&) {
+        int running = n_running += 1;
+        int previous_max = max_running;
+        while (running > previous_max && !max_running.compare_exchange_weak(previous_max, running)) {}
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        n_running -= 1;
+    };
+    scheduler.add_system("a", track).reads<SchedulerTestPosition>();
+    scheduler.add_system("spawner", [&](ECS& ecs) {
+        track(ecs);
+        ecs.add_component<SchedulerTestHealth>(ecs.new_entity(), {10});
+    }).exclusive();
+    scheduler.add_system("b", track).reads<SchedulerTestVelocity>();
+
+    for (int frame = 0; frame < 10; frame += 1) {
+        scheduler.run_frame();
+    }
+    CHECK(max_running == 1);
+    CHECK(ecs.get_component_registry<SchedulerTestHealth>()->size() == 10);
+}
+
+TEST_CASE("SystemScheduler: exceptions are rethrown after the frame", "[engine][ecs][systems]") {
+    ECS ecs;
+    SystemScheduler scheduler(ecs, 2);
+    bool later_system_ran = false;
+    scheduler.add_system("thrower", [](ECS&) { throw std::runtime_error("system failure"); })
+        .writes<SchedulerTestPosition>();
+    scheduler.add_system("dependent", [&](ECS&) { later_system_ran = true; }).reads<SchedulerTestPosition>();
+
+    CHECK_THROWS_AS(scheduler.run_frame(), std::runtime_error);
+    CHECK(later_system_ran);
+}
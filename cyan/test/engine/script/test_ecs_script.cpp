@@ -5,6 +5,7 @@
 #include "cyan/src/engine/script/ecs_script.hpp"
 #include "cyan/generated/components/components.hpp"
 #include "cyan/src/engine/script/generated_script.hpp"
+#include "cyan/src/engine/systems/spatial_index_2d.hpp"
 
 using namespace cyan;
 
@@ -88,4 +89,67 @@ TEST_CASE("chai ecs: component usage", "[engine][script]")
         CHECK_FALSE(chai.eval<bool>("entity_exists(e2)"));
         CHECK_FALSE(chai.eval<bool>("get_debug_name_component(e2).is_valid()"));
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("chai ecs: component observers", "[engine][script]")
+{
+    ChaiEngine chai_engine;
+    ECS ecs;
+    chai_add_ecs_library(chai_engine, ecs);
+    chai_add_codegen_generated_library(chai_engine);
+
+    auto chai_report = chai_engine.run(
+            "var n_added = 0;\n"
+            "var n_removed = 0;\n"
+            "on_add_debug_name_component(fun(e) { n_added += 1; });\n"
+            "var removed_observer = on_remove_debug_name_component(fun(e) { n_removed += 1; });\n"
+            "var e = new_entity();\n"
+            "add_debug_name_component(e, DebugNameComponent(\"Alice\"));\n"
+            "add_debug_name_component(new_entity(), DebugNameComponent(\"Bob\"));");
+    REQUIRE(chai_report.ok);
+
+    // Observers aren't called until events are flushed.
+    auto& chai = chai_engine.get_chai_object();
+    CHECK(chai.eval<int>("n_added") == 0);
+    chai_report = chai_engine.run("flush_component_events(); delete_entity(e);");
+    REQUIRE(chai_report.ok);
+    CHECK(chai.eval<int>("n_added") == 2);
+    CHECK(chai.eval<int>("n_removed") == 0);
+    ecs.flush_events();
+    CHECK(chai.eval<int>("n_removed") == 1);
+
+    // Removed observers aren't called again.
+    CHECK(chai.eval<bool>("remove_component_observer(removed_observer)"));
+    CHECK_FALSE(chai.eval<bool>("remove_component_observer(removed_observer)"));
+    chai_report = chai_engine.run("var f = new_entity();\n"
+                                  "add_debug_name_component(f, DebugNameComponent(\"Carol\"));\n"
+                                  "flush_component_events();\n"
+                                  "delete_entity(f);\n"
+                                  "flush_component_events();");
+    REQUIRE(chai_report.ok);
+    CHECK(chai.eval<int>("n_added") == 3);
+    CHECK(chai.eval<int>("n_removed") == 1);
+}
+
+TEST_CASE("chai ecs: spatial queries", "[engine][script]")
+{
+    ChaiEngine chai_engine;
+    ECS ecs;
+    SpatialIndex2D spatial_index(ecs);
+    chai_add_ecs_library(chai_engine, ecs);
+    chai_add_spatial_index_library(chai_engine, spatial_index);
+
+    std::vector<Entity> entities;
+    ecs.new_entities(3, entities);
+    for (int i = 0; i < 3; i += 1) {
+        ecs.add_component<component::WorldTransform2D>(
+                entities[i], component::WorldTransform2D(1, 0, 0, 1, float(i) * 100.0f, 0.0f));
+    }
+
+    auto& chai = chai_engine.get_chai_object();
+    CHECK(chai.eval<std::size_t>("update_spatial_index()") == 3);
+    CHECK(chai.eval<std::size_t>("entities_in_rect(-1.0, -1.0, 150.0, 1.0).size()") == 2);
+    CHECK(chai.eval<std::size_t>("entities_in_radius(200.0, 0.0, 50.0).size()") == 1);
+    CHECK(chai.eval<Entity>("entities_in_radius(200.0, 0.0, 50.0)[0]").id == entities[2].id);
+    CHECK(chai.eval<Entity>("nearest_entities(90.0, 0.0, 2)[1]").id == entities[0].id);
+}
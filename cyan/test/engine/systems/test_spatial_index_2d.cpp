@@ -0,0 +1,225 @@
+/// Tests for the 2D spatial index (SpatialHashGrid2D and SpatialIndex2D).
+
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "cyan/src/engine/systems/spatial_index_2d.hpp"
+
+using namespace cyan;
+using namespace cyan::component;
+
+namespace {
+    /// Sort entities by ID, so query results can be compared regardless of order.
+    std::vector<EcsIdT> sorted_ids(const std::vector<Entity>& entities) {
+        std::vector<EcsIdT> ids;
+        for (auto e : entities) {
+            ids.push_back(e.id);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    /// Find the entities within a radius of a point by checking every point.
+    std::vector<EcsIdT> brute_force_radius(const std::vector<SpatialPoint2D>& points, float x, float y, float radius) {
+        std::vector<Entity> found;
+        for (auto& point : points) {
+            auto dx = point.x - x;
+            auto dy = point.y - y;
+            if (dx * dx + dy * dy <= radius * radius) found.push_back(point.entity);
+        }
+        return sorted_ids(found);
+    }
+}
+
+TEST_CASE("SpatialHashGrid2D: queries", "[engine][systems]") {
+    SpatialHashGrid2D grid(10.0f);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    std::vector<SpatialPoint2D> points;
+    for (EcsIdT i = 0; i < 500; i += 1) {
+        points.push_back(SpatialPoint2D{Entity{i}, coordinate(rng), coordinate(rng)});
+    }
+
+    SECTION("Inserting one at a time and rebuilding in a batch give the same results") {
+        bool batched = GENERATE(false, true);
+        if (batched) {
+            grid.rebuild(points);
+        } else {
+            for (auto& point : points) {
+                grid.insert(point.entity, point.x, point.y);
+            }
+        }
+        REQUIRE(grid.size() == points.size());
+
+        for (float radius : {0.0f, 5.0f, 25.0f, 1000.0f}) {
+            std::vector<Entity> found;
+            grid.query_radius(12.5f, -40.0f, radius, found);
+            CHECK(sorted_ids(found) == brute_force_radius(points, 12.5f, -40.0f, radius));
+        }
+
+        std::vector<Entity> in_rect, expected;
+        grid.query_rect(-30.0f, -10.0f, 45.0f, 5.0f, in_rect);
+        for (auto& point : points) {
+            if (point.x >= -30.0f && point.x <= 45.0f && point.y >= -10.0f && point.y <= 5.0f) {
+                expected.push_back(point.entity);
+            }
+        }
+        CHECK(sorted_ids(in_rect) == sorted_ids(expected));
+
+        // The nearest entities are sorted by distance, and match a full sort of every point.
+        for (std::size_t k : {1, 7, 50}) {
+            std::vector<Entity> nearest;
+            grid.query_nearest(90.0f, 95.0f, k, nearest);
+            auto by_distance = points;
+            std::sort(by_distance.begin(), by_distance.end(), [](auto& a, auto& b) {
+                return std::hypot(a.x - 90.0f, a.y - 95.0f) < std::hypot(b.x - 90.0f, b.y - 95.0f);
+            });
+            REQUIRE(nearest.size() == k);
+            for (std::size_t i = 0; i < k; i += 1) {
+                CHECK(nearest[i].id == by_distance[i].entity.id);
+            }
+        }
+    }
+
+    SECTION("Queries follow moves and removals") {
+        grid.rebuild(points);
+        for (std::size_t i = 0; i < points.size(); i += 2) {
+            points[i].x = -points[i].x;
+            points[i].y += 1.0f;
+            grid.insert(points[i].entity, points[i].x, points[i].y);
+        }
+        for (std::size_t i = 1; i < points.size(); i += 3) {
+            CHECK(grid.remove(points[i].entity));
+            CHECK_FALSE(grid.contains(points[i].entity));
+        }
+        CHECK_FALSE(grid.remove(points[1].entity));
+        points.erase(std::remove_if(points.begin(), points.end(), [&](auto& point) {
+            return !grid.contains(point.entity);
+        }), points.end());
+        CHECK(grid.size() == points.size());
+
+        std::vector<Entity> found;
+        grid.query_radius(-20.0f, 30.0f, 40.0f, found);
+        CHECK(sorted_ids(found) == brute_force_radius(points, -20.0f, 30.0f, 40.0f));
+    }
+
+    SECTION("Far away and sparse points") {
+        grid.insert(Entity{0}, 0.0f, 0.0f);
+        grid.insert(Entity{1}, 1e9f, -1e9f);
+        std::vector<Entity> nearest;
+        grid.query_nearest(1e9f, 0.0f, 5, nearest);
+        REQUIRE(nearest.size() == 2);
+        CHECK(nearest[0].id == 0);
+
+        std::vector<Entity> everything;
+        grid.query_rect(-1e10f, -1e10f, 1e10f, 1e10f, everything);
+        CHECK(everything.size() == 2);
+    }
+
+    CHECK_THROWS(SpatialHashGrid2D(0.0f));
+}
+
+TEST_CASE("SpatialIndex2D: following an ECS", "[engine][systems]") {
+    ECS ecs;
+    std::vector<Entity> entities;
+    ecs.new_entities(10, entities);
+    for (int i = 0; i < 10; i += 1) {
+        ecs.add_component<WorldTransform2D>(entities[i], WorldTransform2D(1, 0, 0, 1, float(i * 10), 0.0f));
+    }
+    SpatialIndex2D index(ecs, 8.0f);
+    CHECK(index.update() == 10);
+
+    std::vector<Entity> found;
+    index.query_rect(15.0f, -1.0f, 45.0f, 1.0f, found);
+    CHECK(sorted_ids(found) == sorted_ids({entities[2], entities[3], entities[4]}));
+
+    // Moves, deletions, and new entities are picked up by the next update.
+    ecs.get_component<WorldTransform2D>(entities[9]).get().tx = 20.0f;
+    ecs.get_component<WorldTransform2D>(entities[2]).get().ty = 50.0f;
+    ecs.delete_entity(entities[3]);
+    ecs.remove_component<WorldTransform2D>(entities[4]);
+    Entity added = ecs.new_entity();
+    ecs.add_component<WorldTransform2D>(added, WorldTransform2D(1, 0, 0, 1, 30.0f, 0.5f));
+    // Reading a component isn't a move.
+    CHECK(ecs.get_component<WorldTransform2D>(entities[5]).read().tx == 50.0f);
+
+    CHECK(index.update() == 5);
+    CHECK(index.get_grid().size() == 9);
+    found.clear();
+    index.query_rect(15.0f, -1.0f, 45.0f, 1.0f, found);
+    CHECK(sorted_ids(found) == sorted_ids({entities[9], added}));
+
+    found.clear();
+    index.query_radius(20.0f, 45.0f, 6.0f, found);
+    CHECK(sorted_ids(found) == sorted_ids({entities[2]}));
+
+    found.clear();
+    index.query_nearest(0.0f, 0.0f, 3, found);
+    CHECK(sorted_ids(found) == sorted_ids({entities[0], entities[1], entities[9]}));
+
+    CHECK(index.rebuild() == 9);
+    CHECK(index.update() == 0);
+}
+
+TEST_CASE("SpatialIndex2D: destroyed before it's ECS", "[engine][systems]") {
+    ECS ecs;
+    Entity e = ecs.new_entity();
+    ecs.add_component<WorldTransform2D>(e, WorldTransform2D(1, 0, 0, 1, 0.0f, 0.0f));
+    {
+        SpatialIndex2D index(ecs, 8.0f);
+        CHECK(index.update() == 1);
+    }
+    // The index's observers are gone, so flushing events doesn't call into it.
+    ecs.get_component<WorldTransform2D>(e).get().tx = 20.0f;
+    ecs.remove_component<WorldTransform2D>(e);
+    ecs.add_component<WorldTransform2D>(e, WorldTransform2D(1, 0, 0, 1, 30.0f, 0.0f));
+    ecs.flush_events();
+
+    SpatialIndex2D index(ecs, 8.0f);
+    CHECK(index.update() == 1);
+    std::vector<Entity> found;
+    index.query_radius(30.0f, 0.0f, 1.0f, found);
+    CHECK(sorted_ids(found) == sorted_ids({e}));
+}
+
+TEST_CASE("SpatialHashGrid2D: moving and querying many entities", "[.][benchmark][engine][systems]") {
+    const int n_entities = 100000;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coordinate(0.0f, 10000.0f);
+    std::uniform_real_distribution<float> step(-1.0f, 1.0f);
+    std::vector<SpatialPoint2D> points;
+    for (int i = 0; i < n_entities; i += 1) {
+        points.push_back(SpatialPoint2D{Entity{EcsIdT(i)}, coordinate(rng), coordinate(rng)});
+    }
+    SpatialHashGrid2D grid(32.0f);
+
+    BENCHMARK("Rebuild") {
+        grid.rebuild(points);
+        return grid.size();
+    };
+    BENCHMARK("Move every entity") {
+        for (auto& point : points) {
+            point.x += step(rng);
+            point.y += step(rng);
+            grid.insert(point.entity, point.x, point.y);
+        }
+        return grid.size();
+    };
+    std::vector<Entity> found;
+    BENCHMARK("1000 radius queries") {
+        found.clear();
+        for (int i = 0; i < 1000; i += 1) {
+            grid.query_radius(coordinate(rng), coordinate(rng), 50.0f, found);
+        }
+        return found.size();
+    };
+    BENCHMARK("1000 nearest-8 queries") {
+        found.clear();
+        for (int i = 0; i < 1000; i += 1) {
+            grid.query_nearest(coordinate(rng), coordinate(rng), 8, found);
+        }
+        return found.size();
+    };
+}
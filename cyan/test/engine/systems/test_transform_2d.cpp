@@ -0,0 +1,153 @@
+/// Tests for hierarchical 2D transforms (TransformPropagation2D).
+
+#include <catch2/catch.hpp>
+#include <utility>
+#include <vector>
+
+#include "cyan/src/engine/systems/transform_2d.hpp"
+
+using namespace cyan;
+using namespace cyan::component;
+
+namespace {
+    /// The world position of an entity's origin.
+    std::pair<float, float> world_position(ECS& ecs, Entity e) {
+        auto& world = ecs.get_component<WorldTransform2D>(e).read();
+        return {world.tx, world.ty};
+    }
+}
+
+TEST_CASE("Transform composition", "[engine][systems]") {
+    auto half_turn = to_matrix(LocalTransform2D(1.0f, 2.0f, 3.14159265f, 2.0f, 2.0f));
+    auto offset = to_matrix(LocalTransform2D(1.0f, 0.0f, 0.0f, 1.0f, 1.0f));
+    auto combined = compose(half_turn, offset);
+    // The offset is scaled by 2 and turned around before being moved to (1, 2).
+    CHECK(combined.tx == Approx(-1.0f));
+    CHECK(combined.ty == Approx(2.0f).margin(1e-5));
+    CHECK(combined.a == Approx(-2.0f));
+}
+
+TEST_CASE("TransformPropagation2D: hierarchies", "[engine][systems]") {
+    ECS ecs;
+    TransformPropagation2D transforms(ecs);
+
+    // A chain of entities, each offset by 1 along x from it's parent, with the root rotated by a quarter turn.
+    std::vector<Entity> chain;
+    for (int i = 0; i < 5; i += 1) {
+        Entity e = ecs.new_entity();
+        ecs.add_component<LocalTransform2D>(e, LocalTransform2D(1.0f, 0.0f, 0.0f, 1.0f, 1.0f));
+        if (!chain.empty()) ecs.add_component<Parent>(e, Parent(chain.back()));
+        chain.push_back(e);
+    }
+    // Children added before their parents are still computed after them.
+    Entity leaf = ecs.new_entity();
+    ecs.add_component<Parent>(leaf, Parent(chain.back()));
+    ecs.add_component<LocalTransform2D>(leaf, LocalTransform2D(0.0f, 1.0f, 0.0f, 1.0f, 1.0f));
+    ecs.get_component<LocalTransform2D>(chain[0]).get().rotation = 3.14159265f / 2.0f;
+
+    CHECK(transforms.update() == 6);
+    CHECK(transforms.size() == 6);
+    for (int i = 0; i < 5; i += 1) {
+        auto [x, y] = world_position(ecs, chain[i]);
+        CHECK(x == Approx(1.0f));
+        CHECK(y == Approx(float(i)));
+    }
+    auto [leaf_x, leaf_y] = world_position(ecs, leaf);
+    CHECK(leaf_x == Approx(0.0f).margin(1e-5));
+    CHECK(leaf_y == Approx(4.0f));
+
+    SECTION("Nothing is recomputed when nothing changed") {
+        CHECK(transforms.update() == 0);
+    }
+
+    SECTION("Only the changed subtree is recomputed") {
+        ecs.get_component<LocalTransform2D>(chain[3]).get().x = 2.0f;
+        CHECK(transforms.update() == 3);
+        CHECK(world_position(ecs, chain[2]).second == Approx(2.0f));
+        CHECK(world_position(ecs, chain[3]).second == Approx(4.0f));
+        CHECK(world_position(ecs, leaf).second == Approx(5.0f));
+    }
+
+    SECTION("Subtrees inside other changed subtrees are recomputed once") {
+        ecs.get_component<LocalTransform2D>(leaf).get().y = 2.0f;
+        ecs.get_component<LocalTransform2D>(chain[4]).get().x = 2.0f;
+        ecs.get_component<LocalTransform2D>(chain[2]).get().x = 2.0f;
+        CHECK(transforms.update() == 4);
+        CHECK(world_position(ecs, chain[4]).second == Approx(6.0f));
+        CHECK(world_position(ecs, leaf).first == Approx(-1.0f));
+        CHECK(world_position(ecs, leaf).second == Approx(6.0f));
+    }
+
+    SECTION("Writing a Parent without changing it doesn't rebuild the hierarchy") {
+        ecs.get_component<Parent>(chain[2]).get();
+        ecs.get_component<Parent>(leaf).get().parent = chain[4];
+        CHECK(transforms.update() == 0);
+    }
+
+    SECTION("Reparenting and removing parents rebuild the hierarchy") {
+        ecs.get_component<Parent>(leaf).get().parent = chain[0];
+        transforms.update();
+        CHECK(world_position(ecs, leaf).first == Approx(0.0f).margin(1e-5));
+        CHECK(world_position(ecs, leaf).second == Approx(0.0f).margin(1e-5));
+
+        ecs.delete_entity(chain[0]);
+        transforms.update();
+        CHECK(transforms.size() == 5);
+        CHECK(world_position(ecs, chain[1]).first == Approx(1.0f));
+        CHECK(world_position(ecs, chain[1]).second == Approx(0.0f).margin(1e-5));
+        CHECK(world_position(ecs, leaf).first == Approx(0.0f));
+        CHECK(world_position(ecs, leaf).second == Approx(1.0f));
+    }
+
+    SECTION("Entities in a parent cycle are left out") {
+        ecs.add_component<Parent>(chain[0], Parent(chain[4]));
+        transforms.update();
+        CHECK(transforms.size() == 0);
+
+        // Breaking the cycle puts them back.
+        ecs.get_component<Parent>(chain[0]).get().parent = chain[0];
+        CHECK(transforms.update() == 6);
+        CHECK(world_position(ecs, leaf).second == Approx(4.0f));
+    }
+}
+
+TEST_CASE("TransformPropagation2D: destroyed before it's ECS", "[engine][systems]") {
+    ECS ecs;
+    {
+        TransformPropagation2D transforms(ecs);
+        transforms.update();
+    }
+    // The propagation's observers are gone, so flushing events doesn't call into it.
+    Entity e = ecs.new_entity();
+    ecs.add_component<LocalTransform2D>(e, LocalTransform2D(1.0f, 0.0f, 0.0f, 1.0f, 1.0f));
+    ecs.get_component<LocalTransform2D>(e).get().x = 2.0f;
+    ecs.add_component<Parent>(e, Parent(e));
+    ecs.flush_events();
+
+    TransformPropagation2D transforms(ecs);
+    CHECK(transforms.update() == 1);
+    CHECK(world_position(ecs, e).first == Approx(2.0f));
+}
+
+TEST_CASE("TransformPropagation2D: propagating a deep hierarchy", "[.][benchmark][engine][systems]") {
+    ECS ecs;
+    TransformPropagation2D transforms(ecs);
+    const int n_entities = 100000;
+    std::vector<Entity> entities;
+    ecs.new_entities(n_entities, entities);
+    for (int i = 0; i < n_entities; i += 1) {
+        ecs.add_component<LocalTransform2D>(entities[i], LocalTransform2D(1.0f, 0.0f, 0.01f, 1.0f, 1.0f));
+        // Each entity's parent is one of the entities before it, making a deep and wide tree.
+        if (i > 0) ecs.add_component<Parent>(entities[i], Parent(entities[(i - 1) / 4]));
+    }
+    transforms.update();
+
+    BENCHMARK("Rebuild and propagate everything") {
+        ecs.get_component<Parent>(entities[1]).get().parent = entities[0];
+        return transforms.update();
+    };
+    BENCHMARK("Propagate a small subtree") {
+        ecs.get_component<LocalTransform2D>(entities[n_entities / 2]).get().rotation += 0.1f;
+        return transforms.update();
+    };
+}
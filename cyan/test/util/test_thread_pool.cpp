@@ -0,0 +1,58 @@
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "cyan/src/util/thread_pool.hpp"
+
+using namespace cyan;
+
+
+TEST_CASE("ThreadPool: runs every submitted task", "[util][thread_pool]") {
+    ThreadPool pool(4);
+    CHECK(pool.size() == 4);
+
+    std::atomic_int n_run = 0;
+    for (int i = 0; i < 1000; i += 1) {
+        pool.submit([&n_run]() { n_run += 1; });
+    }
+    pool.wait_idle();
+    CHECK(n_run == 1000);
+
+    // Tasks can submit further tasks, which wait_idle() also waits for.
+    for (int i = 0; i < 10; i += 1) {
+        pool.submit([&pool, &n_run]() {
+            for (int j = 0; j < 10; j += 1) {
+                pool.submit([&n_run]() { n_run += 1; });
+            }
+        });
+    }
+    pool.wait_idle();
+    CHECK(n_run == 1100);
+}
+
+TEST_CASE("ThreadPool: parallel_for", "[util][thread_pool]") {
+    ThreadPool pool(4);
+
+    std::vector<int> visits(1000, 0);
+    pool.parallel_for(visits.size(), [&](std::size_t i) { visits[i] += 1; });
+    CHECK(std::count(visits.begin(), visits.end(), 1) == 1000);
+
+    // Nested use from tasks on the same pool completes, as the caller takes part in the work.
+    std::atomic_int n_inner = 0;
+    pool.parallel_for(16, [&](std::size_t) {
+        pool.parallel_for(16, [&](std::size_t) { n_inner += 1; });
+    });
+    CHECK(n_inner == 256);
+
+    // Exceptions are rethrown once every index has been processed.
+    std::atomic_int n_run = 0;
+    CHECK_THROWS_AS(pool.parallel_for(100, [&](std::size_t i) {
+        n_run += 1;
+        if (i == 50) throw std::runtime_error("failure");
+    }), std::runtime_error);
+    CHECK(n_run == 100);
+
+    pool.parallel_for(0, [](std::size_t) { FAIL("No indices should be visited"); });
+}
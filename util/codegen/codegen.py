@@ -6,7 +6,7 @@ import sys
 import argparse
 import json
 import os
-from common import copyable_types, codegen_initial_comment, prelude, file_is_generated
+from common import copyable_types, trivially_copyable_types, codegen_initial_comment, prelude, file_is_generated
 from chaigen import ChaiBindingsGenerator
 
 template_file_extension = ".json"
@@ -16,7 +16,13 @@ struct_template = """
 struct {struct_name} {{
 {constructors}
 {data_members}
-}};
+{serializers}}};
+"""
+
+serializers_template = """
+    // Snapshot serializers (see cyan/src/engine/ecs/snapshot.hpp), as {struct_name} isn't trivially copyable.
+    template <typename Out> void serialize(Out& out) const {{ {writes} }}
+    template <typename In> void deserialize(In& in) {{ {reads} }}
 """
 
 
@@ -79,6 +85,20 @@ def make_member_constructor(codegen_template, argnames=True):
     return ctor_code
 
 
+def make_serializers(codegen_template):
+    """
+    Generate snapshot serializers, which write and read every member in order, if any member isn't trivially copyable
+    (trivially copyable structs are saved as their bytes instead).
+    """
+    members = codegen_template["data"]
+    if all(member["type"] in trivially_copyable_types for member in members):
+        return ""
+
+    writes = " ".join("out.write({});".format(member["name"]) for member in members)
+    reads = " ".join("in.read({});".format(member["name"]) for member in members)
+    return serializers_template.format(struct_name=codegen_template["name"], writes=writes, reads=reads)
+
+
 def generate_code(codegen_file, output_file, chai_binder: ChaiBindingsGenerator):
     """
     Given a single codegen file template, generate and return the corresponding C++ code.
@@ -98,9 +118,11 @@ def generate_code(codegen_file, output_file, chai_binder: ChaiBindingsGenerator)
             make_member_constructor(codegen_template)
         ]
         constructors = "".join("    {}\n".format(c) for c in constructors)
+        serializers = make_serializers(codegen_template)
     else:
         data_members = ""
         constructors = ""
+        serializers = ""
 
     # Add chai bindings if the option is set.
     try:
@@ -112,7 +134,8 @@ def generate_code(codegen_file, output_file, chai_binder: ChaiBindingsGenerator)
     struct_body = struct_template.format(
         struct_name=struct_name,
         constructors=constructors,
-        data_members=data_members
+        data_members=data_members,
+        serializers=serializers
     )
 
     if "include" in codegen_template:
@@ -17,7 +17,13 @@ prelude = """{}
 
 # Add types to this list to cause them to be generate argument types for copying, rather than as a const reference.
 copyable_types = {
-    "int", "bool"  # TODO: this can be expanded
+    "int", "bool", "float", "double"  # TODO: this can be expanded
+}
+
+# Types which are trivially copyable in C++. Structs with a member of any other type are given snapshot serializers.
+trivially_copyable_types = copyable_types | {
+    "char", "std::int8_t", "std::int16_t", "std::int32_t", "std::int64_t",
+    "std::uint8_t", "std::uint16_t", "std::uint32_t", "std::uint64_t", "std::size_t", "cyan::Entity"
 }
 
 